@@ -1,80 +1,257 @@
 /*
 * KIV/PPR 2022 refence distribution generator
+*
+* Every sample is computed from its own index by counter-based Philox4x32-10 generator,
+* so threads fill their slices of the file independently and the output does not depend
+* on thread count.
 */
 #include <random>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
-template <typename D, typename ...arg>
-void Generate_Numbers(const char* dst, const size_t count, const arg... a) {
-    std::ofstream output(dst, std::ios::out | std::ios::binary);
-    if (output.is_open()) {
+// Samples in one write of a thread (8 MB)
+constexpr size_t WRITE_BLOCK = 1 << 20;
 
-        std::random_device rd;
-        D dis(a...);
+// Seed of the default run
+constexpr uint64_t DEFAULT_SEED = 20221;
 
-        std::cout << "Generating the numbers... ";
-        for (int n = 0; n < count; ++n) {
-            const double num = dis(rd);
-            output.write(reinterpret_cast<const char*>(&num), sizeof(num));
+/// <summary>
+/// Philox4x32-10 counter-based generator (Salmon et al., Random123). Output is a bijection of the counter under the key
+/// </summary>
+struct Philox {
+    using Block = std::array<uint32_t, 4>;
+
+    uint32_t key[2];
+
+    explicit Philox(uint64_t seed) : key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) } {}
+
+    Block operator()(Block c) const {
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c[0];
+            const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c[2];
+            c = { static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0, static_cast<uint32_t>(p1),
+                  static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1, static_cast<uint32_t>(p0) };
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+
+        return c;
+    }
+
+    /// <summary>
+    /// Random block of sample. Word 2 separates blocks of one sample, word 3 is the stream
+    /// </summary>
+    Block sample(uint64_t index, uint32_t block = 0, uint32_t stream = 0) const {
+        return (*this)({ static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), block, stream });
+    }
+};
+
+/// <summary>
+/// Uniform number in (0, 1) from two words (53 bits)
+/// </summary>
+inline double to_unit(uint32_t high, uint32_t low) {
+    const uint64_t bits = ((static_cast<uint64_t>(high) << 32) | low) >> 11;
+    return (static_cast<double>(bits) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/// <summary>
+/// Uniform random bit generator over blocks of one sample, for distributions with rejection (Poisson)
+/// </summary>
+struct Sample_engine {
+    using result_type = uint32_t;
+
+    const Philox& philox;
+    uint64_t index;
+    uint32_t block = 0;
+    Philox::Block words{};
+    int used = 4;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        if (used == 4) {
+            words = philox.sample(index, block++);
+            used = 0;
         }
-        std::cout << "done.";
+        return words[used++];
     }
-    else {
-        std::cout << "Cannot open the output file. Exiting..." << std::endl;        
+};
+
+/// <summary>
+/// Fill samples [first, first + count) of the file
+/// </summary>
+void Fill(double* out, uint64_t first, size_t count, char distribution, const Philox& philox, double a, double b) {
+    constexpr double two_pi = 6.283185307179586;
+
+    for (size_t k = 0; k < count; ++k) {
+        const uint64_t index = first + k;
+        switch (distribution) {
+            case 'g': [[fallthrough]];
+            case 'n': {
+                // Box-Muller, both values of one block belong to the pair of samples (2j, 2j + 1)
+                const Philox::Block w = philox.sample(index / 2);
+                const double r = std::sqrt(-2.0 * std::log(to_unit(w[0], w[1])));
+                const double theta = two_pi * to_unit(w[2], w[3]);
+                out[k] = a + b * r * (index % 2 == 0 ? std::cos(theta) : std::sin(theta));
+                break;
+            }
+            case 'u': {
+                const Philox::Block w = philox.sample(index);
+                out[k] = a + (b - a) * to_unit(w[0], w[1]);
+                break;
+            }
+            case 'e': {
+                const Philox::Block w = philox.sample(index);
+                out[k] = -std::log(to_unit(w[0], w[1])) / a;
+                break;
+            }
+            case 'p': {
+                Sample_engine engine{ philox, index };
+                std::poisson_distribution<> dis(a);
+                out[k] = dis(engine);
+                break;
+            }
+        }
     }
 }
 
+/// <summary>
+/// Generate slice of samples and write it to its place in preallocated file
+/// </summary>
+bool Write_Slice(const char* dst, uint64_t first, uint64_t count, char distribution, const Philox& philox, double a, double b) {
+    std::ofstream output(dst, std::ios::in | std::ios::out | std::ios::binary);
+    if (!output.is_open()) {
+        return false;
+    }
+
+    output.seekp(static_cast<std::streamoff>(first * sizeof(double)));
+    std::vector<double> buffer(static_cast<size_t>(std::min<uint64_t>(count, WRITE_BLOCK)));
+
+    for (uint64_t done = 0; done < count; ) {
+        const size_t block = static_cast<size_t>(std::min<uint64_t>(count - done, WRITE_BLOCK));
+        Fill(buffer.data(), first + done, block, distribution, philox, a, b);
+        output.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(block * sizeof(double)));
+        done += block;
+    }
+
+    return output.good();
+}
+
+bool Generate_Numbers(const char* dst, const uint64_t count, char distribution, double a, double b, uint64_t seed, unsigned threads) {
+    // Preallocated file, every thread writes its own slice
+    {
+        std::ofstream output(dst, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            std::cout << "Cannot open the output file. Exiting..." << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::resize_file(dst, count * sizeof(double), error);
+    if (error) {
+        std::cout << "Cannot allocate the output file. Exiting..." << std::endl;
+        return false;
+    }
+
+    const Philox philox(seed);
+
+    // Slices start at even samples, pairs of Gauss samples are not split
+    uint64_t slice = (count + threads - 1) / threads;
+    slice += slice % 2;
+
+    std::cout << "Generating the numbers... ";
+    std::vector<std::thread> workers;
+    std::vector<char> ok(threads, 1);
+    for (unsigned t = 0; t < threads && t * slice < count; ++t) {
+        const uint64_t first = t * slice;
+        const uint64_t size = std::min(slice, count - first);
+        workers.emplace_back([&, t, first, size]() {
+            ok[t] = Write_Slice(dst, first, size, distribution, philox, a, b);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (char slice_ok : ok) {
+        if (!slice_ok) {
+            std::cout << "Cannot write the output file. Exiting..." << std::endl;
+            return false;
+        }
+    }
+    std::cout << "done.";
+    return true;
+}
+
 
 
 int smain(int argc, char* argv[]) {
-       
-    std::cout << "Usage: output_file distribution count min max" << std::endl;
+
+    std::cout << "Usage: output_file distribution count min max [seed] [threads]" << std::endl;
     std::cout << "\toutput_file - a filename" << std::endl;
     std::cout << "\tDistribution: g/n - Gauss/normal; a=mean; b=stddev" << std::endl;
     std::cout << "\t              u - uniform; a=min; b=max" << std::endl;
     std::cout << "\t              e - exponential; a=lambda; b=0" << std::endl;
     std::cout << "\t              p - Poisson; a=mean; b=0" << std::endl;
+    std::cout << "\tseed - the same seed gives the same file for any thread count (" << DEFAULT_SEED << ")" << std::endl;
+    std::cout << "\tthreads - writing threads (all processors)" << std::endl;
 
-    if (argc != 6) {
+    if (argc < 6 || argc > 8) {
         std::cout << "Invalid number of parameters. Exiting..." << std::endl;
         return __LINE__;
     }
 
 
-    const size_t count = std::strtoull(argv[3], nullptr, 0);
+    const uint64_t count = std::strtoull(argv[3], nullptr, 0);
     const double a = std::strtod(argv[4], nullptr);
     const double b = std::strtod(argv[5], nullptr);
+    const uint64_t seed = argc > 6 ? std::strtoull(argv[6], nullptr, 0) : DEFAULT_SEED;
+    const unsigned threads = argc > 7 ? static_cast<unsigned>(std::strtoul(argv[7], nullptr, 0)) : std::max(1u, std::thread::hardware_concurrency());
+
+    if (threads == 0) {
+        std::cout << "Thread count must be positive. Exiting..." << std::endl;
+        return __LINE__;
+    }
 
-    
-      
     switch (*argv[2]) {
         case 'g': [[fallthrough]];
-        case 'n': Generate_Numbers<std::normal_distribution<>>(argv[1], count, a, b);
-            break;
+        case 'n': break;
 
-        case 'u': 
+        case 'u':
             {
                 if (a >= b) {
                     std::cout << "Minimum must be less than maximum. Exiting..." << std::endl;
                     return __LINE__;
                 }
-                Generate_Numbers<std::uniform_real_distribution<>>(argv[1], count, a, b);
             }
             break;
 
-        case 'e': Generate_Numbers<std::exponential_distribution<>>(argv[1], count, a);
-            break;
-
-        case 'p': Generate_Numbers<std::poisson_distribution<>>(argv[1], count, a);
-            break;
+        case 'e': [[fallthrough]];
+        case 'p': break;
 
 
         default:
             std::cout << "Unknown distribution! Exiting..." << std::endl;
             return __LINE__;
     }
-            
+
+    if (!Generate_Numbers(argv[1], count, *argv[2], a, b, seed, threads)) {
+        return __LINE__;
+    }
+
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,522 @@
+#include "include/benchmark.h"
+#include "include/executor.h"
+
+#include <intrin.h>
+#include <thread>
+#include <random>
+#include <fstream>
+
+namespace ppr::bench
+{
+	/// <summary>
+	/// Best time of BENCH_REPEAT runs
+	/// </summary>
+	/// <typeparam name="Body">- Measured function</typeparam>
+	/// <param name="body">- Measured function</param>
+	/// <param name="passes">- Passes in one run (small inputs are scanned repeatedly)</param>
+	/// <returns>Seconds of one pass</returns>
+	template <typename Body>
+	double best_time(Body body, long long passes = 1)
+	{
+		double best = std::numeric_limits<double>::max();
+
+		for (int r = 0; r < BENCH_REPEAT; r++)
+		{
+			tbb::tick_count t0 = tbb::tick_count::now();
+			for (long long p = 0; p < passes; p++)
+			{
+				body();
+			}
+			tbb::tick_count t1 = tbb::tick_count::now();
+			best = std::min(best, (t1 - t0).seconds() / passes);
+		}
+
+		return best;
+	}
+
+	/// <summary>
+	/// Time stamp counter ticks per second. Bytes per cycle are computed in these reference cycles
+	/// </summary>
+	/// <returns>Frequency in Hz</returns>
+	static double measure_tsc_frequency()
+	{
+		tbb::tick_count t0 = tbb::tick_count::now();
+		const unsigned long long c0 = __rdtsc();
+
+		while ((tbb::tick_count::now() - t0).seconds() < BENCH_TSC_SECONDS)
+		{
+		}
+
+		const unsigned long long c1 = __rdtsc();
+		return static_cast<double>(c1 - c0) / (tbb::tick_count::now() - t0).seconds();
+	}
+
+	/// <summary>
+	/// Thread counts: powers of two and all logical processors
+	/// </summary>
+	/// <returns>Thread counts</returns>
+	static std::vector<int> thread_counts()
+	{
+		const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+		std::vector<int> counts;
+		for (int t = 1; t < cores; t *= 2)
+		{
+			counts.push_back(t);
+		}
+		counts.push_back(cores);
+
+		return counts;
+	}
+
+	/// <summary>
+	/// Fill data with values of given shape
+	/// </summary>
+	/// <param name="data">- Data</param>
+	/// <param name="shape">- Index to BENCH_SHAPE_NAMES</param>
+	static void generate_data(std::vector<double>& data, int shape)
+	{
+		std::mt19937_64 generator(BENCH_SEED);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		std::normal_distribution<double> gauss(0.0, 1.0);
+		std::exponential_distribution<double> exponential(1.0);
+		std::poisson_distribution<int> poisson(10.0);
+
+		for (double& value : data)
+		{
+			switch (shape)
+			{
+			case 0: value = uniform(generator); break;
+			case 1: value = gauss(generator); break;
+			case 2: value = exponential(generator); break;
+			default: value = static_cast<double>(poisson(generator)); break;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Print one measurement and add it to results
+	/// </summary>
+	/// <param name="records">- Measurements</param>
+	/// <param name="record">- New measurement</param>
+	static void add_record(std::vector<SBench_record>& records, const SBench_record& record)
+	{
+		std::cout << "> " << record.kernel << (record.variant.empty() ? "" : " [" + record.variant + "]") << "\t" << record.shape << "\t" << record.level
+			<< "\t" << record.bins << "\t" << record.threads << "\t" << (record.seconds * 1e9 / record.count) << "\t" << (record.bytes / record.seconds / 1e9) << std::endl;
+		records.push_back(record);
+	}
+
+	int run(int argc, char** argv)
+	{
+		const std::string file = argc > 2 ? argv[2] : BENCH_FILE;
+		std::vector<SBench_record> records;
+
+		std::cout << "\t\t\t[Benchmark]" << std::endl;
+		std::cout << "---------------------------------------------------------------------" << std::endl;
+
+		const double tsc_frequency = measure_tsc_frequency();
+		std::cout << "> TSC frequency:\t\t" << tsc_frequency / 1e9 << " GHz" << std::endl;
+		std::cout << std::endl;
+
+		run_kernel_benchmark(records);
+		run_stat_benchmark(records);
+		run_rss_benchmark(records);
+
+		if (!save_records(records, tsc_frequency, file))
+		{
+			ppr::print_error("Cannot write benchmark results");
+			return EExitStatus::FILE;
+		}
+
+		std::cout << "> Results:\t\t\t" << file << std::endl;
+		return EExitStatus::SUCCESS;
+	}
+
+	void run_kernel_benchmark(std::vector<SBench_record>& records)
+	{
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		const unsigned int stats = registry.required_stats(registry.select({ "all" }));
+		const std::vector<int> threads = thread_counts();
+
+		std::vector<double> data(BENCH_LEVEL_COUNTS[BENCH_LEVEL_COUNT - 1]);
+
+		std::cout << "> Kernels (ns/value, GB/s of input)" << std::endl;
+		std::cout << "> kernel\tshape\tlevel\tbins\tthreads\tns/value\tGB/s" << std::endl;
+
+		for (int shape = 0; shape < BENCH_SHAPE_COUNT; shape++)
+		{
+			generate_data(data, shape);
+
+			// Limits of whole data hold for every prefix
+			SDataStat limits;
+			limits.stats = ppr::dist::STAT_BASE;
+			ppr::parallel::get_statistics_vectorized(limits, static_cast<long long>(data.size()), data.data());
+			limits.mean = limits.sum / limits.n;
+
+			for (int level = 0; level < BENCH_LEVEL_COUNT; level++)
+			{
+				const long long count = BENCH_LEVEL_COUNTS[level];
+				const long long passes = std::max(1LL, BENCH_MIN_VALUES / count);
+
+				SBench_record record;
+				record.shape = BENCH_SHAPE_NAMES[shape];
+				record.level = BENCH_LEVEL_NAMES[level];
+				record.count = count;
+				record.bytes = static_cast<double>(count * sizeof(double));
+
+				// Statistics pass with statistics of all registered distributions
+				record.kernel = "get_statistics_vectorized";
+				record.seconds = best_time([&]() {
+					SDataStat stat;
+					stat.stats = stats;
+					ppr::parallel::get_statistics_vectorized(stat, count, data.data());
+					}, passes);
+				add_record(records, record);
+
+				record.kernel = "Running_stat_parallel";
+				for (int t : threads)
+				{
+					tbb::task_arena arena(t);
+					record.threads = t;
+					record.seconds = best_time([&]() {
+						Running_stat_parallel stat(data.data(), 0, stats);
+						ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat, 1, count);
+						}, passes);
+					add_record(records, record);
+				}
+
+				// Histogram pass
+				for (int bins : BENCH_BINS)
+				{
+					SHistogram hist;
+					hist.binCount = bins;
+					hist.min = limits.min;
+					hist.max = limits.max;
+					hist.binSize = (hist.max - hist.min) / bins;
+					hist.scaleFactor = 1.0 / hist.binSize;
+
+					record.bins = bins;
+					record.threads = 1;
+					record.kernel = "get_histogram_vectorized";
+					std::vector<int> frequency(bins);
+					record.seconds = best_time([&]() {
+						double variance = 0.0;
+						ppr::parallel::get_histogram_vectorized(frequency, variance, count, data.data(), hist, limits);
+						}, passes);
+					add_record(records, record);
+
+					record.kernel = "Histogram_parallel";
+					for (int t : threads)
+					{
+						tbb::task_arena arena(t);
+						record.threads = t;
+						record.seconds = best_time([&]() {
+							ppr::hist::Histogram_parallel hist_cpu(bins, hist.binSize, hist.min, hist.max, data.data(), limits.mean);
+							ppr::executor::run_with_tbb<ppr::hist::Histogram_parallel>(arena, hist_cpu, 0, count);
+							}, passes);
+						add_record(records, record);
+					}
+				}
+			}
+		}
+
+		std::cout << std::endl;
+	}
+
+	void run_stat_benchmark(std::vector<SBench_record>& records)
+	{
+		// Positive data inside (0, 1), so every logarithmic sum is finite
+		std::vector<double> data(STAT_BENCH_COUNT);
+		for (long long i = 0; i < STAT_BENCH_COUNT; i++)
+		{
+			data[i] = (static_cast<double>(i % 9973) + 0.5) / 9973.0;
+		}
+
+		auto measure_statistics = [&](unsigned int stats) {
+			return best_time([&]() {
+				SDataStat stat;
+				stat.stats = stats;
+				ppr::parallel::get_statistics_vectorized(stat, static_cast<long long>(data.size()), data.data());
+				});
+		};
+
+		SBench_record record;
+		record.kernel = "get_statistics_vectorized";
+		record.shape = "uniform";
+		record.count = STAT_BENCH_COUNT;
+		record.bytes = static_cast<double>(STAT_BENCH_COUNT * sizeof(double));
+
+		const double base = measure_statistics(ppr::dist::STAT_BASE);
+		record.variant = "n, sum, min, max";
+		record.seconds = base;
+		records.push_back(record);
+
+		std::cout << "> Statistics pass (one thread, " << STAT_BENCH_COUNT << " values)" << std::endl;
+		std::cout << "> statistic		time [sec]	ns/value	overhead" << std::endl;
+		std::cout << "> n, sum, min, max	" << base << "	" << (base * 1e9 / STAT_BENCH_COUNT) << "		-" << std::endl;
+
+		// Variance is collected together with histogram, so only logarithmic sums are measured
+		for (int bit = 1; bit < ppr::dist::SUFFICIENT_STAT_COUNT; bit++)
+		{
+			const double time = measure_statistics(1u << bit);
+			record.variant = ppr::dist::SUFFICIENT_STAT_NAMES[bit];
+			record.seconds = time;
+			records.push_back(record);
+			std::cout << "> + " << ppr::dist::SUFFICIENT_STAT_NAMES[bit] << "	" << time << "	" << (time * 1e9 / STAT_BENCH_COUNT) << "		+" << (100.0 * (time - base) / base) << " %" << std::endl;
+		}
+
+		const double all = measure_statistics(ppr::dist::STAT_LOG_SUMS);
+		record.variant = "all log sums";
+		record.seconds = all;
+		records.push_back(record);
+		std::cout << "> + all log sums	" << all << "	" << (all * 1e9 / STAT_BENCH_COUNT) << "		+" << (100.0 * (all - base) / base) << " %" << std::endl;
+		std::cout << std::endl;
+	}
+
+	void run_rss_benchmark(std::vector<SBench_record>& records)
+	{
+		SConfig configuration;
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		const std::vector<int> threads = thread_counts();
+
+		std::cout << "> RSS stage (fused = all " << registry.size() << " distributions in one parallel sweep)" << std::endl;
+		std::cout << "> bins\t\tfused [sec]\tfused [ns/bin]\tsequential [sec]" << std::endl;
+
+		for (int bins = RSS_BENCH_MIN_BINS; bins <= RSS_BENCH_MAX_BINS; bins *= 10)
+		{
+			// Density histogram of standard normal data on interval <-6, 6>
+			SHistogram hist;
+			hist.binCount = bins;
+			hist.min = -6.0;
+			hist.max = 6.0;
+			hist.binSize = (hist.max - hist.min) / bins;
+
+			std::vector<double> density(bins);
+			for (int i = 0; i < bins; i++)
+			{
+				double x = hist.min + (i * hist.binSize);
+				density[i] = exp(-0.5 * x * x) * ppr::rss::INV_SQRT_DOUBLE_PI;
+			}
+
+			SDataStat stat;
+			stat.n = bins;
+			stat.mean = 0.0;
+			stat.variance = 1.0;
+			stat.min = hist.min;
+			stat.max = hist.max;
+			stat.isNegative = true;
+
+			SResult res;
+			ppr::executor::fit_distributions(configuration, stat, res);
+
+			double fused = std::numeric_limits<double>::max();
+			double sequential = std::numeric_limits<double>::max();
+
+			for (int r = 0; r < BENCH_REPEAT; r++)
+			{
+				ppr::parallel::calculate_histogram_RSS_cpu(res, density, hist);
+				fused = std::min(fused, res.total_rss_time);
+
+				tbb::tick_count t0 = tbb::tick_count::now();
+				ppr::hist::Histogram seq_hist(bins, hist.binSize, hist.min, hist.max);
+				for (auto& fit : res.fits)
+				{
+					if (fit.valid)
+					{
+						seq_hist.compute_rss_histogram(density, fit);
+					}
+				}
+				tbb::tick_count t1 = tbb::tick_count::now();
+				sequential = std::min(sequential, (t1 - t0).seconds());
+			}
+
+			std::cout << "> " << bins << "\t" << (bins < 10000000 ? "\t" : "") << fused << "\t" << (fused * 1e9 / bins) << "\t\t" << sequential << std::endl;
+
+			SBench_record record;
+			record.shape = "gauss";
+			record.count = bins;
+			record.bins = bins;
+			record.bytes = static_cast<double>(bins * sizeof(double));
+
+			// Fused sweep for every thread count
+			record.kernel = "calculate_histogram_RSS_cpu";
+			for (int t : threads)
+			{
+				tbb::task_arena arena(t);
+				record.threads = t;
+				record.seconds = best_time([&]() {
+					arena.execute([&]() { ppr::parallel::calculate_histogram_RSS_cpu(res, density, hist); });
+					});
+				records.push_back(record);
+			}
+
+			// Every distribution alone on one thread
+			record.threads = 1;
+			record.kernel = "rss::pdf_batch";
+			for (const SDistribution_fit& fit : res.fits)
+			{
+				if (!fit.valid)
+				{
+					continue;
+				}
+
+				const ppr::dist::SDistribution_plugin& plugin = registry.get(fit.id);
+				record.variant = plugin.name;
+				record.seconds = best_time([&]() {
+					double pdf[ppr::rss::RSS_BATCH_SIZE];
+					volatile double rss = 0.0;
+					for (std::size_t begin = 0; begin < density.size(); begin += ppr::rss::RSS_BATCH_SIZE)
+					{
+						const std::size_t size = std::min(ppr::rss::RSS_BATCH_SIZE, density.size() - begin);
+						plugin.pdf_batch(fit, hist.min + (static_cast<double>(begin) * hist.binSize), hist.binSize, pdf, size);
+						rss = rss + ppr::rss::squared_residuals(density.data() + begin, pdf, size);
+					}
+					});
+				records.push_back(record);
+			}
+
+			// Stages around RSS: frequency to density histogram and choice of the best distribution
+			record.variant.clear();
+			record.kernel = "compute_propability_density_histogram";
+			record.bytes = static_cast<double>(bins * sizeof(int));
+			std::vector<int> frequency(bins, 1);
+			record.seconds = best_time([&]() {
+				ppr::executor::compute_propability_density_histogram(hist, frequency, density, bins);
+				});
+			records.push_back(record);
+
+			record.kernel = "analyze_results";
+			record.count = static_cast<long long>(res.fits.size());
+			record.bytes = static_cast<double>(res.fits.size() * sizeof(SDistribution_fit));
+			record.seconds = best_time([&]() {
+				ppr::executor::analyze_results(configuration, res);
+				}, BENCH_MIN_VALUES / record.count);
+			records.push_back(record);
+		}
+
+		std::cout << std::endl;
+		std::cout << "> RSS stage of Poisson-like data (integer bins, lambda = bins / 2)" << std::endl;
+		std::cout << "> bins\t\tfused [sec]\tfused [ns/bin]" << std::endl;
+
+		for (int bins = RSS_BENCH_MIN_BINS; bins <= RSS_BENCH_MAX_BINS; bins *= 10)
+		{
+			SHistogram hist;
+			hist.binCount = bins;
+			hist.min = 0.0;
+			hist.max = bins;
+			hist.binSize = 1.0;
+
+			SDataStat stat;
+			stat.n = bins;
+			stat.sum = bins * (bins / 2.0);
+			stat.mean = bins / 2.0;
+			stat.variance = stat.mean;
+			stat.min = hist.min;
+			stat.max = hist.max;
+			stat.isInteger = true;
+
+			SResult res;
+			ppr::executor::fit_distributions(configuration, stat, res);
+
+			std::vector<double> density(bins);
+			ppr::rss::PoissonDistribution poisson(stat.mean);
+			for (int i = 0; i < bins; i++)
+			{
+				density[i] = poisson.Pdf(i);
+			}
+
+			double fused = std::numeric_limits<double>::max();
+			for (int r = 0; r < BENCH_REPEAT; r++)
+			{
+				ppr::parallel::calculate_histogram_RSS_cpu(res, density, hist);
+				fused = std::min(fused, res.total_rss_time);
+			}
+
+			std::cout << "> " << bins << "\t" << (bins < 10000000 ? "\t" : "") << fused << "\t" << (fused * 1e9 / bins) << std::endl;
+
+			SBench_record record;
+			record.kernel = "calculate_histogram_RSS_cpu";
+			record.shape = "poisson";
+			record.count = bins;
+			record.bins = bins;
+			record.threads = static_cast<int>(std::thread::hardware_concurrency());
+			record.seconds = fused;
+			record.bytes = static_cast<double>(bins * sizeof(double));
+			records.push_back(record);
+		}
+
+		std::cout << std::endl;
+	}
+
+	/// <summary>
+	/// Quote string for JSON
+	/// </summary>
+	/// <param name="value">- String</param>
+	/// <returns>JSON string</returns>
+	static std::string quoted(const std::string& value)
+	{
+		std::string result = "\"";
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				result += '\\';
+			}
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	bool save_records(const std::vector<SBench_record>& records, double tsc_frequency, const std::string& file)
+	{
+		std::ofstream out(file);
+		if (!out.good())
+		{
+			return false;
+		}
+
+		const bool csv = file.size() >= 4 && file.compare(file.size() - 4, 4, ".csv") == 0;
+		out.precision(9);
+
+		if (csv)
+		{
+			out << "kernel,variant,shape,level,count,bins,threads,seconds,ns_per_element,gb_per_s,bytes_per_cycle" << std::endl;
+		}
+		else
+		{
+			out << "{" << std::endl;
+			out << "  \"tsc_hz\": " << tsc_frequency << "," << std::endl;
+			out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+			out << "  \"records\": [" << std::endl;
+		}
+
+		for (std::size_t i = 0; i < records.size(); i++)
+		{
+			const SBench_record& r = records[i];
+			const double ns_per_element = r.seconds * 1e9 / r.count;
+			const double gb_per_s = r.bytes / r.seconds / 1e9;
+			const double bytes_per_cycle = r.bytes / (r.seconds * tsc_frequency);
+
+			if (csv)
+			{
+				out << r.kernel << ",\"" << r.variant << "\"," << r.shape << "," << r.level << "," << r.count << "," << r.bins << "," << r.threads << ","
+					<< r.seconds << "," << ns_per_element << "," << gb_per_s << "," << bytes_per_cycle << std::endl;
+			}
+			else
+			{
+				out << "    {\"kernel\": " << quoted(r.kernel) << ", \"variant\": " << quoted(r.variant) << ", \"shape\": " << quoted(r.shape)
+					<< ", \"level\": " << quoted(r.level) << ", \"count\": " << r.count << ", \"bins\": " << r.bins << ", \"threads\": " << r.threads
+					<< ", \"seconds\": " << r.seconds << ", \"ns_per_element\": " << ns_per_element << ", \"gb_per_s\": " << gb_per_s
+					<< ", \"bytes_per_cycle\": " << bytes_per_cycle << "}" << (i + 1 < records.size() ? "," : "") << std::endl;
+			}
+		}
+
+		if (!csv)
+		{
+			out << "  ]" << std::endl;
+			out << "}" << std::endl;
+		}
+
+		return out.good();
+	}
+}
@@ -0,0 +1,482 @@
+#include "include/calibration.h"
+#include "include/executor.h"
+#include "include/file_mapping.h"
+#include "include/gpu_utils.h"
+#include "include/smp_utils.h"
+#include "include/telemetry.h"
+#include "include/roofline.h"
+#include "include/device_check.h"
+
+#include <thread>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+namespace ppr::calibration
+{
+	/// <summary>
+	/// Best time of CALIBRATION_REPEAT runs
+	/// </summary>
+	/// <typeparam name="Body">- Measured function</typeparam>
+	/// <param name="body">- Measured function</param>
+	/// <returns>Seconds</returns>
+	template <typename Body>
+	double best_time(Body body)
+	{
+		double best = std::numeric_limits<double>::max();
+
+		for (int r = 0; r < CALIBRATION_REPEAT; r++)
+		{
+			tbb::tick_count t0 = tbb::tick_count::now();
+			body();
+			tbb::tick_count t1 = tbb::tick_count::now();
+			best = std::min(best, (t1 - t0).seconds());
+		}
+
+		return best;
+	}
+
+	double measure_cpu(tbb::task_arena& arena, std::vector<double>& data, unsigned int stats, SHistogram* hist)
+	{
+		// Data are split between threads as in optimized SMP run
+		const int partitions = arena.max_concurrency();
+		const long long count = static_cast<long long>(data.size());
+		const long long partition = (count + partitions - 1) / partitions;
+
+		SDataStat stat;
+		stat.mean = 0.5;
+		stat.min = 0.0;
+		std::vector<std::vector<int>> frequency(partitions, std::vector<int>(hist ? hist->binCount : 0));
+
+		const double seconds = best_time([&]() {
+			arena.execute([&]() {
+				tbb::parallel_for(0, partitions, [&](int p) {
+					const long long begin = std::min(count, p * partition);
+					const long long size = std::min(count, begin + partition) - begin;
+
+					if (hist)
+					{
+						double variance = 0.0;
+						ppr::parallel::get_histogram_vectorized(frequency[p], variance, size, data.data() + begin, *hist, stat);
+					}
+					else
+					{
+						SDataStat local_stat;
+						local_stat.stats = stats;
+						ppr::parallel::get_statistics_vectorized(local_stat, size, data.data() + begin);
+					}
+					});
+				});
+			});
+
+		return static_cast<double>(count) / seconds;
+	}
+
+	void measure_cpu_backend(SProfile& profile, std::vector<double>& data, unsigned int stats)
+	{
+		const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+		// Thread counts: powers of two, all logical processors and two threads per processor
+		std::vector<int> thread_counts;
+		for (int t = 1; t < cores; t *= 2)
+		{
+			thread_counts.push_back(t);
+		}
+		thread_counts.push_back(cores);
+		thread_counts.push_back(2 * cores);
+
+		std::cout << "> threads\tstatistics [Mvalues/s]" << std::endl;
+		for (int threads : thread_counts)
+		{
+			tbb::task_arena arena(threads);
+			const double throughput = measure_cpu(arena, data, stats, nullptr);
+			std::cout << "> " << threads << "\t\t" << throughput / 1e6 << std::endl;
+
+			if (throughput > profile.cpu_stat_throughput)
+			{
+				profile.cpu_stat_throughput = throughput;
+				profile.thread_count = threads;
+			}
+		}
+
+		// Histogram with the same bin count as real run
+		SHistogram hist;
+		hist.binCount = static_cast<int>(log2(data.size())) + 2;
+		hist.min = 0.0;
+		hist.max = 1.0;
+		hist.binSize = 1.0 / hist.binCount;
+		hist.scaleFactor = hist.binCount;
+
+		tbb::task_arena arena(profile.thread_count);
+		profile.cpu_hist_throughput = measure_cpu(arena, data, stats, &hist);
+
+		tbb::task_arena single(1);
+		tbb::task_arena all(cores);
+		profile.memory_bandwidth_single = ppr::roofline::measure_stream(single).read;
+		const ppr::roofline::SStream stream = ppr::roofline::measure_stream(all);
+		profile.memory_bandwidth = stream.read;
+		profile.memory_triad = stream.triad;
+	}
+
+	/// <summary>
+	/// Relative cost of progress counters in statistics scan. Partitions are scanned as in optimized SMP run, once at once
+	/// and once by telemetry blocks with counter update after every block
+	/// </summary>
+	/// <param name="arena">- TBB arena</param>
+	/// <param name="data">- Input values</param>
+	/// <param name="stats">- Collected sufficient statistics</param>
+	/// <returns>Overhead (0.01 = 1 %)</returns>
+	static double measure_telemetry_overhead(tbb::task_arena& arena, std::vector<double>& data, unsigned int stats)
+	{
+		const int partitions = arena.max_concurrency();
+		const long long count = static_cast<long long>(data.size());
+		const long long partition = (count + partitions - 1) / partitions;
+		ppr::watchdog::Telemetry telemetry(partitions);
+
+		auto scan = [&](bool counted) {
+			arena.execute([&]() {
+				tbb::parallel_for(0, partitions, [&](int p) {
+					const long long begin = std::min(count, p * partition);
+					const long long size = std::min(count, begin + partition) - begin;
+					const long long block_size = counted ? ppr::watchdog::TELEMETRY_BLOCK_VALUES : std::max(size, 1LL);
+					SDataStat local_stat;
+
+					for (long long block = 0; block < size; block += block_size)
+					{
+						SDataStat block_stat;
+						block_stat.stats = stats;
+						ppr::parallel::get_statistics_vectorized(block_stat, std::min(block_size, size - block), data.data() + begin + block);
+						local_stat.merge(block_stat);
+
+						if (counted)
+						{
+							telemetry.add(EIteration::STAT, p, std::min(block_size, size - block));
+						}
+					}
+					});
+				});
+		};
+
+		// Runs alternate, so that frequency scaling and page cache affect both variants equally
+		double plain = std::numeric_limits<double>::max();
+		double counted = std::numeric_limits<double>::max();
+		for (int r = 0; r < CALIBRATION_REPEAT; r++)
+		{
+			plain = std::min(plain, best_time([&]() { scan(false); }));
+			counted = std::min(counted, best_time([&]() { scan(true); }));
+		}
+
+		return (counted - plain) / plain;
+	}
+
+	void measure_devices(SProfile& profile, std::vector<double>& data, unsigned int stats)
+	{
+		SConfig configuration;
+		std::vector<cl::Device> devices;
+		std::vector<std::string> all_devices;
+		ppr::gpu::find_opencl_devices(devices, all_devices);
+		std::vector<ppr::check::SCheck_data> check_sets = ppr::check::create_data(ppr::check::CHECK_COUNT);
+
+		for (cl::Device& device : devices)
+		{
+			ppr::gpu::SOpenCLConfig opencl;
+			opencl.device = device;
+			ppr::gpu::set_kernel_program(opencl, STAT_KERNEL, STAT_KERNEL_NAME, STAT_REDUCE_KERNEL_NAME);
+
+			if (opencl.wg_size == 0)
+			{
+				continue;
+			}
+
+			std::string device_name = device.getInfo<CL_DEVICE_NAME>();
+
+			// Data sets of device check have different flags and extremes
+			std::string difference;
+			const bool same = std::all_of(check_sets.begin(), check_sets.end(), [&](ppr::check::SCheck_data& set) {
+				return ppr::check::check_statistics(opencl, set, difference);
+				});
+			if (!same)
+			{
+				ppr::print_error("statistics of '" + device_name + "' differ from CPU (" + difference + " ), device is not used");
+				continue;
+			}
+
+			// Program build is not measured, transfers are
+			const unsigned long long count = data.size();
+			opencl.data_count_for_gpu = count;
+
+			const double seconds = best_time([&]() {
+				SDataStat stat;
+				stat.stats = stats;
+				ppr::gpu::run_statistics_on_GPU(stat, opencl, configuration, data.data(), 0, count - 1);
+				});
+
+			SDevice_profile device_profile;
+			device_profile.name = device_name;
+			device_profile.stat_throughput = static_cast<double>(count) / seconds;
+			profile.devices.push_back(device_profile);
+		}
+	}
+
+	void measure_io(SProfile& profile, const char* file_name)
+	{
+		SConfig configuration;
+		configuration.input_fn = file_name;
+		configuration.mode = ERun_mode::SMP;
+
+		File_mapping mapping(configuration);
+		if (!mapping.open_mapping())
+		{
+			ppr::print_error("Cannot map sample file");
+			return;
+		}
+
+		const unsigned long long granularity = mapping.get_granularity();
+		const unsigned long long budget = std::min(mapping.get_file_len(), CALIBRATION_IO_BYTES);
+
+		// Window candidates. Every candidate reads its own part of the file, so that page cache of previous candidate does not help
+		std::vector<unsigned long long> windows;
+		for (unsigned long long window = WINDOW_MIN_SCALE * granularity; window <= mapping.get_window_size(); window *= 2)
+		{
+			windows.push_back(window);
+		}
+		while (!windows.empty() && windows.back() > budget / windows.size())
+		{
+			windows.pop_back();
+		}
+
+		if (windows.empty())
+		{
+			ppr::print_error("Sample file is too small for I/O measurement");
+			mapping.close_mapping();
+			return;
+		}
+
+		const unsigned long long part = ((budget / windows.size()) / granularity) * granularity;
+		tbb::task_arena arena(profile.thread_count);
+
+		std::cout << "> window [MB]\tI/O [MB/s]" << std::endl;
+		for (size_t i = 0; i < windows.size(); i++)
+		{
+			const unsigned long long window = windows[i];
+			unsigned long long bytes = 0;
+
+			tbb::tick_count t0 = tbb::tick_count::now();
+			for (unsigned long long offset = i * part; offset + window <= (i + 1) * part; offset += window)
+			{
+				double* view = mapping.map_window(offset, window);
+				if (view == nullptr)
+				{
+					break;
+				}
+
+				Running_stat_parallel stat(view, 0);
+				ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat, 1, window / sizeof(double));
+				mapping.unmap_window(view);
+				bytes += window;
+			}
+			tbb::tick_count t1 = tbb::tick_count::now();
+
+			const double throughput = static_cast<double>(bytes) / (t1 - t0).seconds();
+			std::cout << "> " << window / (1024.0 * 1024.0) << "\t\t" << throughput / (1024.0 * 1024.0) << std::endl;
+
+			if (throughput > profile.io_throughput)
+			{
+				profile.io_throughput = throughput;
+				profile.window_size = window;
+			}
+		}
+
+		mapping.close_mapping();
+	}
+
+	int run(int argc, char** argv)
+	{
+		std::cout << "\t\t\t[Calibration]" << std::endl;
+		std::cout << "---------------------------------------------------------------------" << std::endl;
+
+		SProfile profile;
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		const unsigned int stats = registry.required_stats(registry.select({}));
+
+		// Positive data inside (0, 1), so every logarithmic sum is finite
+		std::vector<double> data(CALIBRATION_COUNT);
+		for (long long i = 0; i < CALIBRATION_COUNT; i++)
+		{
+			data[i] = (static_cast<double>(i % 9973) + 0.5) / 9973.0;
+		}
+
+		measure_cpu_backend(profile, data, stats);
+
+		tbb::task_arena arena(profile.thread_count);
+		const double telemetry_overhead = measure_telemetry_overhead(arena, data, stats);
+
+		measure_devices(profile, data, stats);
+
+		if (argc > 2)
+		{
+			measure_io(profile, argv[2]);
+			profile.storage_bandwidth = ppr::roofline::measure_sequential_read(argv[2]);
+		}
+
+		std::cout << std::endl;
+		std::cout << "> Memory bandwidth (1 thread):\t" << profile.memory_bandwidth_single << " GB/s" << std::endl;
+		std::cout << "> Memory bandwidth:\t\t" << profile.memory_bandwidth << " GB/s (triad " << profile.memory_triad << " GB/s)" << std::endl;
+		std::cout << "> Threads:\t\t\t" << profile.thread_count << std::endl;
+		std::cout << "> CPU statistics:\t\t" << profile.cpu_stat_throughput / 1e6 << " Mvalues/s" << std::endl;
+		std::cout << "> CPU histogram:\t\t" << profile.cpu_hist_throughput / 1e6 << " Mvalues/s" << std::endl;
+		std::cout << "> Telemetry overhead:\t\t" << 100.0 * telemetry_overhead << " %" << std::endl;
+		if (telemetry_overhead > ppr::watchdog::TELEMETRY_MAX_OVERHEAD)
+		{
+			ppr::print_error("Progress counters slow down the scan by more than " + std::to_string(100.0 * ppr::watchdog::TELEMETRY_MAX_OVERHEAD) + " %");
+		}
+		for (const SDevice_profile& device : profile.devices)
+		{
+			std::cout << "> " << device.name << ":\t" << device.stat_throughput / 1e6 << " Mvalues/s (with transfers)" << std::endl;
+		}
+		if (profile.window_size != 0)
+		{
+			std::cout << "> I/O:\t\t\t\t" << profile.io_throughput / (1024.0 * 1024.0) << " MB/s" << std::endl;
+			std::cout << "> Window:\t\t\t" << profile.window_size / (1024.0 * 1024.0) << " MB" << std::endl;
+		}
+		if (profile.storage_bandwidth > 0.0)
+		{
+			std::cout << "> Storage bandwidth:\t\t" << profile.storage_bandwidth << " GB/s" << std::endl;
+		}
+
+		if (!save_profile(profile, PROFILE_FILE))
+		{
+			ppr::print_error("Cannot write tuning profile");
+			return EExitStatus::FILE;
+		}
+
+		std::cout << "> Tuning profile:\t\t" << PROFILE_FILE << std::endl;
+		return EExitStatus::SUCCESS;
+	}
+
+	bool save_profile(const SProfile& profile, const char* file)
+	{
+		std::ofstream out(file);
+		if (!out.good())
+		{
+			return false;
+		}
+
+		out.precision(17);
+		out << "memory_bandwidth_single=" << profile.memory_bandwidth_single << std::endl;
+		out << "memory_bandwidth=" << profile.memory_bandwidth << std::endl;
+		out << "memory_triad=" << profile.memory_triad << std::endl;
+		out << "thread_count=" << profile.thread_count << std::endl;
+		out << "cpu_stat_throughput=" << profile.cpu_stat_throughput << std::endl;
+		out << "cpu_hist_throughput=" << profile.cpu_hist_throughput << std::endl;
+		out << "io_throughput=" << profile.io_throughput << std::endl;
+		out << "storage_bandwidth=" << profile.storage_bandwidth << std::endl;
+		out << "window_size=" << profile.window_size << std::endl;
+
+		// Throughput goes first, device name may contain anything
+		for (const SDevice_profile& device : profile.devices)
+		{
+			out << "device=" << device.stat_throughput << ";" << device.name << std::endl;
+		}
+
+		return out.good();
+	}
+
+	bool load_profile(SProfile& profile, const char* file)
+	{
+		std::ifstream in(file);
+		if (!in.good())
+		{
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(in, line))
+		{
+			const size_t separator = line.find('=');
+			if (separator == std::string::npos)
+			{
+				continue;
+			}
+
+			const std::string key = line.substr(0, separator);
+			const std::string value = line.substr(separator + 1);
+
+			if (key == "memory_bandwidth_single") profile.memory_bandwidth_single = std::stod(value);
+			else if (key == "memory_bandwidth") profile.memory_bandwidth = std::stod(value);
+			else if (key == "memory_triad") profile.memory_triad = std::stod(value);
+			else if (key == "thread_count") profile.thread_count = std::stoi(value);
+			else if (key == "cpu_stat_throughput") profile.cpu_stat_throughput = std::stod(value);
+			else if (key == "cpu_hist_throughput") profile.cpu_hist_throughput = std::stod(value);
+			else if (key == "io_throughput") profile.io_throughput = std::stod(value);
+			else if (key == "storage_bandwidth") profile.storage_bandwidth = std::stod(value);
+			else if (key == "window_size") profile.window_size = std::stoull(value);
+			else if (key == "device")
+			{
+				const size_t name = value.find(';');
+				if (name == std::string::npos)
+				{
+					continue;
+				}
+
+				SDevice_profile device;
+				device.stat_throughput = std::stod(value.substr(0, name));
+				device.name = value.substr(name + 1);
+				profile.devices.push_back(device);
+			}
+		}
+
+		return profile.thread_count > 0 && profile.cpu_stat_throughput > 0.0;
+	}
+
+	bool configure(SConfig& configuration)
+	{
+		SProfile profile;
+		if (!load_profile(profile, PROFILE_FILE))
+		{
+			ppr::print_error(std::string("Tuning profile '") + PROFILE_FILE + "' not found. Run 'pprsolver.exe calibrate' first.");
+			return false;
+		}
+
+		std::ifstream file(configuration.input_fn, std::ios::binary | std::ios::ate);
+		const unsigned long long file_len = static_cast<unsigned long long>(file.tellg());
+
+		double gpu = 0.0;
+		for (const SDevice_profile& device : profile.devices)
+		{
+			gpu += device.stat_throughput;
+		}
+		const double cpu = profile.cpu_stat_throughput;
+		const double cpu_share = cpu / (cpu + gpu);
+
+		// File bigger than memory budget is read from disk. If disk is slower than CPU, OpenCL devices do not help
+		const bool io_bound = file_len > static_cast<unsigned long long>(MAX_FILE_SIZE_MEM_1gb) &&
+			profile.io_throughput > 0.0 && (profile.io_throughput / sizeof(double)) < cpu;
+
+		if (profile.devices.empty() || io_bound || cpu_share > 1.0 - AUTO_MIN_SHARE)
+		{
+			configuration.mode = ERun_mode::SMP;
+		}
+		else if (cpu_share < AUTO_MIN_SHARE)
+		{
+			configuration.mode = ERun_mode::CL;
+			configuration.cl_devices_name.clear();
+			for (const SDevice_profile& device : profile.devices)
+			{
+				configuration.cl_devices_name.push_back(device.name);
+			}
+		}
+		else
+		{
+			configuration.mode = ERun_mode::ALL;
+			configuration.cpu_share = cpu_share;
+		}
+
+		// One view for files inside memory budget, bigger files are read by windows
+		configuration.thread_count = profile.thread_count;
+		configuration.use_optimalization = file_len <= static_cast<unsigned long long>(MAX_FILE_SIZE_MEM_1gb);
+		configuration.window_size = profile.window_size;
+
+		return true;
+	}
+}
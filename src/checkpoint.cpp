@@ -0,0 +1,193 @@
+#include "include/checkpoint.h"
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <tbb/tick_count.h>
+
+namespace ppr::checkpoint
+{
+	Checkpointer::Checkpointer(SConfig& configuration, unsigned long long file_size, unsigned int stats)
+		: m_interval(configuration.checkpoint_interval), m_resume(configuration.resume)
+	{
+		m_state.input = configuration.input_fn;
+		m_state.file_size = file_size;
+		m_state.stats = stats;
+	}
+
+	bool Checkpointer::load(SCheckpoint& checkpoint) const
+	{
+		std::ifstream in(CHECKPOINT_FILE);
+		if (!in.good())
+		{
+			ppr::print_error("Checkpoint '" + std::string(CHECKPOINT_FILE) + "' not found");
+			return false;
+		}
+
+		// Damaged checkpoint is not used, checkpoint without flags is written by older version
+		bool flags = false;
+		try
+		{
+			std::string line;
+			while (std::getline(in, line))
+			{
+				const size_t separator = line.find('=');
+				if (separator == std::string::npos)
+				{
+					continue;
+				}
+
+				const std::string key = line.substr(0, separator);
+				const std::string value = line.substr(separator + 1);
+
+				if (key == "input") checkpoint.input = value;
+				else if (key == "file_size") checkpoint.file_size = std::stoull(value);
+				else if (key == "stats") checkpoint.stats = static_cast<unsigned int>(std::stoul(value));
+				else if (key == "pass") checkpoint.iteration = static_cast<EIteration>(std::stoi(value));
+				else if (key == "offset") checkpoint.offset = std::stoull(value);
+				else if (key == "n") checkpoint.stat.n = std::stoull(value);
+				else if (key == "sum") checkpoint.stat.sum = std::stod(value);
+				else if (key == "min") checkpoint.stat.min = std::stod(value);
+				else if (key == "max") checkpoint.stat.max = std::stod(value);
+				else if (key == "sum_log") checkpoint.stat.sumLog = std::stod(value);
+				else if (key == "sum_log2") checkpoint.stat.sumLog2 = std::stod(value);
+				else if (key == "sum_x_log") checkpoint.stat.sumXLog = std::stod(value);
+				else if (key == "sum_log1m") checkpoint.stat.sumLog1m = std::stod(value);
+				else if (key == "variance") checkpoint.stat.variance = std::stod(value);
+				else if (key == "negative") checkpoint.stat.isNegative = std::stoi(value) != 0;
+				else if (key == "integer")
+				{
+					checkpoint.stat.isInteger = std::stoi(value) != 0;
+					flags = true;
+				}
+				else if (key == "histogram")
+				{
+					std::stringstream bins(value);
+					int frequency = 0;
+					while (bins >> frequency)
+					{
+						checkpoint.histogram.push_back(frequency);
+					}
+				}
+			}
+		}
+		catch (const std::exception&)
+		{
+			flags = false;
+		}
+
+		if (!flags)
+		{
+			ppr::print_error("Checkpoint '" + std::string(CHECKPOINT_FILE) + "' is damaged");
+			return false;
+		}
+
+		// Checkpoint of other file or other distributions is not used
+		if (checkpoint.input != m_state.input || checkpoint.file_size != m_state.file_size || checkpoint.stats != m_state.stats
+			|| checkpoint.offset > checkpoint.file_size)
+		{
+			ppr::print_error("Checkpoint does not belong to this input file and distributions");
+			return false;
+		}
+
+		checkpoint.stat.stats = checkpoint.stats;
+		return true;
+	}
+
+	bool Checkpointer::save()
+	{
+		const std::string temporary = std::string(CHECKPOINT_FILE) + ".tmp";
+
+		{
+			std::ofstream out(temporary, std::ios::trunc);
+			if (!out.good())
+			{
+				return false;
+			}
+
+			// 17 digits restore the same double
+			out.precision(17);
+			out << "input=" << m_state.input << std::endl;
+			out << "file_size=" << m_state.file_size << std::endl;
+			out << "stats=" << m_state.stats << std::endl;
+			out << "pass=" << static_cast<int>(m_state.iteration) << std::endl;
+			out << "offset=" << m_state.offset << std::endl;
+			out << "n=" << m_state.stat.n << std::endl;
+			out << "sum=" << m_state.stat.sum << std::endl;
+			out << "min=" << m_state.stat.min << std::endl;
+			out << "max=" << m_state.stat.max << std::endl;
+			out << "sum_log=" << m_state.stat.sumLog << std::endl;
+			out << "sum_log2=" << m_state.stat.sumLog2 << std::endl;
+			out << "sum_x_log=" << m_state.stat.sumXLog << std::endl;
+			out << "sum_log1m=" << m_state.stat.sumLog1m << std::endl;
+			out << "variance=" << m_state.stat.variance << std::endl;
+			out << "negative=" << m_state.stat.isNegative << std::endl;
+			out << "integer=" << m_state.stat.isInteger << std::endl;
+			out << "histogram=";
+			for (int frequency : m_state.histogram)
+			{
+				out << frequency << ' ';
+			}
+			out << std::endl;
+
+			if (!out.good())
+			{
+				return false;
+			}
+		}
+
+		// Rename replaces the previous checkpoint at once
+		std::error_code error;
+		std::filesystem::rename(temporary, CHECKPOINT_FILE, error);
+		return !error;
+	}
+
+	void Checkpointer::chunk_done(EIteration iteration, unsigned long long offset, const SDataStat& stat, const std::vector<int>& histogram)
+	{
+		if (m_interval == 0 || ++m_chunks < m_interval)
+		{
+			return;
+		}
+
+		// End of statistics pass is the start of histogram pass, end of histogram pass needs no checkpoint
+		if (offset >= m_state.file_size)
+		{
+			if (iteration == EIteration::HIST)
+			{
+				return;
+			}
+			iteration = EIteration::HIST;
+			offset = 0;
+		}
+
+		tbb::tick_count t0 = tbb::tick_count::now();
+
+		m_chunks = 0;
+		m_state.iteration = iteration;
+		m_state.offset = offset;
+		m_state.stat = stat;
+		m_state.histogram = iteration == EIteration::HIST ? histogram : std::vector<int>();
+
+		if (save())
+		{
+			m_count++;
+		}
+		else
+		{
+			ppr::print_error("Cannot write checkpoint");
+		}
+
+		m_seconds += (tbb::tick_count::now() - t0).seconds();
+	}
+
+	void Checkpointer::finish()
+	{
+		if (m_interval == 0 && !m_resume)
+		{
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::remove(CHECKPOINT_FILE, error);
+	}
+}
@@ -2,43 +2,85 @@
 #pragma OPENCL EXTENSION cl_khr_local_int32_base_atomics : enable
 #pragma OPENCL EXTENSION cl_khr_global_int32_base_atomics : enable
 
+// Histogram is privatized in local memory of every work group and merged to global histogram once per group.
+// Bins, which do not fit in local memory (use_local == 0), are counted directly in global histogram
 __kernel void Get_Data_Histogram(
     __global double* data,
     __local double* local_var,
+    __local uint* local_hist,
 
-    __global int* out_sum,
+    __global uint* out_hist,
     __global double* out_var,
     double mean,
     double min,
     double scale_factor,
-    double bin_size,
-    long   bin_count
+    int bin_count,
+    int use_local
 )
 {
     uint localId = get_local_id(0);
     uint globalId = get_global_id(0);
-    uint groupSize = get_local_size(0);
     uint groupId = get_group_id(0);
     uint localSize = get_local_size(0);
 
-    local_var[localId] = (data[globalId] - mean) * (data[globalId] - mean);
+    double x = data[globalId];
 
+    // Clear local histogram
+    if (use_local)
+    {
+        for (int bin = localId; bin < bin_count; bin += localSize)
+        {
+            local_hist[bin] = 0;
+        }
+    }
     barrier(CLK_LOCAL_MEM_FENCE);
 
-    // Increase number on histogram position
-    int position = (int)((data[globalId] - min) * scale_factor);
-    atomic_inc(&out_sum[2 * position]);
+    // Increase number on histogram position. Maximum belongs to the last bin
+    int position = (int)((x - min) * scale_factor);
+    position = clamp(position, 0, bin_count - 1);
+
+    if (use_local)
+    {
+        atomic_inc(&local_hist[position]);
+    }
+    else
+    {
+        atomic_inc(&out_hist[position]);
+    }
 
     // Compute part of gauss variance
-    for (int i = 1; i < groupSize; i++)
+    double tmp = x - mean;
+    local_var[localId] = tmp * tmp;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Merge local histogram, empty bins are skipped
+    if (use_local)
+    {
+        for (int bin = localId; bin < bin_count; bin += localSize)
+        {
+            uint count = local_hist[bin];
+            if (count != 0)
+            {
+                atomic_add(&out_hist[bin], count);
+            }
+        }
+    }
+
+    // Tree reduction of variance, work group size does not need to be power of two
+    for (uint active = localSize; active > 1; )
     {
-        double tmp = data[globalId + i] - mean;
-        local_var[localId] = local_var[localId] + (tmp * tmp);
+        uint half = (active + 1) >> 1;
+        if (localId < active - half)
+        {
+            local_var[localId] += local_var[localId + half];
+        }
         barrier(CLK_LOCAL_MEM_FENCE);
+        active = half;
     }
 
     if (localId == 0)
     {
         out_var[groupId] = local_var[0];
     }
-}
\ No newline at end of file
+}
@@ -1,44 +1,145 @@
 #pragma OPENCL EXTENSION cl_khr_fp64 : enable
 
-__kernel void Get_Data_Statistics(
-	__global double* data,
+// Same bits as ppr::dist::ESufficient_stat
+#define STAT_SUM_LOG	(1 << 1)
+#define STAT_SUM_LOG2	(1 << 2)
+#define STAT_SUM_X_LOG	(1 << 3)
+#define STAT_SUM_LOG1M	(1 << 4)
 
-	__local double* local_sum,
-	__local double* local_min,
-	__local double* local_max,
+// Same layout as ppr::gpu::SDevice_stat
+typedef struct
+{
+	double n;
+	double sum;
+	double min;
+	double max;
+	double sum_log;
+	double sum_log2;
+	double sum_x_log;
+	double sum_log1m;
+	double negative;	// 1 = some value is below zero (-0.0 is not)
+	double integer;		// 1 = all values are integers
+} stat_record;
 
-	__global double* out_sum,
-	__global double* out_min,
-	__global double* out_max
-)
+stat_record empty_record()
 {
-	uint globalId = get_global_id(0);
-	uint localSize = get_local_size(0);
-	uint localId = get_local_id(0);
-	uint groupId = get_group_id(0);
+	stat_record r;
+	r.n = 0.0;
+	r.sum = 0.0;
+	r.min = INFINITY;
+	r.max = -INFINITY;
+	r.sum_log = 0.0;
+	r.sum_log2 = 0.0;
+	r.sum_x_log = 0.0;
+	r.sum_log1m = 0.0;
+	r.negative = 0.0;
+	r.integer = 1.0;
+	return r;
+}
 
-	local_sum[localId] = data[globalId];
-	local_min[localId] = data[globalId];
-	local_max[localId] = data[globalId];
+// Merge two records. Empty record has infinite extremes and set integer flag, so it does not change the other one
+stat_record combine(stat_record a, stat_record b)
+{
+	stat_record r;
+	r.n = a.n + b.n;
+	r.sum = a.sum + b.sum;
+	r.min = min(a.min, b.min);
+	r.max = max(a.max, b.max);
+	r.sum_log = a.sum_log + b.sum_log;
+	r.sum_log2 = a.sum_log2 + b.sum_log2;
+	r.sum_x_log = a.sum_x_log + b.sum_x_log;
+	r.sum_log1m = a.sum_log1m + b.sum_log1m;
+	r.negative = max(a.negative, b.negative);
+	r.integer = min(a.integer, b.integer);
+	return r;
+}
 
+// Tree reduction of local records, work group size does not need to be power of two. Result is in local_records[0]
+void reduce_records(__local stat_record* local_records, uint localId, uint localSize)
+{
 	barrier(CLK_LOCAL_MEM_FENCE);
 
-	for (int i = localSize >> 1; i > 0; i >>= 1)
+	for (uint active = localSize; active > 1; )
 	{
-		if (localId < i)
+		uint half = (active + 1) >> 1;
+		if (localId < active - half)
 		{
-			local_sum[localId] += local_sum[localId + i];
-			local_min[localId] = min(local_min[localId], local_min[localId + i]);
-			local_max[localId] = max(local_max[localId], local_max[localId + i]);
+			local_records[localId] = combine(local_records[localId], local_records[localId + half]);
 		}
 		barrier(CLK_LOCAL_MEM_FENCE);
+		active = half;
 	}
+}
+
+// First stage. Every work item strides over the whole input, every work group writes one partial record
+__kernel void Get_Data_Statistics(
+	__global const double* data,
+	ulong count,
+	__local stat_record* local_records,
+	__global stat_record* partials,
+	uint stats
+)
+{
+	uint localId = get_local_id(0);
+	uint localSize = get_local_size(0);
+	uint groupId = get_group_id(0);
+	size_t stride = get_global_size(0);
+
+	stat_record r = empty_record();
+	int log_sums = stats & (STAT_SUM_LOG | STAT_SUM_LOG2 | STAT_SUM_X_LOG | STAT_SUM_LOG1M);
+
+	for (size_t i = get_global_id(0); i < count; i += stride)
+	{
+		double x = data[i];
+
+		r.n += 1.0;
+		r.sum += x;
+		r.min = min(r.min, x);
+		r.max = max(r.max, x);
+		r.negative = x < 0.0 ? 1.0 : r.negative;
+		r.integer = floor(x) == x ? r.integer : 0.0;
+
+		if (log_sums)
+		{
+			double log_x = log(x);
+			r.sum_log += (stats & STAT_SUM_LOG) ? log_x : 0.0;
+			r.sum_log2 += (stats & STAT_SUM_LOG2) ? log_x * log_x : 0.0;
+			r.sum_x_log += (stats & STAT_SUM_X_LOG) ? x * log_x : 0.0;
+			r.sum_log1m += (stats & STAT_SUM_LOG1M) ? log1p(-x) : 0.0;
+		}
+	}
+
+	local_records[localId] = r;
+	reduce_records(local_records, localId, localSize);
+
+	if (localId == 0)
+	{
+		partials[groupId] = local_records[0];
+	}
+}
+
+// Second stage. One work group reduces partial records to one result
+__kernel void Reduce_Data_Statistics(
+	__global const stat_record* partials,
+	uint partial_count,
+	__local stat_record* local_records,
+	__global stat_record* result
+)
+{
+	uint localId = get_local_id(0);
+	uint localSize = get_local_size(0);
+
+	stat_record r = empty_record();
+	for (uint i = localId; i < partial_count; i += localSize)
+	{
+		r = combine(r, partials[i]);
+	}
+
+	local_records[localId] = r;
+	reduce_records(local_records, localId, localSize);
 
-	// Save/Agregate values
 	if (localId == 0)
 	{
-		out_sum[groupId] = out_sum[groupId] + local_sum[0];
-		out_min[groupId] = min(out_min[groupId], local_min[0]);
-		out_max[groupId] = max(out_max[groupId], local_max[0]);
+		result[0] = local_records[0];
 	}
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #include "include/config.h"
+#include "include/distribution.h"
 #include <thread>
+#include <sstream>
 
 namespace ppr
 {
@@ -52,17 +54,30 @@ namespace ppr
 		{
 			man_argc++;
 			config.mode = ERun_mode::ALL;
+
+			// Optional devices, otherwise all GPUs. 'man_argc' stays on the last mandatory argument
+			while (man_argc + 1 < argc && argv[man_argc + 1][0] != '-')
+			{
+				man_argc++;
+				config.cl_devices_name.push_back(argv[man_argc]);
+			}
+		}
+		else if (std::strncmp("auto", argv[2], 4) == 0)
+		{
+			man_argc++;
+			config.mode = ERun_mode::AUTO;
 		}
 		else if (argv[2][0] != '-')
 		{
 			man_argc++;
 			config.mode = ERun_mode::CL;
 
-			// Save devices
-			while (man_argc < argc && argv[man_argc][0] != '-')
+			// Save devices. 'man_argc' stays on the last mandatory argument
+			config.cl_devices_name.push_back(argv[man_argc]);
+			while (man_argc + 1 < argc && argv[man_argc + 1][0] != '-')
 			{
-				config.cl_devices_name.push_back(argv[man_argc]);
 				man_argc++;
+				config.cl_devices_name.push_back(argv[man_argc]);
 			}
 		}
 		else
@@ -75,8 +90,40 @@ namespace ppr
 		// Get optional
 		for (int i = man_argc + 1; i < argc; i += 2)
 		{
+			// Flag without value
+			if (std::strcmp("--resume", argv[i]) == 0)
+			{
+				config.resume = true;
+				i--;
+				continue;
+			}
+			if (std::strcmp("--perf", argv[i]) == 0)
+			{
+				config.perf_counters = true;
+				i--;
+				continue;
+			}
+			if (std::strcmp("--roofline", argv[i]) == 0)
+			{
+				config.roofline = true;
+				i--;
+				continue;
+			}
+
+			// Chrome trace of the run
+			if (std::strcmp("--trace", argv[i]) == 0)
+			{
+				if (i + 1 >= argc)
+				{
+					print_error("missing trace file!");
+					print_usage();
+					return false;
+				}
+
+				config.trace_fn = argv[i + 1];
+			}
 			// use optimalization
-			if (std::strncmp("-o", argv[i], 2) == 0)
+			else if (std::strncmp("-o", argv[i], 2) == 0)
 			{
 				int opt = 0;
 				if (sscanf_s(argv[i + 1], "%d", &opt) != 1)
@@ -97,7 +144,19 @@ namespace ppr
 			else if (std::strncmp("-t", argv[i], 2) == 0) // thread per code
 			{
 				int tc = 0;
-				if (sscanf_s(argv[i + 1], "%d", &tc) != 1)
+				if (sscanf_s(argv[i + 1], "%d", &tc) != 1 || tc <= 0)
+				{
+					print_error("wrong argument type!");
+					print_usage();
+					return false;
+				}
+
+				config.thread_per_core = tc;
+			}
+			else if (std::strncmp("-p", argv[i], 2) == 0) // thread count
+			{
+				int tc = 0;
+				if (sscanf_s(argv[i + 1], "%d", &tc) != 1 || tc <= 0)
 				{
 					print_error("wrong argument type!");
 					print_usage();
@@ -106,6 +165,31 @@ namespace ppr
 
 				config.thread_count = tc;
 			}
+			else if (std::strncmp("-m", argv[i], 2) == 0) // fixed window of chunked reading
+			{
+				int mb = 0;
+				if (sscanf_s(argv[i + 1], "%d", &mb) != 1 || mb <= 0)
+				{
+					print_error("wrong argument type!");
+					print_usage();
+					return false;
+				}
+
+				config.window_size = static_cast<unsigned long long>(mb) * 1024 * 1024;
+				config.fixed_window = true;
+			}
+			else if (std::strncmp("-n", argv[i], 2) == 0) // NUMA node
+			{
+				int node = 0;
+				if (sscanf_s(argv[i + 1], "%d", &node) != 1 || node < 0)
+				{
+					print_error("wrong argument type!");
+					print_usage();
+					return false;
+				}
+
+				config.numa_node = node;
+			}
 			else if (std::strncmp("-w", argv[i], 2) == 0) // watchdog interval
 			{
 				int wi = 0;
@@ -118,11 +202,73 @@ namespace ppr
 
 				config.watchdog_interval = wi;
 			}
+			else if (std::strncmp("-st", argv[i], 3) == 0) // statistics timeout
+			{
+				int st = 0;
+				if (sscanf_s(argv[i + 1], "%d", &st) != 1 || st <= 0)
+				{
+					print_error("wrong argument type!");
+					print_usage();
+					return false;
+				}
+
+				config.stat_timeout = st;
+			}
+			else if (std::strncmp("-c", argv[i], 2) == 0) // checkpoint interval
+			{
+				int ci = 0;
+				if (sscanf_s(argv[i + 1], "%d", &ci) != 1 || ci < 0)
+				{
+					print_error("wrong argument type!");
+					print_usage();
+					return false;
+				}
+
+				config.checkpoint_interval = static_cast<unsigned long long>(ci);
+			}
+			else if (std::strncmp("-d", argv[i], 2) == 0) // candidate distributions
+			{
+				std::stringstream names(argv[i + 1]);
+				std::string name;
+
+				while (std::getline(names, name, ','))
+				{
+					if (name != "all" && ppr::dist::Registry::instance().find(name) < 0)
+					{
+						print_error("unknown distribution '" + name + "'!");
+						print_usage();
+						return false;
+					}
+					config.distributions.push_back(name);
+				}
+			}
+			else if (std::strncmp("-g", argv[i], 2) == 0) // goodness-of-fit criterion
+			{
+				bool found = false;
+				for (int c = 0; c <= static_cast<int>(EGof_criterion::KL); c++)
+				{
+					if (std::strcmp(GOF_CRITERION_NAMES[c], argv[i + 1]) == 0)
+					{
+						config.criterion = static_cast<EGof_criterion>(c);
+						found = true;
+					}
+				}
+
+				if (!found)
+				{
+					print_error("unknown criterion! Should be 'rss', 'chi2', 'ks', 'ad' or 'kl'");
+					print_usage();
+					return false;
+				}
+			}
 
 		}
 
-		// Find number available of threads
-		config.thread_count =  static_cast<int>(std::thread::hardware_concurrency()) * config.thread_per_core;
+		// Find number available of threads, unless it is given
+		if (config.thread_count == 0)
+		{
+			config.thread_count = static_cast<int>(std::thread::hardware_concurrency()) * config.thread_per_core;
+		}
 
 		return true;
 	}
@@ -133,13 +279,30 @@ namespace ppr
 		std::cout << "|\t\tPROBABILITY DISTRIBUTION FITTING\t|" << std::endl;
 		std::cout << "+-------------------------------------------------------+" << std::endl;
 		std::cout << "| * path for input file\t\t\t\t\t|" << std::endl;
-		std::cout << "| * run mode [all (SMP and OpenCL) / SMP]\t\t|" << std::endl;
+		std::cout << "| * run mode [all (SMP and OpenCL) / SMP / auto]\t|" << std::endl;
 		std::cout << "| * opencl devices name\t\t\t\t\t|" << std::endl;
+		std::cout << "| \t\t(also after 'all', any device type)\t|" << std::endl;
 		std::cout << "| \t\t=== [optional] ===\t\t\t|" << std::endl;
 		std::cout << "| * -o\t\tuse optimalization [1/0] ('1' default)\t|" << std::endl;
 		std::cout << "| * -t\t\tthread per code [int] ('1' default)\t|" << std::endl;
+		std::cout << "| * -p\t\tthread count [int] (all processors)\t|" << std::endl;
 		std::cout << "| * -w\t\twatchdog interval [sec] ('2' default)\t|" << std::endl;
 		std::cout << "| * -st\t\tstatistics timeout [sec] ('5' default)\t|" << std::endl;
+		std::cout << "| * -d\t\tdistributions [gauss,exp,.../all]\t|" << std::endl;
+		std::cout << "| * -g\t\tcriterion [rss/chi2/ks/ad/kl] ('ad')\t|" << std::endl;
+		std::cout << "| * -m\t\tfixed window of chunked reading [MB]\t|" << std::endl;
+		std::cout << "| * -n\t\tNUMA node of SMP threads [int]\t\t|" << std::endl;
+		std::cout << "| * -c\t\tcheckpoint every N chunks ('0' = off)\t|" << std::endl;
+		std::cout << "| * --resume\tcontinue from last checkpoint\t\t|" << std::endl;
+		std::cout << "| * --perf\tcounters of SMP stages (Linux)\t\t|" << std::endl;
+		std::cout << "| * --trace\tChrome trace of the run [file]\t\t|" << std::endl;
+		std::cout << "| * --roofline\tpass rates against memory and disk\t|" << std::endl;
+		std::cout << "| \t\t=== [benchmark] ===\t\t\t|" << std::endl;
+		std::cout << "| * bench\tmeasure computing kernels\t\t|" << std::endl;
+		std::cout << "| * calibrate\tcreate tuning profile for 'auto' mode\t|" << std::endl;
+		std::cout << "| \t\t[optional sample file for I/O rate]\t|" << std::endl;
+		std::cout << "| * check\tcompare OpenCL devices with CPU\t\t|" << std::endl;
+		std::cout << "| \t\t[optional device names, e.g. PoCL]\t|" << std::endl;
 		std::cout << "+-------------------------------------------------------+" << std::endl;
 	}
 
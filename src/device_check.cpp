@@ -0,0 +1,275 @@
+#include "include/device_check.h"
+#include "include/executor.h"
+#include "include/distribution.h"
+#include "include/histogram.h"
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <tbb/task_arena.h>
+
+#undef min
+#undef max
+
+namespace ppr::check
+{
+	/// <summary>
+	/// Is value close to reference
+	/// </summary>
+	/// <param name="value">- Device value</param>
+	/// <param name="reference">- CPU value</param>
+	/// <returns>Relative difference is in tolerance</returns>
+	static bool is_close(double value, double reference)
+	{
+		return std::abs(value - reference) <= CHECK_TOLERANCE * std::max(1.0, std::abs(reference));
+	}
+
+	std::vector<SCheck_data> create_data(long long count)
+	{
+		// Fixed seed, failed check can be repeated
+		std::mt19937_64 generator(2022);
+		std::uniform_real_distribution<double> unit(0.0, 1.0);
+		std::poisson_distribution<int> poisson(10.0);
+
+		std::vector<SCheck_data> sets;
+		const unsigned int log_sums = ppr::dist::Registry::instance().required_stats(ppr::dist::Registry::instance().select({ "all" }));
+
+		SCheck_data positive{ "unit", std::vector<double>(count), log_sums };
+		SCheck_data negative{ "negative", std::vector<double>(count) };
+		SCheck_data integer{ "integer", std::vector<double>(count) };
+		SCheck_data halves{ "halves", std::vector<double>(count) };
+		SCheck_data zeros{ "signed zeros", std::vector<double>(count) };
+		for (long long i = 0; i < count; i++)
+		{
+			positive.values[i] = unit(generator);
+			negative.values[i] = -1.0 - 100.0 * unit(generator);
+			integer.values[i] = poisson(generator);
+
+			// Pairs sum to integers, so integral sum does not mean integral data
+			halves.values[i] = static_cast<double>(i / 2) + 0.5;
+
+			// -0.0 has sign bit, but it is not negative for solvers (min < 0)
+			zeros.values[i] = i % 2 == 0 ? -0.0 : unit(generator);
+		}
+
+		sets.push_back(std::move(positive));
+		sets.push_back(std::move(negative));
+		sets.push_back(std::move(integer));
+		sets.push_back(std::move(halves));
+		sets.push_back(std::move(zeros));
+		return sets;
+	}
+
+	bool check_statistics(ppr::gpu::SOpenCLConfig& opencl, SCheck_data& data, std::string& difference)
+	{
+		const unsigned long long count = data.values.size();
+
+		// CPU reducer of SMP and scheduler
+		tbb::task_arena arena;
+		Running_stat_parallel stat_cpu(data.values.data(), 0, data.stats);
+		ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat_cpu, 1, count);
+		const SDataStat log_sums = stat_cpu.Log_sums();
+
+		// Device record goes through the same merge as in solvers
+		SConfig configuration;
+		SDataStat stat;
+		stat.stats = data.stats;
+		opencl.data_count_for_gpu = count;
+		ppr::gpu::run_statistics_on_GPU(stat, opencl, configuration, data.values.data(), 0, count - 1);
+
+		std::stringstream names;
+		if (stat.n != stat_cpu.NumDataValues()) names << " n";
+		if (stat.min != stat_cpu.Get_Min()) names << " min";
+		if (stat.max != stat_cpu.Get_Max()) names << " max";
+		if (!is_close(stat.sum, stat_cpu.Sum())) names << " sum";
+		if (stat.isNegative != stat_cpu.IsNegative() || stat.isNegative != (stat.min < 0.0)) names << " negative";
+		if (stat.isInteger != stat_cpu.IsInteger()) names << " integer";
+		if (!is_close(stat.sumLog, log_sums.sumLog)) names << " sum_log";
+		if (!is_close(stat.sumLog2, log_sums.sumLog2)) names << " sum_log2";
+		if (!is_close(stat.sumXLog, log_sums.sumXLog)) names << " sum_x_log";
+		if (!is_close(stat.sumLog1m, log_sums.sumLog1m)) names << " sum_log1m";
+
+		difference = names.str();
+		return difference.empty();
+	}
+
+	bool check_histogram(ppr::gpu::SOpenCLConfig& opencl, SCheck_data& data, int bin_count, std::string& difference)
+	{
+		// Device processes whole work groups only
+		const unsigned long long count = data.values.size() - data.values.size() % opencl.wg_size;
+		tbb::task_arena arena;
+
+		Running_stat_parallel stat_cpu(data.values.data(), 0);
+		ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat_cpu, 1, count);
+
+		SDataStat stat;
+		stat.n = stat_cpu.NumDataValues();
+		stat.sum = stat_cpu.Sum();
+		stat.min = stat_cpu.Get_Min();
+		stat.max = stat_cpu.Get_Max();
+		stat.isNegative = stat.min < 0;
+		stat.isInteger = stat_cpu.IsInteger();
+		stat.mean = stat.sum / stat.n;
+
+		SHistogram hist;
+		ppr::executor::compute_histogram_limits(hist, stat);
+		if (bin_count > 0)
+		{
+			hist.binCount = bin_count;
+			hist.binSize = (stat.max - stat.min) / bin_count;
+			hist.scaleFactor = 1.0 / hist.binSize;
+		}
+
+		SConfig configuration;
+		std::vector<int> device_freq(hist.binCount, 0);
+		double device_var = 0.0;
+		opencl.data_count_for_gpu = count;
+		ppr::gpu::run_histogram_on_GPU(opencl, configuration, hist, stat, data.values.data(), 0, count - 1, device_freq, device_var);
+
+		ppr::hist::Histogram_parallel hist_cpu(hist.binCount, hist.binSize, stat.min, stat.max, data.values.data(), stat.mean);
+		ppr::executor::run_with_tbb<ppr::hist::Histogram_parallel>(arena, hist_cpu, 0, count);
+
+		long long different = 0;
+		int first = -1;
+		for (int bin = 0; bin < hist.binCount; bin++)
+		{
+			if (device_freq[bin] != hist_cpu.m_bucketFrequency[bin])
+			{
+				first = first < 0 ? bin : first;
+				different++;
+			}
+		}
+
+		std::stringstream names;
+		if (different > 0) names << " " << different << " bins from bin " << first;
+		if (!is_close(device_var, hist_cpu.m_var)) names << " variance";
+
+		difference = names.str();
+		return difference.empty();
+	}
+
+	bool check_poisson_cdf(double mu, std::string& difference)
+	{
+		constexpr std::size_t EDGES = 64;
+		const ppr::rss::PoissonDistribution poisson(mu);
+		const double sigma = std::sqrt(mu);
+
+		// Reference sums PMF from 12 sigma under mean, the rest of the tail is under double precision
+		double edge = std::max(0.0, std::floor(mu - (12.0 * sigma)));
+		double reference = 0.0;
+		double worst = 0.0;
+		double worst_edge = 0.0;
+
+		for (double z = -6.0; z <= 6.0; z += 1.0)
+		{
+			const double first = std::max(edge, std::floor(mu + (z * sigma)));
+			for (; edge < first; edge += 1.0)
+			{
+				reference += poisson.Pdf(edge);
+			}
+
+			double cdf[EDGES];
+			poisson.Cdf_batch(first, 1.0, cdf, EDGES);
+
+			double batch_reference = reference;
+			for (std::size_t i = 0; i < EDGES; i++)
+			{
+				const double error = std::abs(cdf[i] - batch_reference);
+				if (error > worst)
+				{
+					worst = error;
+					worst_edge = first + static_cast<double>(i);
+				}
+				batch_reference += poisson.Pdf(first + static_cast<double>(i));
+			}
+		}
+
+		std::stringstream names;
+		if (worst > CHECK_CDF_TOLERANCE) names << " " << worst << " in edge " << static_cast<long long>(worst_edge);
+
+		difference = names.str();
+		return difference.empty();
+	}
+
+	int run(int argc, char** argv)
+	{
+		std::cout << "\t\t\t[Device check]" << std::endl;
+		std::cout << "---------------------------------------------------------------------" << std::endl;
+
+		std::vector<std::string> names;
+		for (int i = 2; i < argc; i++)
+		{
+			names.push_back(argv[i]);
+		}
+
+		int failures = 0;
+
+		// Special functions of CPU fit, run without device
+		for (double mu : CHECK_POISSON_MEANS)
+		{
+			std::string difference;
+			const bool same = check_poisson_cdf(mu, difference);
+			failures += same ? 0 : 1;
+			std::cout << "> " << (same ? "ok  " : "FAIL") << "\tpoisson cdf\tlambda=" << mu;
+			std::cout << (same ? "" : "\t(differs:" + difference + ")") << std::endl;
+		}
+
+		std::vector<cl::Device> devices;
+		ppr::gpu::find_opencl_devices(devices, names);
+		if (devices.empty())
+		{
+			ppr::print_error("No OpenCL device with double precision found");
+			return failures == 0 ? EExitStatus::ARGS : EExitStatus::STAT;
+		}
+
+		std::vector<SCheck_data> sets = create_data(CHECK_COUNT);
+
+		for (cl::Device& device : devices)
+		{
+			const std::string device_name = device.getInfo<CL_DEVICE_NAME>();
+
+			// Both programs share one context and command queue of the device, as in work scheduler
+			ppr::gpu::SOpenCLConfig opencl;
+			opencl.device = device;
+			ppr::gpu::set_kernel_program(opencl, STAT_KERNEL, STAT_KERNEL_NAME, STAT_REDUCE_KERNEL_NAME);
+
+			ppr::gpu::SOpenCLConfig hist_opencl;
+			hist_opencl.device = device;
+			hist_opencl.context = opencl.context;
+			hist_opencl.queue = opencl.queue;
+			ppr::gpu::set_kernel_program(hist_opencl, HIST_KERNEL, HIST_KERNEL_NAME);
+
+			if (opencl.wg_size == 0 || hist_opencl.wg_size == 0)
+			{
+				ppr::print_error("kernels of '" + device_name + "' were not built");
+				failures++;
+				continue;
+			}
+
+			// Solver bins fit in local memory, one bin more than local memory holds needs global atomics
+			const int global_bins = static_cast<int>(hist_opencl.local_mem_size / sizeof(cl_uint)) + 1;
+
+			for (SCheck_data& data : sets)
+			{
+				std::string difference;
+				bool same = check_statistics(opencl, data, difference);
+				failures += same ? 0 : 1;
+				std::cout << "> " << (same ? "ok  " : "FAIL") << "\tstatistics\t" << data.name << "\t" << device_name;
+				std::cout << (same ? "" : "\t(differs:" + difference + ")") << std::endl;
+
+				for (int bins : { 0, global_bins })
+				{
+					same = check_histogram(hist_opencl, data, bins, difference);
+					failures += same ? 0 : 1;
+					std::cout << "> " << (same ? "ok  " : "FAIL") << "\thistogram " << (bins == 0 ? "solver bins" : "global atomics") << "\t" << data.name << "\t" << device_name;
+					std::cout << (same ? "" : "\t(differs:" + difference + ")") << std::endl;
+				}
+			}
+		}
+
+		std::cout << std::endl << "> Failed checks:\t\t" << failures << std::endl;
+		return failures == 0 ? EExitStatus::SUCCESS : EExitStatus::STAT;
+	}
+}
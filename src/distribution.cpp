@@ -0,0 +1,438 @@
+#include "include/distribution.h"
+#include "include/histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ppr::dist
+{
+	Registry::Registry()
+	{
+		register_builtin_distributions(*this);
+	}
+
+	Registry& Registry::instance()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	int Registry::add(const SDistribution_plugin& plugin)
+	{
+		m_plugins.push_back(plugin);
+		return static_cast<int>(m_plugins.size()) - 1;
+	}
+
+	const SDistribution_plugin& Registry::get(int id) const
+	{
+		return m_plugins[id];
+	}
+
+	int Registry::size() const
+	{
+		return static_cast<int>(m_plugins.size());
+	}
+
+	int Registry::find(const std::string& name) const
+	{
+		for (int i = 0; i < size(); i++)
+		{
+			if (name == m_plugins[i].name)
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	std::vector<int> Registry::select(const std::vector<std::string>& names) const
+	{
+		std::vector<int> ids;
+		const bool all = std::find(names.begin(), names.end(), "all") != names.end();
+
+		// Logarithmic sums cost a log per value, so their distributions run only when asked for
+		if (names.empty() || all)
+		{
+			for (int i = 0; i < size(); i++)
+			{
+				if (all || (m_plugins[i].required_stats & STAT_LOG_SUMS) == 0)
+				{
+					ids.push_back(i);
+				}
+			}
+			return ids;
+		}
+
+		for (const auto& name : names)
+		{
+			int id = find(name);
+			if (id >= 0)
+			{
+				ids.push_back(id);
+			}
+		}
+
+		return ids;
+	}
+
+	unsigned int Registry::required_stats(const std::vector<int>& ids) const
+	{
+		unsigned int stats = STAT_BASE;
+
+		for (int id : ids)
+		{
+			stats |= m_plugins[id].required_stats;
+		}
+
+		return stats;
+	}
+
+	//  ================ [Gauss]
+
+	void fit_gauss(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		fit.params[0] = stat.mean;
+		fit.params[1] = stat.variance;
+		fit.location = stat.mean;
+		fit.scale = std::sqrt(stat.variance);
+		fit.valid = fit.scale > 0.0;
+	}
+
+	void pdf_gauss(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::NormalDistribution(fit.location, fit.scale).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_gauss(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::NormalDistribution(fit.location, fit.scale).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Exponential]
+
+	void fit_exp(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		fit.params[0] = stat.n / stat.sum;
+		fit.location = stat.min;
+		fit.scale = stat.mean - stat.min;
+		fit.valid = fit.scale > 0.0;
+	}
+
+	void pdf_exp(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::ExponentialDistribution(fit.location, fit.scale).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_exp(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::ExponentialDistribution(fit.location, fit.scale).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Poisson]
+
+	void fit_poisson(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		fit.params[0] = stat.mean;
+		fit.valid = !stat.isNegative;
+	}
+
+	void pdf_poisson(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::PoissonDistribution(fit.params[0]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_poisson(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::PoissonDistribution(fit.params[0]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Uniform]
+
+	void fit_uniform(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		fit.params[0] = stat.min;
+		fit.params[1] = stat.max;
+		fit.location = stat.min;
+		fit.scale = stat.max - stat.min;
+		fit.valid = fit.scale > 0.0;
+	}
+
+	void pdf_uniform(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::UniformDistribution(fit.location, fit.scale).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_uniform(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::UniformDistribution(fit.location, fit.scale).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Geometric]
+
+	void fit_geometric(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		fit.params[0] = 1.0 / (1.0 + stat.mean);
+		fit.valid = stat.isInteger && !stat.isNegative && stat.mean > 0.0;
+	}
+
+	void pdf_geometric(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::GeometricDistribution(fit.params[0]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_geometric(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::GeometricDistribution(fit.params[0]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Binomial]
+
+	void fit_binomial(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		// Number of trials is estimated as the biggest observed value
+		fit.params[0] = stat.max;
+		fit.params[1] = stat.max > 0.0 ? stat.mean / stat.max : 0.0;
+		fit.valid = stat.isInteger && !stat.isNegative && fit.params[1] > 0.0 && fit.params[1] < 1.0;
+	}
+
+	void pdf_binomial(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::BinomialDistribution(fit.params[0], fit.params[1]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_binomial(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::BinomialDistribution(fit.params[0], fit.params[1]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Special functions]
+
+	double digamma(double x)
+	{
+		// Recurrence psi(x) = psi(x + 1) - 1 / x moves argument to asymptotic expansion range
+		double result = 0.0;
+		while (x < 6.0)
+		{
+			result -= 1.0 / x;
+			x += 1.0;
+		}
+
+		const double inv2 = 1.0 / (x * x);
+		return result + std::log(x) - (0.5 / x)
+			- (inv2 * ((1.0 / 12.0) - (inv2 * ((1.0 / 120.0) - (inv2 * ((1.0 / 252.0) - (inv2 * ((1.0 / 240.0) - (inv2 / 132.0)))))))));
+	}
+
+	double trigamma(double x)
+	{
+		// Recurrence psi'(x) = psi'(x + 1) + 1 / x^2
+		double result = 0.0;
+		while (x < 6.0)
+		{
+			result += 1.0 / (x * x);
+			x += 1.0;
+		}
+
+		const double inv = 1.0 / x;
+		const double inv2 = inv * inv;
+		return result + inv + (0.5 * inv2)
+			+ (inv * inv2 * ((1.0 / 6.0) - (inv2 * ((1.0 / 30.0) - (inv2 * ((1.0 / 42.0) - (inv2 / 30.0)))))));
+	}
+
+	//  ================ [Log-normal]
+
+	void fit_lognormal(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		const double n = static_cast<double>(stat.n);
+		const double mean_log = stat.sumLog / n;
+		const double var_log = (stat.sumLog2 / n) - (mean_log * mean_log);
+
+		fit.params[0] = mean_log;
+		fit.params[1] = var_log > 0.0 ? std::sqrt(var_log) : 0.0;
+		fit.valid = !stat.isNegative && std::isfinite(mean_log) && std::isfinite(var_log) && fit.params[1] > 0.0;
+	}
+
+	void pdf_lognormal(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::LogNormalDistribution(fit.params[0], fit.params[1]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_lognormal(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::LogNormalDistribution(fit.params[0], fit.params[1]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Gamma]
+
+	void fit_gamma(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		const double n = static_cast<double>(stat.n);
+		const double mean = stat.sum / n;
+		const double mean_log = stat.sumLog / n;
+		const double s = std::log(mean) - mean_log;
+
+		fit.valid = false;
+		if (stat.isNegative || !std::isfinite(s) || s <= 0.0 || !std::isfinite(stat.sumXLog))
+		{
+			return;
+		}
+
+		// Closed form estimator (Ye & Chen) from sum of x * log(x) is the starting point: theta = cov(x, log(x))
+		double k = mean / ((stat.sumXLog / n) - (mean * mean_log));
+		if (!std::isfinite(k) || k <= 0.0)
+		{
+			k = (3.0 - s + std::sqrt(((s - 3.0) * (s - 3.0)) + (24.0 * s))) / (12.0 * s);
+		}
+
+		// MLE: log(k) - psi(k) = s. Left side is decreasing, so Newton step is safeguarded by bisection of bracket
+		double low = 0.0;
+		double high = std::numeric_limits<double>::infinity();
+		for (int i = 0; i < MLE_MAX_ITERATIONS; i++)
+		{
+			const double f = std::log(k) - digamma(k) - s;
+			if (f > 0.0)
+				low = k;
+			else
+				high = k;
+
+			double next = k - (f / ((1.0 / k) - trigamma(k)));
+			if (!(next > low && next < high))
+			{
+				next = std::isfinite(high) ? 0.5 * (low + high) : 2.0 * k;
+			}
+
+			const bool converged = std::abs(next - k) <= MLE_TOLERANCE * k;
+			k = next;
+			if (converged)
+				break;
+		}
+
+		fit.params[0] = k;
+		fit.params[1] = mean / k;
+		fit.valid = std::isfinite(k) && k > 0.0;
+	}
+
+	void pdf_gamma(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::GammaDistribution(fit.params[0], fit.params[1]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_gamma(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::GammaDistribution(fit.params[0], fit.params[1]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Weibull]
+
+	void fit_weibull(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		// Weibull MLE needs sum of x^k * log(x) for every tried k, which cannot be collected in advance.
+		// log(x) has Gumbel distribution with variance pi^2 / (6 k^2) and mean log(lambda) - gamma / k
+		constexpr double EULER_GAMMA = 0.57721566490153286061;
+		const double n = static_cast<double>(stat.n);
+		const double mean_log = stat.sumLog / n;
+		const double var_log = (stat.sumLog2 / n) - (mean_log * mean_log);
+
+		fit.valid = false;
+		if (stat.isNegative || !std::isfinite(mean_log) || !std::isfinite(var_log) || var_log <= 0.0)
+		{
+			return;
+		}
+
+		const double k = ppr::rss::M_PI / std::sqrt(6.0 * var_log);
+		fit.params[0] = k;
+		fit.params[1] = std::exp(mean_log + (EULER_GAMMA / k));
+		fit.valid = std::isfinite(fit.params[1]);
+	}
+
+	void pdf_weibull(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::WeibullDistribution(fit.params[0], fit.params[1]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_weibull(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::WeibullDistribution(fit.params[0], fit.params[1]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	//  ================ [Beta]
+
+	void fit_beta(const SDataStat& stat, SDistribution_fit& fit)
+	{
+		const double n = static_cast<double>(stat.n);
+		const double mean = stat.sum / n;
+		const double mean_log = stat.sumLog / n;
+		const double mean_log1m = stat.sumLog1m / n;
+
+		// Finite sums mean that all values are inside (0, 1)
+		fit.valid = false;
+		if (stat.isNegative || !std::isfinite(mean_log) || !std::isfinite(mean_log1m))
+		{
+			return;
+		}
+
+		// Method of moments is the starting point
+		const double common = stat.variance > 0.0 ? ((mean * (1.0 - mean)) / stat.variance) - 1.0 : 0.0;
+		double a = common > 0.0 ? mean * common : 1.0;
+		double b = common > 0.0 ? (1.0 - mean) * common : 1.0;
+
+		// MLE: psi(a) - psi(a + b) = mean(log(x)), psi(b) - psi(a + b) = mean(log(1 - x)). Two-dimensional Newton
+		for (int i = 0; i < MLE_MAX_ITERATIONS; i++)
+		{
+			const double psi_ab = digamma(a + b);
+			const double tri_ab = trigamma(a + b);
+			const double g1 = digamma(a) - psi_ab - mean_log;
+			const double g2 = digamma(b) - psi_ab - mean_log1m;
+			const double j11 = trigamma(a) - tri_ab;
+			const double j22 = trigamma(b) - tri_ab;
+			const double det = (j11 * j22) - (tri_ab * tri_ab);
+
+			double da = ((j22 * g1) + (tri_ab * g2)) / det;
+			double db = ((tri_ab * g1) + (j11 * g2)) / det;
+
+			if (!std::isfinite(da) || !std::isfinite(db))
+				break;
+
+			// Shapes must stay positive
+			while (a - da <= 0.0 || b - db <= 0.0)
+			{
+				da *= 0.5;
+				db *= 0.5;
+			}
+
+			a -= da;
+			b -= db;
+
+			if (std::abs(da) <= MLE_TOLERANCE * a && std::abs(db) <= MLE_TOLERANCE * b)
+				break;
+		}
+
+		fit.params[0] = a;
+		fit.params[1] = b;
+		fit.valid = std::isfinite(a) && std::isfinite(b);
+	}
+
+	void pdf_beta(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::BetaDistribution(fit.params[0], fit.params[1]).Pdf_batch(first_bin, bin_size, out, count);
+	}
+
+	void cdf_beta(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count)
+	{
+		ppr::rss::BetaDistribution(fit.params[0], fit.params[1]).Cdf_batch(first_edge, bin_size, out, count);
+	}
+
+	void register_builtin_distributions(Registry& registry)
+	{
+		registry.add({ "gauss", "Gauss", "Gauss/Normal distribution", { "mean", "variance" }, 2, STAT_VARIANCE, &fit_gauss, &pdf_gauss, &cdf_gauss });
+		registry.add({ "poisson", "Poisson", "Poisson distribution", { "lambda" }, 1, STAT_BASE, &fit_poisson, &pdf_poisson, &cdf_poisson });
+		registry.add({ "exp", "Exponential", "Exponential distribution", { "lambda" }, 1, STAT_BASE, &fit_exp, &pdf_exp, &cdf_exp });
+		registry.add({ "uniform", "Uniform", "Uniform distribution", { "a", "b" }, 2, STAT_BASE, &fit_uniform, &pdf_uniform, &cdf_uniform });
+		registry.add({ "geometric", "Geometric", "Geometric distribution", { "p" }, 1, STAT_BASE, &fit_geometric, &pdf_geometric, &cdf_geometric });
+		registry.add({ "binomial", "Binomial", "Binomial distribution", { "n", "p" }, 2, STAT_BASE, &fit_binomial, &pdf_binomial, &cdf_binomial });
+		registry.add({ "lognormal", "Log-normal", "Log-normal distribution", { "mu", "sigma" }, 2, STAT_SUM_LOG | STAT_SUM_LOG2, &fit_lognormal, &pdf_lognormal, &cdf_lognormal });
+		registry.add({ "gamma", "Gamma", "Gamma distribution", { "k", "theta" }, 2, STAT_SUM_LOG | STAT_SUM_X_LOG, &fit_gamma, &pdf_gamma, &cdf_gamma });
+		registry.add({ "weibull", "Weibull", "Weibull distribution", { "k", "lambda" }, 2, STAT_SUM_LOG | STAT_SUM_LOG2, &fit_weibull, &pdf_weibull, &cdf_weibull });
+		registry.add({ "beta", "Beta", "Beta distribution", { "alpha", "beta" }, 2, STAT_VARIANCE | STAT_SUM_LOG | STAT_SUM_LOG1M, &fit_beta, &pdf_beta, &cdf_beta });
+	}
+}
@@ -17,27 +17,140 @@ namespace ppr::executor
 		return sum;
 	}
 
-	void analyze_results(SResult& res)
+	unsigned int required_statistics(SConfig& configuration)
 	{
-		// Find min RSS value
-		std::array<double, 4> rss = { res.gauss_rss, res.poisson_rss, res.exp_rss, res.uniform_rss };
-		std::sort(rss.begin(), rss.end());
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		return registry.required_stats(registry.select(configuration.distributions));
+	}
+
+	void fit_distributions(SConfig& configuration, SDataStat& stat, SResult& res)
+	{
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		std::vector<int> ids = registry.select(configuration.distributions);
+
+		tbb::tick_count t0 = tbb::tick_count::now();
+		res.fits.resize(ids.size());
+		tbb::parallel_for(std::size_t(0), ids.size(), [&](std::size_t i) {
+			res.fits[i].id = ids[i];
+			registry.get(ids[i]).fit(stat, res.fits[i]);
+			});
+		tbb::tick_count t1 = tbb::tick_count::now();
+		res.total_fit_time += (t1 - t0).seconds();
+	}
+
+	void compute_goodness_of_fit(SHistogram& hist, std::vector<int>& bucket_frequency, SResult& res)
+	{
+		tbb::tick_count t0 = tbb::tick_count::now();
+
+		tbb::parallel_for(std::size_t(0), res.fits.size(), [&](std::size_t d) {
+			compute_goodness_of_fit(hist, bucket_frequency, res.fits[d]);
+			});
+
+		tbb::tick_count t1 = tbb::tick_count::now();
+		res.total_fit_time += (t1 - t0).seconds();
+	}
+
+	void compute_goodness_of_fit(SHistogram& hist, std::vector<int>& bucket_frequency, SDistribution_fit& fit)
+	{
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		const std::size_t bin_count = static_cast<std::size_t>(hist.binCount);
+		const double n = std::accumulate(bucket_frequency.begin(), bucket_frequency.begin() + bin_count, 0.0);
+
+		if (!fit.valid || n <= 0.0)
+		{
+			fit.chi2 = fit.ks = fit.ad = fit.kl = std::numeric_limits<double>::infinity();
+			return;
+		}
 
-		if (res.poisson_rss == rss[0])
+		// CDF in all bin edges
+		std::vector<double> cdf(bin_count + 1);
+		for (std::size_t begin = 0; begin <= bin_count; begin += ppr::rss::RSS_BATCH_SIZE)
 		{
-			res.dist = EDistribution::POISSON;
+			const std::size_t size = std::min(ppr::rss::RSS_BATCH_SIZE, bin_count + 1 - begin);
+			registry.get(fit.id).cdf_batch(fit, hist.min + (static_cast<double>(begin) * hist.binSize), hist.binSize, cdf.data() + begin, size);
 		}
-		else if (res.exp_rss == rss[0])
+		cdf[0] = 0.0;
+		cdf[bin_count] = 1.0;
+
+		double chi2 = 0.0, ks = 0.0, ad = 0.0, kl = 0.0;
+		double observed_cdf = 0.0;
+
+		for (std::size_t i = 0; i < bin_count; i++)
 		{
-			res.dist = EDistribution::EXP;
+			const double p = std::max(0.0, cdf[i + 1] - cdf[i]);
+			const double observed = static_cast<double>(bucket_frequency[i]);
+			const double q = observed / n;
+			const double expected = n * p;
+
+			// Chi-square and KL divergence. Observed value in bin with zero probability means infinite distance
+			if (expected > 0.0)
+			{
+				chi2 += (observed - expected) * (observed - expected) / expected;
+			}
+			else if (observed > 0.0)
+			{
+				chi2 = std::numeric_limits<double>::infinity();
+			}
+
+			if (q > 0.0)
+			{
+				kl += p > 0.0 ? q * std::log(q / p) : std::numeric_limits<double>::infinity();
+			}
+
+			// KS and Anderson-Darling on cumulative distributions in bin edges (Choulakian, Lockhart & Stephens)
+			observed_cdf += q;
+			const double h = std::min(1.0, std::max(0.0, cdf[i + 1]));
+			const double z = observed_cdf - h;
+			ks = std::max(ks, std::abs(z));
+			if (h > 0.0 && h < 1.0)
+			{
+				ad += z * z * p / (h * (1.0 - h));
+			}
 		}
-		else if(res.gauss_rss == rss[0])
+
+		fit.chi2 = chi2;
+		fit.ks = ks;
+		fit.ad = n * ad;
+		fit.kl = kl;
+	}
+
+	void compute_histogram_limits(SHistogram& hist, SDataStat& stat)
+	{
+		// If data can belongs to poisson distribution, we should use integer intervals
+		if (stat.max == stat.min)
 		{
-			res.dist = EDistribution::GAUSS;
+			// Constant data, one bin of any nonzero size
+			hist.binCount = 1;
+			hist.binSize = 1.0;
 		}
-		else if (res.uniform_rss == rss[0])
+		else if (!stat.isNegative && stat.isInteger && stat.mean > 0 && stat.max - stat.min < MAX_INTEGER_BIN_COUNT)
+		{
+			hist.binCount = static_cast<int>(stat.max - stat.min) + 1;
+			hist.binSize = 1.0;
+		}
+		else
+		{
+			hist.binCount = static_cast<int>(log2(stat.n)) + 2;
+			hist.binSize = (stat.max - stat.min) / hist.binCount;
+		}
+
+		// Counting and density use the same bins [min + i * binSize, min + (i + 1) * binSize)
+		hist.scaleFactor = 1.0 / hist.binSize;
+		hist.min = stat.min;
+		hist.max = stat.max;
+	}
+
+	void analyze_results(SConfig& configuration, SResult& res)
+	{
+		// Find min value of selected criterion
+		res.best = -1;
+		for (int i = 0; i < static_cast<int>(res.fits.size()); i++)
 		{
-			res.dist = EDistribution::UNIFORM;
+			const double score = res.fits[i].score(configuration.criterion);
+			if (res.fits[i].valid && !std::isnan(score) && (res.best < 0 || score < res.fits[res.best].score(configuration.criterion)))
+			{
+				res.best = i;
+			}
 		}
 
 		res.status = EExitStatus::SUCCESS;
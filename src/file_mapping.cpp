@@ -1,4 +1,5 @@
 #include "include/file_mapping.h"
+#include "include/trace.h"
 
 namespace ppr
 {
@@ -138,211 +139,114 @@ namespace ppr
         return m_allocationGranularity;
     }
 
-    void File_mapping::read_in_one_chunk_cpu(
-        SHistogram& hist,
-        SConfig& config,
-        ppr::gpu::SOpenCLConfig& opencl,
-        SDataStat& stat,
-        EIteration iteration,
-        std::vector<int>& histogram)
+    Window_controller::Window_controller(unsigned long long granularity, unsigned long long max_window, double timeout, unsigned long long first_window, bool fixed)
+        : m_granularity(granularity), m_max_scale(std::max(max_window / granularity, 1ULL)), m_best_throughput(0.0), m_timeout(timeout), m_growing(!fixed)
     {
-        DWORD granulatity = m_allocationGranularity * m_scale;
-
-        const WCHAR* filename = char2wchar(m_filename);
-        HANDLE hfile = ::CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ,
-            NULL, OPEN_EXISTING, 0, NULL);
-        if (hfile != INVALID_HANDLE_VALUE) {
-            LARGE_INTEGER file_size = { 0 };
-            ::GetFileSizeEx(hfile, &file_size);
-            const unsigned long long cbFile =
-                static_cast<unsigned long long>(file_size.QuadPart);
-
-            // Create a file mapping
-            HANDLE hmap = ::CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
-            if (hmap != NULL) {
-                // Create a chunk
-                double* pView = static_cast<double*>(
-                    ::MapViewOfFile(hmap, FILE_MAP_READ, 0, 0, 0));
-
-                if (pView != NULL) {
-                    unsigned long long data_in_chunk = cbFile / sizeof(double);
+        const unsigned long long first_scale = first_window == 0 ? WINDOW_MIN_SCALE : std::max(first_window / granularity, 1ULL);
+        m_scale = std::min(first_scale, m_max_scale);
+        m_best_scale = m_scale;
+    }
 
-                    // Set computing limits
-                    opencl.data_count_for_cpu = data_in_chunk / config.thread_count;
+    unsigned long long Window_controller::get_window_size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_scale * m_granularity;
+    }
 
-                    if (iteration == EIteration::STAT)
-                    {
-                        std::vector<std::future<SDataStat>> workers(config.thread_count);
-                        for (int i = 0; i < config.thread_count; i++)
-                        {
-                            ppr::parallel::Stat_processing_unit unit(config, opencl);
-                            workers[i] = std::async(std::launch::async, &ppr::parallel::Stat_processing_unit::run_on_CPU, unit, pView + (opencl.data_count_for_cpu * i), opencl.data_count_for_cpu);
-                        }
+    void Window_controller::report(EIteration iteration, unsigned long long bytes, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_trace.push_back({ iteration, bytes, seconds });
 
-                        // Agregate results results
-                        for (auto& worker : workers)
-                        {
-                            SDataStat local_stat = worker.get();
-                            stat.sum += local_stat.sum;
-                            stat.n += local_stat.n;
-                            stat.max = std::max({ stat.max, local_stat.max });
-                            stat.min = std::min({ stat.min, local_stat.min });
-                        }
-                    }
-                    else
-                    {
-                        // Histogram vector + variance
-                        std::vector<std::future<std::tuple<std::vector<int>, double>>> workers(config.thread_count);
+        // The last chunk of the file is shorter and says nothing about window size
+        if (bytes % m_granularity != 0 || seconds <= 0.0)
+        {
+            return;
+        }
 
-                        for (int i = 0; i < config.thread_count; i++)
-                        {
-                            ppr::parallel::Hist_processing_unit unit(hist, config, opencl, stat);
-                            workers[i] = std::async(std::launch::async, &ppr::parallel::Hist_processing_unit::run_on_CPU, unit, pView + (opencl.data_count_for_cpu * i), opencl.data_count_for_cpu);
-                        }
+        const unsigned long long scale = bytes / m_granularity;
+        const double throughput = static_cast<double>(bytes) / seconds;
 
-                        // Agregate results results
-                        for (auto& worker : workers)
-                        {
-                            auto [vector, variance] = worker.get();
-                            stat.variance += variance;
-                            std::transform(histogram.begin(), histogram.end(), vector.begin(), histogram.begin(), std::plus<int>());
-                        }
-                    }
-                    UnmapViewOfFile(pView);
-                }
-                ::CloseHandle(hmap);
+        if (seconds > m_timeout)
+        {
+            // Chunk is too slow. Smaller window keeps statistics inside timeout
+            m_scale = std::max(scale / 2, 1ULL);
+            m_best_scale = m_scale;
+            m_best_throughput = 0.0;
+            m_growing = false;
+        }
+        else if (m_growing && scale == m_scale)
+        {
+            if (throughput > m_best_throughput * (1.0 + WINDOW_GROWTH_TOLERANCE))
+            {
+                // Bigger window still helps
+                m_best_throughput = throughput;
+                m_best_scale = scale;
+                m_scale = std::min(scale * 2, m_max_scale);
+                m_growing = m_scale != scale;
+            }
+            else
+            {
+                // Throughput stopped growing. Stay on the best window
+                m_scale = m_best_scale;
+                m_growing = false;
             }
-            ::CloseHandle(hfile);
         }
-        delete filename;
     }
 
-    void File_mapping::read_in_chunks_gpu(
-        SHistogram& hist,
-        SConfig& config,
-        SDataStat& stat,
-        EIteration iteration,
-        std::vector<int>& histogram)
+    std::vector<SChunk_trace> Window_controller::get_trace()
     {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_trace;
+    }
 
-        // Find all devices on all platforms
-        std::vector<cl::Device> devices;
-        ppr::gpu::find_opencl_devices(devices, config.cl_devices_name);
-        DWORD granulatity = m_allocationGranularity * m_scale;
-
-        // Create a file
-        const WCHAR* filename = char2wchar(m_filename);
-        HANDLE hfile = ::CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ,
-            NULL, OPEN_EXISTING, 0, NULL);
-        if (hfile != INVALID_HANDLE_VALUE) {
-            LARGE_INTEGER file_size = { 0 };
-            ::GetFileSizeEx(hfile, &file_size);
-            const unsigned long long cbFile =
-                static_cast<unsigned long long>(file_size.QuadPart);
-
-            // Create a file mapping
-            HANDLE hmap = ::CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
-            if (hmap != NULL) {
+    const unsigned long long File_mapping::get_window_size() const
+    {
+        return static_cast<unsigned long long>(m_allocationGranularity) * m_scale;
+    }
 
-                for (unsigned long long offset = 0; offset < cbFile; offset += granulatity) {
-                    // Get chunk limits
-                    DWORD high = static_cast<DWORD>((offset >> 32) & 0xFFFFFFFFul);
-                    DWORD low = static_cast<DWORD>(offset & 0xFFFFFFFFul);
-                    // The last view may be shorter.
-                    if (offset + granulatity > cbFile) {
-                        granulatity = static_cast<int>(cbFile - offset);
-                    }
+    bool File_mapping::open_mapping()
+    {
+        if (!create_file_n())
+        {
+            return false;
+        }
 
-                    // Map one chunk
-                    double* pView = static_cast<double*>(
-                        ::MapViewOfFile(hmap, FILE_MAP_READ, high, low, granulatity));
+        return map_file();
+    }
 
-                    if (pView != NULL) {
-                        unsigned long long data_in_chunk = granulatity / sizeof(double);
+    double* File_mapping::map_window(unsigned long long offset, unsigned long long bytes)
+    {
+        ppr::trace::Scope trace("map window", "io", bytes / sizeof(double));
+        DWORD high = static_cast<DWORD>((offset >> 32) & 0xFFFFFFFFul);
+        DWORD low = static_cast<DWORD>(offset & 0xFFFFFFFFul);
 
-                        if (iteration == EIteration::STAT)
-                        {
-                            std::vector<std::future<SDataStat>> workers(devices.size());
-
-                            for (int i = 0; i < devices.size(); i++)
-                            {
-                                ppr::gpu::SOpenCLConfig opencl;
-                                opencl.device = devices[i];
-                                ppr::gpu::set_kernel_program(opencl, STAT_KERNEL, STAT_KERNEL_NAME);
-
-                                // Set opencl computing limits
-                                if (opencl.wg_size != 0)
-                                {
-                                    opencl.data_count_for_gpu = (data_in_chunk - (data_in_chunk % opencl.wg_size)) / devices.size();
-                                }
-
-                                ppr::parallel::Stat_processing_unit unit(config, opencl);
-                                workers[i] = std::async(std::launch::async, &ppr::parallel::Stat_processing_unit::run_on_GPU, unit, pView, opencl.data_count_for_gpu * i,
-                                    (opencl.data_count_for_gpu * i) + opencl.data_count_for_gpu);
-                            }
-
-                            // Collect results
-                            for (auto& worker : workers)
-                            {
-                                SDataStat local_stat = worker.get();
-                                stat.sum += local_stat.sum;
-                                stat.n += local_stat.n;
-                                stat.max = std::max({ stat.max, local_stat.max });
-                                stat.min = std::min({ stat.min, local_stat.min });
-                            }
-                        }
-                        else
-                        {
-                            // Histogram vector + variance
-                            std::vector<std::future<std::tuple<std::vector<int>, double>>> workers(devices.size());
-
-                            for (int i = 0; i < devices.size(); i++)
-                            {
-                                ppr::gpu::SOpenCLConfig opencl;
-                                opencl.device = devices[i];
-                                ppr::gpu::set_kernel_program(opencl, HIST_KERNEL, HIST_KERNEL_NAME);
-
-                                // Set opencl computing limits
-                                if (opencl.wg_size != 0)
-                                {
-                                    opencl.data_count_for_gpu = (data_in_chunk - (data_in_chunk % opencl.wg_size)) / devices.size();
-                                }
-
-                                ppr::parallel::Hist_processing_unit unit(hist, config, opencl, stat);
-                                workers[i] = std::async(std::launch::async, &ppr::parallel::Hist_processing_unit::run_on_GPU, unit, pView, opencl.data_count_for_gpu * i,
-                                    (opencl.data_count_for_gpu * i) + opencl.data_count_for_gpu);
-                            }
-
-                            // Agregate results results
-                            for (auto& worker : workers)
-                            {
-                                auto [vector, variance] = worker.get();
-                                stat.variance += variance;
-                                std::transform(histogram.begin(), histogram.end(), vector.begin(), histogram.begin(), std::plus<int>());
-                            }
-                        }
+        return static_cast<double*>(::MapViewOfFile(m_mapping, FILE_MAP_READ, high, low, static_cast<size_t>(bytes)));
+    }
 
+    void File_mapping::unmap_window(double* view)
+    {
+        ppr::trace::Scope trace("unmap window", "io");
+        UnmapViewOfFile(view);
+    }
 
-                        UnmapViewOfFile(pView);
-                    }
-                }
-                ::CloseHandle(hmap);
-            }
-            ::CloseHandle(hfile);
-        }
-        delete filename;
+    void File_mapping::close_mapping()
+    {
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
     }
 
-    void File_mapping::read_in_chunks_tbb(
+    void File_mapping::read_in_chunks_gpu(
         SHistogram& hist,
-        SConfig& config,
-        ppr::gpu::SOpenCLConfig& opencl,
         SDataStat& stat,
-        tbb::task_arena& arena,
+        EIteration iteration,
         std::vector<int>& histogram,
-        void (*process_chunk) (SHistogram& hist, SConfig&, ppr::gpu::SOpenCLConfig&, SDataStat&, tbb::task_arena&, unsigned long long, double*, std::vector<int>&))
+        Window_controller& controller,
+        ppr::gpu::Work_scheduler& scheduler,
+        ppr::checkpoint::Checkpointer& checkpointer,
+        unsigned long long start)
     {
-        DWORD granulatity = m_allocationGranularity * m_scale;
+        DWORD granulatity = 0;
 
         // Create a file
         const WCHAR* filename = char2wchar(m_filename);
@@ -357,7 +261,16 @@ namespace ppr
             // Create a file mapping
             HANDLE hmap = ::CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
             if (hmap != NULL) {
-                for (unsigned long long offset = 0; offset < cbFile; offset += granulatity) {
+
+                // Resumed pass starts at checkpoint, view must start at allocation granularity
+                const unsigned long long lead = start % get_granularity();
+
+                // Cancelled run maps no more windows
+                for (unsigned long long offset = start - lead; offset < cbFile && !scheduler.is_cancelled(); offset += granulatity) {
+                    // Window size is chosen by throughput of previous chunks
+                    granulatity = static_cast<DWORD>(controller.get_window_size());
+                    tbb::tick_count t0 = tbb::tick_count::now();
+
                     // Get chunk limits
                     DWORD high = static_cast<DWORD>((offset >> 32) & 0xFFFFFFFFul);
                     DWORD low = static_cast<DWORD>(offset & 0xFFFFFFFFul);
@@ -366,33 +279,36 @@ namespace ppr
                         granulatity = static_cast<int>(cbFile - offset);
                     }
 
+                    // Values before checkpoint are skipped in the first view
+                    const unsigned long long skip = offset < start ? start - offset : 0;
+
                     // Map one chunk
+                    const long long map_begin = ppr::trace::is_enabled() ? ppr::trace::now() : 0;
                     double* pView = static_cast<double*>(
                         ::MapViewOfFile(hmap, FILE_MAP_READ, high, low, granulatity));
+                    if (map_begin != 0) {
+                        ppr::trace::record("map window", "io", map_begin, ppr::trace::now(), granulatity / sizeof(double));
+                    }
 
                     if (pView != NULL) {
-                        unsigned long long data_in_chunk = granulatity / sizeof(double);
-
-                        // Set opencl computing limits
-                        if (opencl.wg_size != 0)
+                        // Sub-chunks of the window are shared by CPU and OpenCL devices
                         {
-                            // Get number of data, which we want to process on GPU
-                            opencl.wg_count = static_cast<unsigned long>(data_in_chunk / opencl.wg_size);
-                            opencl.data_count_for_gpu = data_in_chunk - (data_in_chunk % opencl.wg_size);
-
-                            // The rest of the data we will process on CPU
-                            opencl.data_count_for_cpu = opencl.data_count_for_gpu + 1;
+                            ppr::trace::Scope trace(iteration == EIteration::STAT ? "stat window" : "hist window", "scheduler", (granulatity - skip) / sizeof(double));
+                            scheduler.process(iteration, pView + skip / sizeof(double), (granulatity - skip) / sizeof(double), hist, stat, histogram);
                         }
-                        else
+
                         {
-                            opencl.data_count_for_cpu = 0;
+                            ppr::trace::Scope trace("unmap window", "io");
+                            UnmapViewOfFile(pView);
                         }
 
-                        // Run
-                        process_chunk(hist, config, opencl, stat, arena, data_in_chunk, pView, histogram);
-
-                        UnmapViewOfFile(pView);
+                        // Window is merged completely, unless the run was cancelled inside it
+                        if (!scheduler.is_cancelled()) {
+                            checkpointer.chunk_done(iteration, offset + granulatity, stat, histogram);
+                        }
                     }
+
+                    controller.report(iteration, granulatity - skip, (tbb::tick_count::now() - t0).seconds());
                 }
                 ::CloseHandle(hmap);
             }
@@ -2,9 +2,38 @@
 #include "include/executor.h"
 #include "include/watchdog.h"
 #include "include/histogram.h"
+#include "include/memory_usage.h"
 
 namespace ppr::gpu
 {
+	/// <summary>
+	/// Finish cancelled run with partial result
+	/// </summary>
+	/// <param name="res">- Result of finished stages</param>
+	/// <param name="telemetry">- Cancellation token</param>
+	/// <param name="controller">- Window size controller</param>
+	/// <param name="scheduler">- Work scheduler</param>
+	/// <param name="watchdog">- Watchdog thread</param>
+	/// <param name="sampler">- Memory sampler</param>
+	/// <param name="start">- Start of the run</param>
+	/// <returns>Partial result with exit status of cancellation</returns>
+	static SResult cancelled_result(SResult& res, ppr::watchdog::Telemetry& telemetry, Window_controller& controller, Work_scheduler& scheduler,
+		std::thread& watchdog, ppr::memory::Memory_sampler& sampler, tbb::tick_count start)
+	{
+		ppr::print_error("Run was cancelled, results are partial.");
+
+		res.status = telemetry.get_status();
+		res.processed = telemetry.sample(EIteration::STAT).elements + telemetry.sample(EIteration::HIST).elements;
+		res.total_time = (tbb::tick_count::now() - start).seconds();
+		res.chunk_trace = controller.get_trace();
+		res.backend_trace = scheduler.get_trace();
+		res.stage_memory = sampler.stop();
+		telemetry.set_stage(4);
+
+		watchdog.join();
+		return res;
+	}
+
 	SResult run(SConfig& configuration)
 	{
 		tbb::tick_count total1;
@@ -21,7 +50,7 @@ namespace ppr::gpu
 
 		//  ================ [Allocations]
 		tbb::tick_count total2;
-		int stage = 0;
+		ppr::watchdog::Telemetry telemetry(arena.max_concurrency());
 		SHistogram hist;
 		SResult res;
 		SDataStat stat;
@@ -31,61 +60,89 @@ namespace ppr::gpu
 		long data_count = mapping.get_count();
 		double* data = mapping.get_data();
 
+		stat.stats = ppr::executor::required_statistics(configuration);
+		Window_controller controller(mapping.get_granularity(), mapping.get_window_size(), static_cast<double>(configuration.stat_timeout), configuration.window_size, configuration.fixed_window);
+		Work_scheduler scheduler(arena, configuration, telemetry);
+
+		//  ================ [Resume from checkpoint]
+		ppr::checkpoint::Checkpointer checkpointer(configuration, static_cast<unsigned long long>(data_count) * sizeof(double), stat.stats);
+		ppr::checkpoint::SCheckpoint checkpoint;
+		if (configuration.resume && !checkpointer.load(checkpoint))
+		{
+			return SResult::error_res(EExitStatus::ARGS);
+		}
+		const bool resume_hist = configuration.resume && checkpoint.iteration == EIteration::HIST;
+		if (configuration.resume)
+		{
+			stat = checkpoint.stat;
+		}
+
 		//  ================ [Start Watchdog]
-		std::thread watchdog = ppr::watchdog::start_watchdog(configuration, stat, hist, stage, histogramFreq, histogramDensity, data_count);
+		std::thread watchdog = ppr::watchdog::start_watchdog(configuration, stat, hist, telemetry, histogramFreq, histogramDensity, data_count);
+		ppr::memory::Memory_sampler sampler(telemetry);
 
 		//  ================ [Get statistics]
+		// Resumed histogram pass skips statistics
 		tbb::tick_count t0 = tbb::tick_count::now();
-		mapping.read_in_chunks_gpu(hist, configuration, stat, EIteration::STAT, histogramFreq);
+		if (!resume_hist)
+		{
+			mapping.read_in_chunks_gpu(hist, stat, EIteration::STAT, histogramFreq, controller, scheduler, checkpointer, checkpoint.offset);
+		}
 		tbb::tick_count t1 = tbb::tick_count::now();
 		
 		res.total_stat_time = (t1 - t0).seconds();
 
+		if (telemetry.is_cancelled())
+		{
+			return cancelled_result(res, telemetry, controller, scheduler, watchdog, sampler, total1);
+		}
+
 		//  ================ [Fit params using Maximum likelihood estimation]
 
 		res.isNegative = stat.min < 0;
-		res.isInteger = std::floor(stat.sum) == stat.sum;
+		res.isInteger = stat.isInteger;
+		stat.isNegative = res.isNegative;
+		stat.isInteger = res.isInteger;
 
 		// Find mean
 		stat.mean = stat.sum / stat.n;
 
-		// Poisson likelihood estimators
-		res.poisson_lambda = stat.sum / stat.n;
-
 		//  ================ [Create frequency histogram]
-
-		// Find histogram limits
-		double bin_count = 0.0;
-		double bin_size = 0.0;
-
-		// If data can belongs to poisson distribution, we should use integer intervals
-		if (!res.isNegative && res.isInteger && res.poisson_lambda > 0)
-		{
-			hist.binCount = static_cast<int>(stat.max - stat.min);
-			hist.binSize = 1.0;
-		}
-		else
-		{
-			hist.binCount = static_cast<int>(log2(stat.n)) + 2;
-			hist.binSize = (stat.max - stat.min) / (static_cast<double>(hist.binCount) - 1.0);
-		}
-		hist.scaleFactor = (hist.binCount) / (stat.max - stat.min);
+		ppr::executor::compute_histogram_limits(hist, stat);
 
 		// Allocate memmory
 		histogramFreq.resize(static_cast<int>(hist.binCount));
 		histogramDensity.resize(static_cast<int>(hist.binCount));
 		cl_int err = 0;
 
+		if (resume_hist && !checkpoint.histogram.empty())
+		{
+			if (checkpoint.histogram.size() != histogramFreq.size())
+			{
+				ppr::print_error("Checkpoint histogram does not match statistics");
+				telemetry.cancel(EExitStatus::ARGS);
+				return cancelled_result(res, telemetry, controller, scheduler, watchdog, sampler, total1);
+			}
+			histogramFreq = checkpoint.histogram;
+		}
+
 		// Run
-		stage = 1;
+		telemetry.set_stage(1);
 		t0 = tbb::tick_count::now();
-		mapping.read_in_chunks_gpu(hist, configuration, stat, EIteration::HIST, histogramFreq);
+		mapping.read_in_chunks_gpu(hist, stat, EIteration::HIST, histogramFreq, controller, scheduler, checkpointer, resume_hist ? checkpoint.offset : 0);
 		t1 = tbb::tick_count::now();
 		
 		res.total_hist_time = (t1 - t0).seconds();
 
+		if (telemetry.is_cancelled())
+		{
+			return cancelled_result(res, telemetry, controller, scheduler, watchdog, sampler, total1);
+		}
+
+		checkpointer.finish();
+
 		//  ================ [Create density histogram]
-		stage = 2;
+		telemetry.set_stage(2);
 		ppr::executor::compute_propability_density_histogram(hist, histogramFreq, histogramDensity, stat.n);
 
 		//  ================ [Fit params using Maximum likelihood estimation]
@@ -93,29 +150,29 @@ namespace ppr::gpu
 		// Find variance
 		stat.variance = stat.variance / stat.n;
 
-		// Gauss maximum likelihood estimators
-		res.gauss_mean = stat.mean;
-		res.gauss_variance = stat.variance;
-		res.gauss_stdev = sqrt(stat.variance);
-
-		// Exponential maximum likelihood estimators
-		res.exp_lambda = stat.n / stat.sum;
+		// Maximum likelihood estimators of all distributions
+		ppr::executor::fit_distributions(configuration, stat, res);
 
-		// Uniform likelihood estimators
-		res.uniform_a = stat.min;
-		res.uniform_b = stat.max;
+		// Goodness-of-fit criteria from frequency histogram
+		ppr::executor::compute_goodness_of_fit(hist, histogramFreq, res);
 
 		//	================ [Calculate RSS]
-		stage = 3;
+		telemetry.set_stage(3);
 		ppr::parallel::calculate_histogram_RSS_cpu(res, histogramDensity, hist);
 
 		//	================ [Analyze Results]
-		ppr::executor::analyze_results(res);
+		ppr::executor::analyze_results(configuration, res);
 
 		total2 = tbb::tick_count::now();
 
 		res.total_time = (total2 - total1).seconds();
-		stage = 4;
+		res.chunk_trace = controller.get_trace();
+		res.backend_trace = scheduler.get_trace();
+		res.processed = telemetry.sample(EIteration::STAT).elements + telemetry.sample(EIteration::HIST).elements;
+		res.checkpoint_count = checkpointer.get_count();
+		res.checkpoint_time = checkpointer.get_seconds();
+		res.stage_memory = sampler.stop();
+		telemetry.set_stage(4);
 
 		std::cout << "\t\t\t[Statistics]" << std::endl;
 		std::cout << "---------------------------------------------------------------------" << std::endl;
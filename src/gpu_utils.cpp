@@ -1,12 +1,45 @@
 #include "include/gpu_utils.h"
 #include "include/smp_utils.h"
+#include "include/distribution.h"
+#include "include/trace.h"
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <filesystem>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <tbb/tick_count.h>
 
 namespace ppr::gpu
 {
+    /// <summary>
+    /// First error of several OpenCL calls. Calls are evaluated in order of the list
+    /// </summary>
+    /// <param name="errors">- Error codes of calls</param>
+    /// <returns>First code, which is not CL_SUCCESS, or CL_SUCCESS</returns>
+    static cl_int first_error(std::initializer_list<cl_int> errors)
+    {
+        for (const cl_int err : errors)
+        {
+            if (err != CL_SUCCESS)
+            {
+                return err;
+            }
+        }
+        return CL_SUCCESS;
+    }
+
+    cl_int use_local_histogram(SOpenCLConfig& opencl, SHistogram& hist)
+    {
+        const unsigned long long local_bytes = opencl.wg_size * sizeof(double) + hist.binCount * sizeof(cl_uint);
+        return local_bytes <= opencl.local_mem_size ? 1 : 0;
+    }
+
     void run_histogram_on_GPU(SOpenCLConfig& opencl, SConfig& configuration, SHistogram& hist, SDataStat& data_stat,
         double* data, long long begin, long long end, std::vector<int>& freq_buckets, double& var)
     {
@@ -15,14 +48,18 @@ namespace ppr::gpu
         const unsigned long long work_group_number = data_count / opencl.wg_size;
         const unsigned long long count = data_count - (data_count % opencl.wg_size);
 
+        const cl_int use_local = use_local_histogram(opencl, hist);
+
         // Result data
-        double* out_var = new double[work_group_number];
-        std::vector<cl_uint> out_histogram(2 * hist.binCount, 0);
+        std::vector<double> out_var(work_group_number, 0.0);
+        std::vector<cl_uint> out_histogram(hist.binCount, 0);
 
         // Buffers
-        cl::Buffer in_data_buf(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data + begin, &err); 
-        cl::Buffer out_sum_buf(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, out_histogram.size() * sizeof(cl_uint), out_histogram.data(), &err);
-        cl::Buffer out_var_buf(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_group_number * sizeof(double), nullptr, &err);
+        cl_int buffer_err[3] = {};
+        cl::Buffer in_data_buf(opencl.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data + begin, &buffer_err[0]); 
+        cl::Buffer out_hist_buf(opencl.context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, out_histogram.size() * sizeof(cl_uint), out_histogram.data(), &buffer_err[1]);
+        cl::Buffer out_var_buf(opencl.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_group_number * sizeof(double), nullptr, &buffer_err[2]);
+        err = first_error({ buffer_err[0], buffer_err[1], buffer_err[2] });
 
         if (err != CL_SUCCESS)
         {
@@ -31,15 +68,18 @@ namespace ppr::gpu
         }
 
         // Set method arguments
-        err = opencl.kernel.setArg(0, in_data_buf);
-        err = opencl.kernel.setArg(1, opencl.wg_size * sizeof(double), nullptr);
-        err = opencl.kernel.setArg(2, out_sum_buf);
-        err = opencl.kernel.setArg(3, out_var_buf);
-        err = opencl.kernel.setArg(4, sizeof(double), &data_stat.mean);
-        err = opencl.kernel.setArg(5, sizeof(double), &data_stat.min);
-        err = opencl.kernel.setArg(6, sizeof(double), &hist.scaleFactor);
-        err = opencl.kernel.setArg(7, sizeof(double), &hist.binSize);
-        err = opencl.kernel.setArg(8, sizeof(double), &hist.binCount);
+        err = first_error({
+            opencl.kernel.setArg(0, in_data_buf),
+            opencl.kernel.setArg(1, opencl.wg_size * sizeof(double), nullptr),
+            opencl.kernel.setArg(2, use_local ? hist.binCount * sizeof(cl_uint) : sizeof(cl_uint), nullptr),
+            opencl.kernel.setArg(3, out_hist_buf),
+            opencl.kernel.setArg(4, out_var_buf),
+            opencl.kernel.setArg(5, sizeof(double), &data_stat.mean),
+            opencl.kernel.setArg(6, sizeof(double), &data_stat.min),
+            opencl.kernel.setArg(7, sizeof(double), &hist.scaleFactor),
+            opencl.kernel.setArg(8, static_cast<cl_int>(hist.binCount)),
+            opencl.kernel.setArg(9, use_local)
+        });
 
         if (err != CL_SUCCESS)
         {
@@ -48,7 +88,7 @@ namespace ppr::gpu
         }
 
         // Pass all data to GPU
-        cl::CommandQueue cmd_queue(opencl.context, opencl.device, 0, &err);
+        cl::CommandQueue& cmd_queue = opencl.queue;
         err = cmd_queue.enqueueNDRangeKernel(opencl.kernel, cl::NullRange, cl::NDRange(count), cl::NDRange(opencl.wg_size));
 
         if (err != CL_SUCCESS)
@@ -58,8 +98,10 @@ namespace ppr::gpu
         }
 
         // Fill output vectors
-        err = cmd_queue.enqueueReadBuffer(out_sum_buf, CL_TRUE, 0, out_histogram.size() * sizeof(cl_uint), out_histogram.data());
-        err = cmd_queue.enqueueReadBuffer(out_var_buf, CL_TRUE, 0, work_group_number * sizeof(double), out_var);
+        err = first_error({
+            cmd_queue.enqueueReadBuffer(out_hist_buf, CL_TRUE, 0, out_histogram.size() * sizeof(cl_uint), out_histogram.data()),
+            cmd_queue.enqueueReadBuffer(out_var_buf, CL_TRUE, 0, work_group_number * sizeof(double), out_var.data())
+        });
 
         if (err != CL_SUCCESS)
         {
@@ -67,104 +109,518 @@ namespace ppr::gpu
             return;
         }
 
-        // Wait on kernel
-        cl::finish();
-
         // Agragate results
-        int binCount = hist.binCount;
-        for (int i = 0; i < binCount; i++)
+        for (int i = 0; i < hist.binCount; i++)
         {
-            const int value = out_histogram[2 * i] + out_histogram[2 * i + 1] * sizeof(cl_uint);
-            freq_buckets[i] = freq_buckets[i] + value;
+            freq_buckets[i] = freq_buckets[i] + static_cast<int>(out_histogram[i]);
         }
 
         // Agregate results on CPU
-        var += ppr::parallel::sum_vector_elements_vectorized(out_var, work_group_number);
-
-        delete[] out_var;
+        var += ppr::parallel::sum_vector_elements_vectorized(out_var.data(), work_group_number);
     }
 
-    void run_statistics_on_GPU(SDataStat& stat, SOpenCLConfig& m_ocl_config, SConfig& configuration, double* data, long long begin, long long end)
+    /// <summary>
+    /// Enqueue both statistics stages. First stage writes one partial record per work group, second stage reduces them to one record
+    /// </summary>
+    /// <param name="opencl">- Opencl configuration structure</param>
+    /// <param name="input">- Input values buffer</param>
+    /// <param name="count">- Values count</param>
+    /// <param name="partials">- Buffer for STAT_MAX_GROUPS records</param>
+    /// <param name="result">- Buffer for one record</param>
+    /// <param name="stats">- Collected sufficient statistics</param>
+    /// <param name="wait">- Events to wait for (nullptr = none)</param>
+    /// <param name="first_stage">- Event of first stage</param>
+    /// <param name="second_stage">- Event of second stage</param>
+    /// <returns>Error code</returns>
+    static cl_int enqueue_statistics(SOpenCLConfig& opencl, cl::Buffer& input, unsigned long long count, cl::Buffer& partials, cl::Buffer& result,
+        unsigned int stats, const std::vector<cl::Event>* wait, cl::Event* first_stage, cl::Event* second_stage)
     {
-        SDataStat local_stat;
         cl_int err = 0;
-        const long long data_count = m_ocl_config.data_count_for_gpu;
-        const unsigned long long work_group_number = data_count / m_ocl_config.wg_size;
-        const unsigned long long count = data_count - (data_count % m_ocl_config.wg_size);
+        const unsigned long long groups = std::max(1ULL, std::min(STAT_MAX_GROUPS, (count + opencl.wg_size - 1) / opencl.wg_size));
 
-        cl::CommandQueue cmd_queue(m_ocl_config.context, m_ocl_config.device, 0, &err);
+        err = first_error({
+            opencl.kernel.setArg(0, input),
+            opencl.kernel.setArg(1, static_cast<cl_ulong>(count)),
+            opencl.kernel.setArg(2, opencl.wg_size * sizeof(SDevice_stat), nullptr),
+            opencl.kernel.setArg(3, partials),
+            opencl.kernel.setArg(4, static_cast<cl_uint>(stats)),
 
-        // Result data
-        double* out_sum = new double[work_group_number];
-        double* out_min = new double[work_group_number];
-        double* out_max = new double[work_group_number];
+            opencl.reduce_kernel.setArg(0, partials),
+            opencl.reduce_kernel.setArg(1, static_cast<cl_uint>(groups)),
+            opencl.reduce_kernel.setArg(2, opencl.wg_size * sizeof(SDevice_stat), nullptr),
+            opencl.reduce_kernel.setArg(3, result)
+        });
+
+        if (err != CL_SUCCESS)
+        {
+            return err;
+        }
+
+        err = opencl.queue.enqueueNDRangeKernel(opencl.kernel, cl::NullRange, cl::NDRange(groups * opencl.wg_size), cl::NDRange(opencl.wg_size), wait, first_stage);
+
+        if (err != CL_SUCCESS)
+        {
+            return err;
+        }
+
+        // In-order queue, second stage starts after the first one
+        return opencl.queue.enqueueNDRangeKernel(opencl.reduce_kernel, cl::NullRange, cl::NDRange(opencl.wg_size), cl::NDRange(opencl.wg_size), nullptr, second_stage);
+    }
+
+    /// <summary>
+    /// Add device statistics record to statistics structure
+    /// </summary>
+    /// <param name="record">- Device statistics record</param>
+    /// <param name="stat">- Statistics structure</param>
+    static void merge_record(const SDevice_stat& record, SDataStat& stat)
+    {
+        SDataStat part;
+        part.n = static_cast<unsigned long long>(record.n);
+        part.sum = record.sum;
+        part.min = record.min;
+        part.max = record.max;
+        part.sumLog = record.sum_log;
+        part.sumLog2 = record.sum_log2;
+        part.sumXLog = record.sum_x_log;
+        part.sumLog1m = record.sum_log1m;
+        part.isNegative = record.negative != 0.0;
+        part.isInteger = record.integer != 0.0;
+
+        stat.merge(part);
+    }
+
+    SDevice_stat run_statistics_on_GPU(SDataStat& stat, SOpenCLConfig& m_ocl_config, SConfig& configuration, double* data, long long begin, long long end)
+    {
+        SDevice_stat record;
+        cl_int err = 0;
+        const unsigned long long count = m_ocl_config.data_count_for_gpu;
 
         // Input and output buffers
-        cl::Buffer in_data_buf(m_ocl_config.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data + begin, &err);
-        cl::Buffer out_sum_buf(m_ocl_config.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_group_number * sizeof(double), nullptr, &err);
-        cl::Buffer out_min_buf(m_ocl_config.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_group_number * sizeof(double), nullptr, &err);
-        cl::Buffer out_max_buf(m_ocl_config.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, work_group_number * sizeof(double), nullptr, &err);
-        
+        cl_int buffer_err[3] = {};
+        cl::Buffer in_data_buf(m_ocl_config.context, CL_MEM_READ_ONLY | CL_MEM_HOST_NO_ACCESS | CL_MEM_USE_HOST_PTR, count * sizeof(double), data + begin, &buffer_err[0]);
+        cl::Buffer partials_buf(m_ocl_config.context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, STAT_MAX_GROUPS * sizeof(SDevice_stat), nullptr, &buffer_err[1]);
+        cl::Buffer result_buf(m_ocl_config.context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(SDevice_stat), nullptr, &buffer_err[2]);
+        err = first_error({ buffer_err[0], buffer_err[1], buffer_err[2] });
+
         if (err != CL_SUCCESS)
         {
             ppr::print_error(get_CL_error_string(err));
-            return;
+            return record;
         }
 
-        // Set method arguments
-        err = m_ocl_config.kernel.setArg(0, in_data_buf);
-        err = m_ocl_config.kernel.setArg(1, m_ocl_config.wg_size * sizeof(double), nullptr);
-        err = m_ocl_config.kernel.setArg(2, m_ocl_config.wg_size * sizeof(double), nullptr);
-        err = m_ocl_config.kernel.setArg(3, m_ocl_config.wg_size * sizeof(double), nullptr);
-        err = m_ocl_config.kernel.setArg(4, out_sum_buf);
-        err = m_ocl_config.kernel.setArg(5, out_min_buf);
-        err = m_ocl_config.kernel.setArg(6, out_max_buf);
+        err = enqueue_statistics(m_ocl_config, in_data_buf, count, partials_buf, result_buf, stat.stats, nullptr, nullptr, nullptr);
 
         if (err != CL_SUCCESS)
         {
             ppr::print_error(get_CL_error_string(err));
-            return;
+            return record;
+        }
+
+        // Only one record crosses the bus
+        err = m_ocl_config.queue.enqueueReadBuffer(result_buf, CL_TRUE, 0, sizeof(SDevice_stat), &record);
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            return record;
+        }
+
+        merge_record(record, stat);
+        return record;
+    }
+
+    /// <summary>
+    /// Profiled execution time of finished command
+    /// </summary>
+    /// <param name="event">- Command event</param>
+    /// <returns>Seconds</returns>
+    static double event_seconds(const cl::Event& event)
+    {
+        cl_ulong start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        cl_ulong end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        return end > start ? static_cast<double>(end - start) * 1e-9 : 0.0;
+    }
+
+    Device_pipeline::Device_pipeline(SOpenCLConfig& stat_kernel, SOpenCLConfig& hist_kernel, const ppr::watchdog::Telemetry& telemetry)
+        : m_stat_kernel(stat_kernel), m_hist_kernel(hist_kernel), m_telemetry(telemetry)
+    {
+        cl_int err = 0;
+        const unsigned long long bytes = PIPELINE_SLOT_VALUES * sizeof(double);
+        const unsigned long long groups = PIPELINE_SLOT_VALUES / m_hist_kernel.wg_size;
+        cl::Context& context = m_stat_kernel.context;
+
+        if (ppr::trace::is_enabled())
+        {
+            const std::string name = m_stat_kernel.device.getInfo<CL_DEVICE_NAME>();
+            m_trace_track = ppr::trace::add_track(name + " upload");
+            ppr::trace::add_track(name + " kernel");
+            ppr::trace::add_track(name + " download");
+        }
+
+        m_upload_queue = cl::CommandQueue(context, m_stat_kernel.device, CL_QUEUE_PROFILING_ENABLE, &err);
+        if (err == CL_SUCCESS)
+        {
+            m_download_queue = cl::CommandQueue(context, m_stat_kernel.device, CL_QUEUE_PROFILING_ENABLE, &err);
         }
 
-        // Pass all data to GPU
-        err = cmd_queue.enqueueNDRangeKernel(m_ocl_config.kernel, cl::NullRange, cl::NDRange(count), cl::NDRange(m_ocl_config.wg_size));
-        
         if (err != CL_SUCCESS)
         {
             ppr::print_error(get_CL_error_string(err));
             return;
         }
 
-        // Fill output vectors
-        err = cmd_queue.enqueueReadBuffer(out_sum_buf, CL_TRUE, 0, work_group_number * sizeof(double), out_sum);
-        err = cmd_queue.enqueueReadBuffer(out_min_buf, CL_TRUE, 0, work_group_number * sizeof(double), out_min);
-        err = cmd_queue.enqueueReadBuffer(out_max_buf, CL_TRUE, 0, work_group_number * sizeof(double), out_max);
+        for (auto& slot : m_slots)
+        {
+            cl_int buffer_err[5] = {};
+            slot.staging = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes, nullptr, &buffer_err[0]);
+            slot.input = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, bytes, nullptr, &buffer_err[1]);
+            slot.partials = cl::Buffer(context, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, STAT_MAX_GROUPS * sizeof(SDevice_stat), nullptr, &buffer_err[2]);
+            slot.result = cl::Buffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(SDevice_stat), nullptr, &buffer_err[3]);
+            slot.out_var = cl::Buffer(context, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, groups * sizeof(double), nullptr, &buffer_err[4]);
+            err = first_error({ buffer_err[0], buffer_err[1], buffer_err[2], buffer_err[3], buffer_err[4] });
+
+            if (err != CL_SUCCESS)
+            {
+                ppr::print_error(get_CL_error_string(err));
+                return;
+            }
+
+            // Staging buffer stays mapped for the whole run
+            slot.pinned = static_cast<double*>(m_upload_queue.enqueueMapBuffer(slot.staging, CL_TRUE, CL_MAP_WRITE, 0, bytes, nullptr, nullptr, &err));
+
+            if (err != CL_SUCCESS || slot.pinned == nullptr)
+            {
+                ppr::print_error(get_CL_error_string(err));
+                return;
+            }
+
+            slot.var.resize(groups);
+        }
+
+        m_ready = true;
+    }
+
+    Device_pipeline::~Device_pipeline()
+    {
+        // Device, which failed or missed deadline, may never finish. Its memory is released with the process
+        if (m_failed)
+        {
+            return;
+        }
+
+        for (auto& slot : m_slots)
+        {
+            if (slot.count != 0)
+            {
+                slot.download.wait();
+            }
+            if (slot.pinned != nullptr)
+            {
+                m_upload_queue.enqueueUnmapMemObject(slot.staging, slot.pinned);
+            }
+        }
+
+        m_upload_queue.finish();
+    }
+
+    void Device_pipeline::enqueue(SSlot& slot, EIteration iteration, const double* data, unsigned long long count, SHistogram& hist, SDataStat& stat)
+    {
+        cl_int err = 0;
+        SOpenCLConfig& opencl = iteration == EIteration::STAT ? m_stat_kernel : m_hist_kernel;
+        const unsigned long long groups = count / opencl.wg_size;
+        const unsigned long long bytes = count * sizeof(double);
+
+        // Host copy to pinned memory. Source window can be unmapped, when submit returns
+        {
+            ppr::trace::Scope trace("staging copy", "opencl", count);
+            std::memcpy(slot.pinned, data, bytes);
+        }
+
+        if (iteration == EIteration::HIST)
+        {
+            // Histogram buffer follows bin count of current pass
+            if (slot.histogram.size() != static_cast<size_t>(hist.binCount))
+            {
+                slot.histogram.assign(hist.binCount, 0);
+                slot.out_hist = cl::Buffer(opencl.context, CL_MEM_READ_WRITE, slot.histogram.size() * sizeof(cl_uint), nullptr, &err);
+            }
+
+            // In-order upload queue clears histogram before upload event completes
+            const cl_int use_local = use_local_histogram(opencl, hist);
+            err = first_error({
+                err,
+                m_upload_queue.enqueueFillBuffer(slot.out_hist, static_cast<cl_uint>(0), 0, slot.histogram.size() * sizeof(cl_uint)),
+
+                opencl.kernel.setArg(0, slot.input),
+                opencl.kernel.setArg(1, opencl.wg_size * sizeof(double), nullptr),
+                opencl.kernel.setArg(2, use_local ? hist.binCount * sizeof(cl_uint) : sizeof(cl_uint), nullptr),
+                opencl.kernel.setArg(3, slot.out_hist),
+                opencl.kernel.setArg(4, slot.out_var),
+                opencl.kernel.setArg(5, sizeof(double), &stat.mean),
+                opencl.kernel.setArg(6, sizeof(double), &stat.min),
+                opencl.kernel.setArg(7, sizeof(double), &hist.scaleFactor),
+                opencl.kernel.setArg(8, static_cast<cl_int>(hist.binCount)),
+                opencl.kernel.setArg(9, use_local)
+            });
+        }
+
+        // Upload -> kernel -> download, nothing is enqueued after a failed command
+        if (err == CL_SUCCESS)
+        {
+            err = m_upload_queue.enqueueWriteBuffer(slot.input, CL_FALSE, 0, bytes, slot.pinned, nullptr, &slot.upload);
+        }
+
+        std::vector<cl::Event> after_upload(1, slot.upload);
+        if (err == CL_SUCCESS && iteration == EIteration::STAT)
+        {
+            err = enqueue_statistics(opencl, slot.input, count, slot.partials, slot.result, stat.stats, &after_upload, &slot.kernel, &slot.reduce);
+
+            // Only one record crosses the bus
+            std::vector<cl::Event> after_reduce(1, slot.reduce);
+            if (err == CL_SUCCESS)
+            {
+                err = m_download_queue.enqueueReadBuffer(slot.result, CL_FALSE, 0, sizeof(SDevice_stat), &slot.record, &after_reduce, &slot.download);
+            }
+        }
+        else if (err == CL_SUCCESS)
+        {
+            err = opencl.queue.enqueueNDRangeKernel(opencl.kernel, cl::NullRange, cl::NDRange(count), cl::NDRange(opencl.wg_size), &after_upload, &slot.kernel);
+
+            std::vector<cl::Event> after_kernel(1, slot.kernel);
+            if (err == CL_SUCCESS)
+            {
+                err = m_download_queue.enqueueReadBuffer(slot.out_hist, CL_FALSE, 0, slot.histogram.size() * sizeof(cl_uint), slot.histogram.data(), &after_kernel);
+            }
+            if (err == CL_SUCCESS)
+            {
+                err = m_download_queue.enqueueReadBuffer(slot.out_var, CL_FALSE, 0, groups * sizeof(double), slot.var.data(), nullptr, &slot.download);
+            }
+        }
+
+        // Start commands, while host copies the next piece
+        m_upload_queue.flush();
+        opencl.queue.flush();
+        m_download_queue.flush();
 
         if (err != CL_SUCCESS)
         {
+            // Enqueued commands may still use the slot, the piece goes back to CPU and the device is not used any more
             ppr::print_error(get_CL_error_string(err));
+            m_requeued.push_back({ data, count });
+            slot.abandoned = true;
+            slot.count = 0;
+            m_failed = true;
             return;
         }
 
-        cl::finish();
+        slot.iteration = iteration;
+        slot.source = data;
+        slot.stats = stat.stats;
+        slot.groups = groups;
+        slot.count = count;
+    }
 
-        // Agregate results on CPU
-        ppr::parallel::agregate_gpu_stat_vectorized(stat, out_sum, out_min, out_max, work_group_number);
+    bool Device_pipeline::wait(SSlot& slot)
+    {
+        tbb::tick_count t0 = tbb::tick_count::now();
+
+        // Blocking wait can not be interrupted, event status is polled instead
+        while (true)
+        {
+            // Status of invalid event reads as CL_COMPLETE (0), so the query error is checked first
+            cl_int err = 0;
+            const cl_int status = slot.download.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>(&err);
+
+            if (err == CL_SUCCESS && status == CL_COMPLETE)
+            {
+                return true;
+            }
+
+            // Negative status = command failed
+            if (err != CL_SUCCESS || status < 0 || m_telemetry.is_cancelled() || (tbb::tick_count::now() - t0).seconds() > PIPELINE_DEADLINE_SEC)
+            {
+                return false;
+            }
+
+            std::this_thread::sleep_for(std::chrono::microseconds(PIPELINE_POLL_MICROSECONDS));
+        }
+    }
+
+    void Device_pipeline::collect(SSlot& slot)
+    {
+        if (slot.count == 0 || slot.abandoned)
+        {
+            return;
+        }
+
+        if (!wait(slot))
+        {
+            // Values of the piece are processed on CPU, unless the run is cancelled
+            if (!m_telemetry.is_cancelled())
+            {
+                m_requeued.push_back({ slot.source, slot.count });
+            }
+
+            slot.abandoned = true;
+            m_failed = true;
+            return;
+        }
+
+        if (slot.iteration == EIteration::STAT)
+        {
+            merge_record(slot.record, m_stat);
+        }
+        else
+        {
+            if (m_histogram.size() != slot.histogram.size())
+            {
+                m_histogram.assign(slot.histogram.size(), 0);
+            }
+
+            for (size_t i = 0; i < slot.histogram.size(); i++)
+            {
+                m_histogram[i] += static_cast<int>(slot.histogram[i]);
+            }
+
+            m_variance += ppr::parallel::sum_vector_elements_vectorized(slot.var.data(), static_cast<int>(slot.groups));
+        }
+
+        if (m_trace_track >= 0)
+        {
+            trace_slot(slot);
+        }
+
+        m_timing.upload += event_seconds(slot.upload);
+        m_timing.kernel += event_seconds(slot.kernel);
+        if (slot.iteration == EIteration::STAT)
+        {
+            m_timing.kernel += event_seconds(slot.reduce);
+        }
+        m_timing.download += event_seconds(slot.download);
+
+        slot.count = 0;
+    }
+
+    void Device_pipeline::trace_slot(const SSlot& slot)
+    {
+        // Download has just completed, so its end is close to now
+        if (!m_trace_synced)
+        {
+            m_trace_offset = ppr::trace::now() - static_cast<long long>(slot.download.getProfilingInfo<CL_PROFILING_COMMAND_END>());
+            m_trace_synced = true;
+        }
 
-        stat.n = data_count;
+        auto record = [&](const char* name, const cl::Event& event, int queue) {
+            const long long start = static_cast<long long>(event.getProfilingInfo<CL_PROFILING_COMMAND_START>()) + m_trace_offset;
+            const long long end = static_cast<long long>(event.getProfilingInfo<CL_PROFILING_COMMAND_END>()) + m_trace_offset;
+            ppr::trace::record(name, "opencl", start, end, slot.count, m_trace_track + queue);
+        };
 
-        delete[] out_sum;
-        delete[] out_min;
-        delete[] out_max;
+        const bool is_stat = slot.iteration == EIteration::STAT;
+        record("upload", slot.upload, 0);
+        record(is_stat ? "stat kernel" : "hist kernel", slot.kernel, 1);
+        if (is_stat)
+        {
+            record("stat reduce", slot.reduce, 1);
+        }
+        record("download", slot.download, 2);
+    }
+
+    void Device_pipeline::submit(EIteration iteration, const double* data, unsigned long long count, SHistogram& hist, SDataStat& stat)
+    {
+        const SOpenCLConfig& opencl = iteration == EIteration::STAT ? m_stat_kernel : m_hist_kernel;
+        const unsigned long long capacity = PIPELINE_SLOT_VALUES - (PIPELINE_SLOT_VALUES % opencl.wg_size);
+
+        for (unsigned long long offset = 0; offset < count; )
+        {
+            const unsigned long long piece = std::min(capacity, count - offset);
+
+            // Slot is reused, when its previous piece is downloaded
+            SSlot& slot = m_slots[m_next];
+            m_next = (m_next + 1) % PIPELINE_SLOT_COUNT;
+            collect(slot);
+
+            // Device failed or missed deadline, the rest goes to CPU
+            if (m_failed)
+            {
+                if (!m_telemetry.is_cancelled())
+                {
+                    m_requeued.push_back({ data + offset, count - offset });
+                }
+                return;
+            }
+
+            enqueue(slot, iteration, data + offset, piece, hist, stat);
+            offset += piece;
+        }
+    }
+
+    std::vector<SPiece> Device_pipeline::take_requeued()
+    {
+        std::vector<SPiece> pieces;
+        pieces.swap(m_requeued);
+        return pieces;
     }
 
-    void set_kernel_program(SOpenCLConfig& opencl, const std::string& file, const char* kernel_name)
+    void Device_pipeline::drain(SDataStat& stat, std::vector<int>& histogram, double& variance)
+    {
+        for (auto& slot : m_slots)
+        {
+            collect(slot);
+        }
+
+        stat.merge(m_stat);
+        m_stat = SDataStat();
+
+        if (!histogram.empty() && histogram.size() == m_histogram.size())
+        {
+            std::transform(histogram.begin(), histogram.end(), m_histogram.begin(), histogram.begin(), std::plus<int>());
+            std::fill(m_histogram.begin(), m_histogram.end(), 0);
+        }
+
+        variance += m_variance;
+        m_variance = 0.0;
+    }
+
+    void set_kernel_program(SOpenCLConfig& opencl, const std::string& file, const char* kernel_name, const char* reduce_kernel_name)
     {
         // Update program
         create_kernel_program(opencl, file);
 
         // Update kernel
         create_kernel(opencl, kernel_name);
+
+        if (reduce_kernel_name == nullptr || opencl.wg_size == 0)
+        {
+            return;
+        }
+
+        cl_int err = 0;
+        opencl.reduce_kernel = cl::Kernel(opencl.program, reduce_kernel_name, &err);
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            opencl.wg_size = 0;
+            return;
+        }
+
+        const unsigned long long reduce_wg_size = opencl.reduce_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(opencl.device, &err);
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            opencl.wg_size = 0;
+            return;
+        }
+
+        // Both stages use the same work group size, which is a power of two and whose records fit in local memory
+        const unsigned long long limit = std::min({ opencl.wg_size, reduce_wg_size, opencl.local_mem_size / sizeof(SDevice_stat) });
+        unsigned long long wg_size = 1;
+        while (wg_size * 2 <= limit)
+        {
+            wg_size *= 2;
+        }
+        opencl.wg_size = limit == 0 ? 0 : wg_size;
     }
 
     void create_kernel(SOpenCLConfig& opencl, const char* kernel_name)
@@ -179,14 +635,119 @@ namespace ppr::gpu
             return;
         }
 
-        opencl.wg_size = opencl.kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(opencl.device);
+        const unsigned long long wg_size = opencl.kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(opencl.device, &err);
+        opencl.local_mem_size = opencl.device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            return;
+        }
+
+        opencl.wg_size = wg_size;
+    }
+
+    /// <summary>
+    /// 64-bit FNV-1a hash. Is stable between compilers, so that cache file names do not change
+    /// </summary>
+    /// <param name="text">- Hashed text</param>
+    /// <returns>Hash</returns>
+    static unsigned long long hash_fnv1a(const std::string& text)
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (const unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /// <summary>
+    /// Load program binary from cache. File starts with compile time of the binary
+    /// </summary>
+    /// <param name="path">- Cache file</param>
+    /// <param name="binary">- Program binary</param>
+    /// <param name="compile_time">- Compile time of the binary in seconds</param>
+    /// <returns>Is success</returns>
+    static bool load_program_binary(const std::string& path, std::vector<unsigned char>& binary, double& compile_time)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.good() || !file.read(reinterpret_cast<char*>(&compile_time), sizeof(double)))
+        {
+            return false;
+        }
+
+        binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !binary.empty();
+    }
+
+    /// <summary>
+    /// Save program binary to cache. Binary is written to a temporary file of this run and renamed, so that a concurrent
+    /// run never loads a half-written binary
+    /// </summary>
+    /// <param name="path">- Cache file</param>
+    /// <param name="binary">- Program binary</param>
+    /// <param name="compile_time">- Compile time of the binary in seconds</param>
+    static void save_program_binary(const std::string& path, const std::vector<unsigned char>& binary, double compile_time)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(KERNEL_CACHE_DIR, ec);
+
+        // Runs, which save the same binary at once, do not share the temporary file
+        std::stringstream temporary;
+        temporary << path << "." << std::hex << std::random_device{}() << ".tmp";
+
+        {
+            std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&compile_time), sizeof(double));
+            file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+
+            if (!file.good())
+            {
+                file.close();
+                std::filesystem::remove(temporary.str(), ec);
+                ppr::print_error("opencl program can not be saved to '" + path + "'");
+                return;
+            }
+        }
+
+        // Rename replaces the previous binary at once
+        std::filesystem::rename(temporary.str(), path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(temporary.str(), ec);
+            ppr::print_error("opencl program can not be saved to '" + path + "'");
+        }
+    }
+
+    void create_context(SOpenCLConfig& opencl)
+    {
+        cl_int err = 0;
+
+        opencl.context = cl::Context(opencl.device, nullptr, nullptr, nullptr, &err);
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            return;
+        }
+
+        opencl.queue = cl::CommandQueue(opencl.context, opencl.device, CL_QUEUE_PROFILING_ENABLE, &err);
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+        }
     }
 
     void create_kernel_program(SOpenCLConfig& opencl, const std::string& file)
     {
         cl_int err = 0;
+        tbb::tick_count t0 = tbb::tick_count::now();
         std::string file_path = __FILE__;
-        std::string kernel_path = file_path.substr(0, file_path.rfind("\\")) + "\\" + file;
+        std::string kernel_path = file_path.substr(0, file_path.find_last_of("\\/") + 1) + file;
+        std::replace(kernel_path.begin(), kernel_path.end(), '\\', '/');
 
         // Read kernel from file
         std::ifstream kernel_file(kernel_path);
@@ -196,13 +757,41 @@ namespace ppr::gpu
         cl::Program::Sources source(1, { t_src, src.length() + 1 });
         kernel_file.close();
 
-        // Create first program
-        opencl.context = cl::Context(opencl.device, nullptr, nullptr, nullptr, &err);
+        // Programs of one device share context and command queue
+        if (opencl.context() == nullptr)
+        {
+            create_context(opencl);
+        }
 
-        if (err != CL_SUCCESS)
+        // Binary is valid only for the same device, driver, build options and source
+        std::string device_name = opencl.device.getInfo<CL_DEVICE_NAME>();
+        std::string driver_version = opencl.device.getInfo<CL_DRIVER_VERSION>();
+        std::stringstream cache_path;
+        cache_path << KERNEL_CACHE_DIR << "/" << std::hex << hash_fnv1a(device_name + "\n" + driver_version + "\n" + KERNEL_BUILD_OPTIONS + "\n" + src) << ".bin";
+
+        std::vector<unsigned char> binary;
+        double compile_time = 0.0;
+        if (load_program_binary(cache_path.str(), binary, compile_time))
         {
-            ppr::print_error(get_CL_error_string(err));
-            return;
+            std::vector<cl::Device> devices(1, opencl.device);
+            cl::Program::Binaries binaries(1, binary);
+            std::vector<cl_int> binary_status;
+
+            opencl.program = cl::Program(opencl.context, devices, binaries, &binary_status, &err);
+            if (err == CL_SUCCESS)
+            {
+                err = opencl.program.build(KERNEL_BUILD_OPTIONS);
+            }
+
+            if (err == CL_SUCCESS)
+            {
+                opencl.build_time = (tbb::tick_count::now() - t0).seconds();
+                opencl.saved_time = std::max(0.0, compile_time - opencl.build_time);
+                return;
+            }
+
+            // Rejected binary is compiled again and replaced
+            err = CL_SUCCESS;
         }
 
         opencl.program = cl::Program(opencl.context, source, &err);
@@ -214,13 +803,30 @@ namespace ppr::gpu
         }
 
         // Build our program
-        err = opencl.program.build("-cl-std=CL2.0");
+        err = opencl.program.build(KERNEL_BUILD_OPTIONS);
 
         if (err == CL_BUILD_PROGRAM_FAILURE)
         {
             // Get the build log for the first device
             std::string log = opencl.program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(opencl.device);
             ppr::print_error(log);
+            return;
+        }
+
+        if (err != CL_SUCCESS)
+        {
+            ppr::print_error(get_CL_error_string(err));
+            return;
+        }
+
+        opencl.build_time = (tbb::tick_count::now() - t0).seconds();
+        opencl.saved_time = 0.0;
+
+        // Save binary for next runs
+        cl::Program::Binaries binaries = opencl.program.getInfo<CL_PROGRAM_BINARIES>(&err);
+        if (err == CL_SUCCESS && binaries.size() == 1 && !binaries[0].empty())
+        {
+            save_program_binary(cache_path.str(), binaries[0], opencl.build_time);
         }
     }
 
@@ -230,11 +836,15 @@ namespace ppr::gpu
         std::vector<cl::Platform> platforms;
         cl::Platform::get(&platforms);
 
+        // Devices selected by name can be of any type (e.g. PoCL CPU device), otherwise CPU OpenCL device
+        // would compete with CPU workers of the scheduler
+        const cl_device_type type = user_devices.size() == 0 ? CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_ACCELERATOR : CL_DEVICE_TYPE_ALL;
+
         for (const auto& platform : platforms)
         {
             // Get all devices of the current platform.
             std::vector<cl::Device> devices;
-            platform.getDevices(CL_DEVICE_TYPE_GPU, &devices);
+            platform.getDevices(type, &devices);
 
             for (const auto& device : devices)
             {
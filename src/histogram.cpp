@@ -1,22 +1,21 @@
 #include "include/histogram.h"
+#include "include/trace.h"
 
 namespace ppr::hist
 {
 	Histogram::Histogram(int size, double bin_size, double min, double max)
 		: Size(size), BinSize(bin_size), Min(min), Max(max), ScaleFactor(0.0)
 	{
-		ScaleFactor = (Size) / (Max - Min);
+		ScaleFactor = 1.0 / BinSize;
 	}
 
 	void Histogram::push(std::vector<int>& arr, double x)
 	{
-		double position = (x - Min) * ScaleFactor;
-		if (position == arr.size())
-		{
-			position--;
-		}
+		// Maximum belongs to the last bin
+		int position = std::min(static_cast<int>((x - Min) * ScaleFactor), static_cast<int>(Size) - 1);
+
 		// Update histogram
-		arr[static_cast<int>(position)]++;
+		arr[position]++;
 	}
 
 	void Histogram::compute_propability_density_histogram(std::vector<double>& bucket_density, std::vector<int>& bucket_frequency, double count)
@@ -30,50 +29,33 @@ namespace ppr::hist
 		}
 	}
 
-	double Histogram::compute_rss_histogram(std::vector<double>& bucket_density, char dist_val, SResult& res)
+	double Histogram::compute_rss_histogram(std::vector<double>& bucket_density, SDistribution_fit& fit)
 	{
-		ppr::rss::Distribution* dist;
-
-		// Create distribution instance
-		switch (dist_val)
-		{
-		case 'n':
-			dist = new ppr::rss::NormalDistribution(res.gauss_mean, res.gauss_stdev);
-			break;
-		case 'e':
-			dist = new ppr::rss::ExponentialDistribution(res.uniform_a, res.gauss_mean - res.uniform_a);
-			break;
-		case 'p':
-			dist = new ppr::rss::PoissonDistribution(res.poisson_lambda);
-			break;
-		case 'u':
-			dist = new ppr::rss::UniformDistribution(res.uniform_a, res.uniform_b - res.uniform_a);
-			break;
-		default:
-			return 0.0;
-		}
+		const ppr::dist::SDistribution_plugin& dist = ppr::dist::Registry::instance().get(fit.id);
+		const std::size_t count = static_cast<std::size_t>(Size);
+		double pdf[ppr::rss::RSS_BATCH_SIZE];
+		double rss = 0.0;
 
 		// Compute RSS
-		for (unsigned int i = 0; i < Size; i++)
+		for (std::size_t begin = 0; begin < count; begin += ppr::rss::RSS_BATCH_SIZE)
 		{
-			double d = (double)bucket_density[i];
-			dist->Push(d, (res.uniform_a + (i * BinSize)));
+			const std::size_t size = std::min(ppr::rss::RSS_BATCH_SIZE, count - begin);
+			dist.pdf_batch(fit, Min + (static_cast<double>(begin) * BinSize), BinSize, pdf, size);
+			rss += ppr::rss::squared_residuals(bucket_density.data() + begin, pdf, size);
 		}
 
-		double result = dist->Get_RSS();
-		delete dist;
-		return result;
+		return rss;
 	}
 
 	Histogram_parallel::Histogram_parallel(int size, double bin_size, double min, double max, const double* data, double mean)
 		: m_data(data), m_mean(mean), m_var(0.0)
 	{
-		m_bucketFrequency.resize(static_cast<size_t>(size) + 1);
+		m_bucketFrequency.resize(static_cast<size_t>(size));
 		m_histogram.binSize = bin_size;
 		m_histogram.min = min;
 		m_histogram.max = max;
-		m_histogram.binCount = size + 1;
-		m_histogram.scaleFactor = (m_histogram.binCount) / (m_histogram.max - m_histogram.min);
+		m_histogram.binCount = size;
+		m_histogram.scaleFactor = 1.0 / bin_size;
 	}
 
 	Histogram_parallel::Histogram_parallel(Histogram_parallel& x, tbb::split)
@@ -84,11 +66,13 @@ namespace ppr::hist
 		m_histogram.min = x.m_histogram.min;
 		m_histogram.max = x.m_histogram.max;
 		m_histogram.binCount = x.m_histogram.binCount;
-		m_histogram.scaleFactor = (x.m_histogram.binCount) / (x.m_histogram.max - x.m_histogram.min);
+		m_histogram.scaleFactor = x.m_histogram.scaleFactor;
 	}
 
 	void Histogram_parallel::operator()(const tbb::blocked_range<size_t>& r)
 	{
+		ppr::trace::Scope trace("hist range", "tbb", r.size());
+
 		// Parameters 
 		double t_var = m_var;
 		const double* t_data = m_data;
@@ -102,7 +86,7 @@ namespace ppr::hist
 			// Get new position
 			double x = (double)t_data[i];
 			int position = static_cast<int>((x - t_histogram.min) * t_histogram.scaleFactor);
-			position = position == t_bucketFrequency.size() ? position - 1 : position;
+			position = position >= t_histogram.binCount ? t_histogram.binCount - 1 : position;
 
 			// Update histogram
 			t_bucketFrequency[position]++;
@@ -0,0 +1,122 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+#include "smp_utils.h"
+
+#include <string>
+#include <vector>
+
+namespace ppr::bench
+{
+	/// <summary>
+	/// Benchmark results file. Is stored in working directory, unless other file is given
+	/// </summary>
+	const constexpr char* BENCH_FILE = "pprsolver.bench.json";
+	/// <summary>
+	/// Smallest histogram bin count for RSS benchmark
+	/// </summary>
+	const constexpr int RSS_BENCH_MIN_BINS = 1000;
+	/// <summary>
+	/// Biggest histogram bin count for RSS benchmark
+	/// </summary>
+	const constexpr int RSS_BENCH_MAX_BINS = 10000000;
+	/// <summary>
+	/// Number of values for statistics benchmark (64 MB, bigger than caches)
+	/// </summary>
+	const constexpr long long STAT_BENCH_COUNT = 1 << 23;
+	/// <summary>
+	/// How many times is every measurement repeated (the best time is reported)
+	/// </summary>
+	const constexpr int BENCH_REPEAT = 5;
+	/// <summary>
+	/// Number of memory levels in kernel sweep
+	/// </summary>
+	const constexpr int BENCH_LEVEL_COUNT = 4;
+	/// <summary>
+	/// Input sizes of kernel sweep in values: 32 KB (L1), 256 KB (L2), 8 MB (L3), 256 MB (DRAM)
+	/// </summary>
+	const constexpr long long BENCH_LEVEL_COUNTS[BENCH_LEVEL_COUNT] = { 1 << 12, 1 << 15, 1 << 20, 1 << 25 };
+	/// <summary>
+	/// Names of memory levels
+	/// </summary>
+	const constexpr char* BENCH_LEVEL_NAMES[BENCH_LEVEL_COUNT] = { "L1", "L2", "L3", "DRAM" };
+	/// <summary>
+	/// Smallest number of values processed by one measurement. Small inputs are scanned repeatedly
+	/// </summary>
+	const constexpr long long BENCH_MIN_VALUES = 1 << 22;
+	/// <summary>
+	/// Number of histogram bin counts in kernel sweep
+	/// </summary>
+	const constexpr int BENCH_BIN_COUNT = 3;
+	/// <summary>
+	/// Histogram bin counts of kernel sweep (counters in L1, L2 and L3 cache)
+	/// </summary>
+	const constexpr int BENCH_BINS[BENCH_BIN_COUNT] = { 32, 4096, 1 << 20 };
+	/// <summary>
+	/// Number of data shapes in kernel sweep
+	/// </summary>
+	const constexpr int BENCH_SHAPE_COUNT = 4;
+	/// <summary>
+	/// Names of data shapes
+	/// </summary>
+	const constexpr char* BENCH_SHAPE_NAMES[BENCH_SHAPE_COUNT] = { "uniform", "gauss", "exponential", "poisson" };
+	/// <summary>
+	/// Seed of generated data, so that runs are comparable
+	/// </summary>
+	const constexpr unsigned int BENCH_SEED = 42;
+	/// <summary>
+	/// Time of measuring time stamp counter frequency in seconds
+	/// </summary>
+	const constexpr double BENCH_TSC_SECONDS = 0.2;
+
+	/// <summary>
+	/// One measurement of benchmark
+	/// </summary>
+	struct SBench_record
+	{
+		std::string kernel;                     // Measured function
+		std::string variant;                    // Collected statistics, distribution etc. (may be empty)
+		std::string shape;                      // Data shape
+		std::string level;                      // Memory level of input (may be empty)
+		long long count = 0;                    // Processed values or bins
+		int bins = 0;                           // Histogram bins (0 = no histogram)
+		int threads = 1;                        // Thread count
+		double seconds = 0.0;                   // Best time of one pass
+		double bytes = 0.0;                     // Bytes read by one pass
+	};
+
+	/// <summary>
+	/// Starting function of benchmark mode ("pprsolver.exe bench [results.json | results.csv]")
+	/// </summary>
+	/// <param name="argc">Number of arguments</param>
+	/// <param name="argv">Arguments</param>
+	/// <returns>Exit status</returns>
+	int run(int argc, char** argv);
+
+	/// <summary>
+	/// Measure statistics and histogram kernels for all memory levels, data shapes, bin counts and thread counts
+	/// </summary>
+	/// <param name="records">- Measurements</param>
+	void run_kernel_benchmark(std::vector<SBench_record>& records);
+
+	/// <summary>
+	/// Measure RSS stage for histograms with 10^3 - 10^7 bins
+	/// </summary>
+	/// <param name="records">- Measurements</param>
+	void run_rss_benchmark(std::vector<SBench_record>& records);
+
+	/// <summary>
+	/// Measure cost of every optional sufficient statistic in statistics pass
+	/// </summary>
+	/// <param name="records">- Measurements</param>
+	void run_stat_benchmark(std::vector<SBench_record>& records);
+
+	/// <summary>
+	/// Save measurements. File with '.csv' extension gets CSV, other files JSON
+	/// </summary>
+	/// <param name="records">- Measurements</param>
+	/// <param name="tsc_frequency">- Time stamp counter frequency in Hz</param>
+	/// <param name="file">- Results file name</param>
+	/// <returns>Is success</returns>
+	bool save_records(const std::vector<SBench_record>& records, double tsc_frequency, const std::string& file);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+#include <string>
+#include <vector>
+
+namespace ppr::calibration
+{
+	/// <summary>
+	/// Tuning profile file. Is stored in working directory
+	/// </summary>
+	const constexpr char* PROFILE_FILE = "pprsolver.profile";
+	/// <summary>
+	/// Number of values for in-memory measurements (128 MB, bigger than caches)
+	/// </summary>
+	const constexpr long long CALIBRATION_COUNT = 1 << 24;
+	/// <summary>
+	/// How many times is every measurement repeated (the best time is used)
+	/// </summary>
+	const constexpr int CALIBRATION_REPEAT = 3;
+	/// <summary>
+	/// Maximum number of bytes read from sample file for I/O rate
+	/// </summary>
+	const constexpr unsigned long long CALIBRATION_IO_BYTES = 1ULL << 30;
+	/// <summary>
+	/// Backend, which processes less than this part of data, is not worth its scheduling and transfers
+	/// </summary>
+	const constexpr double AUTO_MIN_SHARE = 0.1;
+
+	/// <summary>
+	/// Measured OpenCL device
+	/// </summary>
+	struct SDevice_profile
+	{
+		std::string name;
+		double stat_throughput = 0.0;           // Values per second of statistics kernel including transfers
+	};
+
+	/// <summary>
+	/// Tuning profile of current machine
+	/// </summary>
+	struct SProfile
+	{
+		double memory_bandwidth_single = 0.0;   // GB/s of one thread (STREAM read)
+		double memory_bandwidth = 0.0;          // GB/s of all threads (STREAM read)
+		double memory_triad = 0.0;              // GB/s of all threads (STREAM triad)
+		int thread_count = 0;                   // Thread count with the best statistics throughput
+		double cpu_stat_throughput = 0.0;       // Values per second of statistics pass with 'thread_count' threads
+		double cpu_hist_throughput = 0.0;       // Values per second of histogram pass with 'thread_count' threads
+		double io_throughput = 0.0;             // Bytes per second of mapped file reading (0 = not measured)
+		double storage_bandwidth = 0.0;         // GB/s of sequential read without page cache (0 = not measured)
+		unsigned long long window_size = 0;     // Window with the best I/O rate in bytes (0 = not measured)
+		std::vector<SDevice_profile> devices;
+	};
+
+	/// <summary>
+	/// Starting function of calibration mode ("pprsolver.exe calibrate [sample file]")
+	/// </summary>
+	/// <param name="argc">Number of arguments</param>
+	/// <param name="argv">Arguments</param>
+	/// <returns>Exit status</returns>
+	int run(int argc, char** argv);
+
+	/// <summary>
+	/// Save tuning profile
+	/// </summary>
+	/// <param name="profile">- Tuning profile</param>
+	/// <param name="file">- Profile file name</param>
+	/// <returns>Is success</returns>
+	bool save_profile(const SProfile& profile, const char* file);
+
+	/// <summary>
+	/// Load tuning profile
+	/// </summary>
+	/// <param name="profile">- Tuning profile</param>
+	/// <param name="file">- Profile file name</param>
+	/// <returns>Is success</returns>
+	bool load_profile(SProfile& profile, const char* file);
+
+	/// <summary>
+	/// Resolve 'auto' mode. Choose backend, thread count, window size and CPU/GPU split from tuning profile and input size
+	/// </summary>
+	/// <param name="configuration">- Program configuration structure</param>
+	/// <returns>Is success</returns>
+	bool configure(SConfig& configuration);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+namespace ppr::checkpoint
+{
+	/// <summary>
+	/// Checkpoint file. Is stored in working directory
+	/// </summary>
+	const constexpr char* CHECKPOINT_FILE = "pprsolver.checkpoint";
+
+	/// <summary>
+	/// State of interrupted scan. Everything before 'offset' in pass 'iteration' is merged
+	/// </summary>
+	struct SCheckpoint
+	{
+		std::string input;                      // Input file name
+		unsigned long long file_size = 0;       // Input file size in bytes
+		unsigned int stats = 0;                 // Collected sufficient statistics
+		EIteration iteration = EIteration::STAT;
+		unsigned long long offset = 0;          // Processed bytes of current pass
+		SDataStat stat;                         // Merged statistics (complete in histogram pass)
+		std::vector<int> histogram;             // Merged frequency histogram (histogram pass)
+	};
+
+	/// <summary>
+	/// Writes checkpoint every N chunks merged in file order and loads it for resumed run.
+	/// File is replaced atomically, so that killed program leaves the previous checkpoint
+	/// </summary>
+	class Checkpointer
+	{
+	private:
+		SCheckpoint m_state;
+		unsigned long long m_interval;          // Chunks between two checkpoints (0 = disabled)
+		bool m_resume;                          // Run continues from checkpoint
+		unsigned long long m_chunks = 0;        // Chunks since last checkpoint
+		unsigned long long m_count = 0;         // Written checkpoints
+		double m_seconds = 0.0;                 // Time of writing checkpoints
+
+		/// <summary>
+		/// Write state to temporary file and rename it to checkpoint file
+		/// </summary>
+		/// <returns>Is success</returns>
+		bool save();
+
+	public:
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="configuration">- Program configuration structure</param>
+		/// <param name="file_size">- Input file size in bytes</param>
+		/// <param name="stats">- Collected sufficient statistics</param>
+		Checkpointer(SConfig& configuration, unsigned long long file_size, unsigned int stats);
+
+		/// <summary>
+		/// Load checkpoint of the same input file
+		/// </summary>
+		/// <param name="checkpoint">- Loaded state</param>
+		/// <returns>Is valid checkpoint found</returns>
+		bool load(SCheckpoint& checkpoint) const;
+
+		/// <summary>
+		/// Chunk was merged. Chunks must come in file order, so that merged state covers [0, offset)
+		/// </summary>
+		/// <param name="iteration">- Current pass</param>
+		/// <param name="offset">- End of merged chunk in bytes</param>
+		/// <param name="stat">- Merged statistics</param>
+		/// <param name="histogram">- Merged frequency histogram (histogram pass)</param>
+		void chunk_done(EIteration iteration, unsigned long long offset, const SDataStat& stat, const std::vector<int>& histogram);
+
+		/// <summary>
+		/// Scan is complete, checkpoint of this or resumed run is removed
+		/// </summary>
+		void finish();
+
+		/// <summary>
+		/// Is checkpointing enabled
+		/// </summary>
+		bool is_enabled() const { return m_interval > 0; }
+
+		/// <summary>
+		/// Get number of written checkpoints
+		/// </summary>
+		unsigned long long get_count() const { return m_count; }
+
+		/// <summary>
+		/// Get time of writing checkpoints in seconds
+		/// </summary>
+		double get_seconds() const { return m_seconds; }
+	};
+}
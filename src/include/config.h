@@ -22,6 +22,10 @@ namespace ppr
     /// </summary>
     const constexpr char* STAT_KERNEL_NAME = "Get_Data_Statistics";
     /// <summary>
+    /// Name of opencl kernel, which reduces partial statistics of work groups to one result
+    /// </summary>
+    const constexpr char* STAT_REDUCE_KERNEL_NAME = "Reduce_Data_Statistics";
+    /// <summary>
     /// File path for opencl histogram kernel
     /// </summary>
     const constexpr char* HIST_KERNEL = "cl\\histogram_kernel.cl";
@@ -30,6 +34,14 @@ namespace ppr
     /// </summary>
     const constexpr char* HIST_KERNEL_NAME = "Get_Data_Histogram";
     /// <summary>
+    /// Build options of opencl kernels
+    /// </summary>
+    const constexpr char* KERNEL_BUILD_OPTIONS = "-cl-std=CL2.0";
+    /// <summary>
+    /// Directory of compiled opencl program binaries. Is created in working directory
+    /// </summary>
+    const constexpr char* KERNEL_CACHE_DIR = "pprsolver_cache";
+    /// <summary>
     /// 2 Gigabytes in bytes aligned for allocation granularity on current system
     /// </summary>
     const constexpr long MAX_FILE_SIZE_MEM_2gb = 1999962112;
@@ -50,9 +62,34 @@ namespace ppr
     /// </summary>
     const constexpr int STAT_TIMEOUT_SEC = 5;
     /// <summary>
+    /// Chunks between two checkpoints of the scan (0 = no checkpoints)
+    /// </summary>
+    const constexpr unsigned long long CHECKPOINT_INTERVAL = 0;
+    /// <summary>
+    /// Smallest window of chunked reading in allocation granularity units. Adaptive chunk sizing starts here
+    /// </summary>
+    const constexpr unsigned long long WINDOW_MIN_SCALE = 16;
+    /// <summary>
+    /// Window of chunked reading grows while throughput of one chunk improves at least by this ratio
+    /// </summary>
+    const constexpr double WINDOW_GROWTH_TOLERANCE = 0.05;
+    /// <summary>
+    /// Most bins of integer histogram (1 MB per frequency copy, workers and device slots keep own copies). Wider integer
+    /// data use log2(n) + 2 bins
+    /// </summary>
+    const constexpr int MAX_INTEGER_BIN_COUNT = 1 << 18;
+    /// <summary>
     /// Default optimalization setting
     /// </summary>
     const constexpr bool USE_OPTIMIZATION = true;
+    /// <summary>
+    /// Default goodness-of-fit criterion, which decides result distribution
+    /// </summary>
+    const constexpr EGof_criterion GOF_CRITERION = EGof_criterion::AD;
+    /// <summary>
+    /// Names of goodness-of-fit criteria for '-g' argument (index = EGof_criterion)
+    /// </summary>
+    const constexpr char* GOF_CRITERION_NAMES[] = { "rss", "chi2", "ks", "ad", "kl" };
 
     /// <summary>
     /// Enum class for program mode definition
@@ -61,7 +98,8 @@ namespace ppr
         SMP = 0,
         ALL = 1,
         SEQ = 2,
-        CL = 3
+        CL = 3,
+        AUTO = 4
 
     };
 
@@ -77,11 +115,32 @@ namespace ppr
                 return "Sequential";
             case ERun_mode::CL: 
                 return "On selected devices";
+            case ERun_mode::AUTO:
+                return "Auto";
 
             default:      return "[Unknown OS_type]";
         }
     }
 
+    inline const char* print_criterion(EGof_criterion v)
+    {
+        switch (v)
+        {
+            case EGof_criterion::RSS:
+                return "RSS of density histogram";
+            case EGof_criterion::CHI2:
+                return "Chi-square";
+            case EGof_criterion::KS:
+                return "Kolmogorov-Smirnov";
+            case EGof_criterion::AD:
+                return "Anderson-Darling";
+            case EGof_criterion::KL:
+                return "Kullback-Leibler divergence";
+
+            default:      return "[Unknown criterion]";
+        }
+    }
+
     /// <summary>
     /// Enum for exit codes definition
     /// </summary>
@@ -98,7 +157,8 @@ namespace ppr
         WD_HIST_BIN_COUNT = 9,
         WD_HIST_SIZE = 10,
         WD_HIST_ALL_ZERO = 11,
-        WD_DHIST_ALL_ZERO = 12
+        WD_DHIST_ALL_ZERO = 12,
+        WD_STALL = 13
     };
 
     /// <summary>
@@ -108,11 +168,22 @@ namespace ppr
         const char* input_fn{};                         // Input file name
         ERun_mode mode{};                               // Program running mode
         std::vector<std::string> cl_devices_name{};     // OpenCl Devices from user input
-        int thread_count = 0;                           // System max thread count
+        std::vector<std::string> distributions{};       // Candidate distributions from user input (empty = all without logarithmic sums)
+        int thread_count = 0;                           // Arena size (0 = logical processors * 'thread_per_core')
         long long watchdog_interval = WATCHDOG_INTERVAL_SEC;
         long long stat_timeout = STAT_TIMEOUT_SEC;
         bool use_optimalization = USE_OPTIMIZATION;
+        EGof_criterion criterion = GOF_CRITERION;       // Decision rule
         int thread_per_core = THREAD_PER_CORE;
+        unsigned long long window_size = 0;             // First window of chunked reading in bytes (0 = WINDOW_MIN_SCALE)
+        bool fixed_window = false;                      // Window from '-m' does not grow
+        double cpu_share = 0.0;                         // CPU part of data in 'all' mode (0 = not calibrated)
+        unsigned long long checkpoint_interval = CHECKPOINT_INTERVAL;  // Chunks between two checkpoints (0 = no checkpoints)
+        bool resume = false;                            // Continue from checkpoint of previous run
+        int numa_node = -1;                             // NUMA node of SMP arena (-1 = not placed)
+        bool perf_counters = false;                     // Hardware counters of SMP pipeline stages
+        const char* trace_fn = nullptr;                 // Chrome trace event file ('--trace', nullptr = not traced)
+        bool roofline = false;                          // Compare pass rates with memory and storage bandwidth
     };
 
     /// <summary>
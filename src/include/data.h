@@ -1,5 +1,6 @@
 #pragma once
 #include<vector>
+#include <string>
 
 /// <summary>
 /// Enum with iterations
@@ -10,15 +11,21 @@ enum class EIteration {
 };
 
 /// <summary>
-/// Enum with all existing distributions
+/// Goodness-of-fit criterion, which decides result distribution
 /// </summary>
-enum class EDistribution {
-    GAUSS = 0,
-    EXP = 1,
-    POISSON = 2,
-    UNIFORM = 3
+enum class EGof_criterion {
+    RSS = 0,            // Residual sum of squares of density histogram
+    CHI2 = 1,           // Pearson chi-square statistic with bin probabilities from CDF
+    KS = 2,             // Binned Kolmogorov-Smirnov statistic
+    AD = 3,             // Binned Anderson-Darling statistic
+    KL = 4              // Kullback-Leibler divergence of histogram from fitted distribution
 };
 
+/// <summary>
+/// Maximum number of parameters of one distribution
+/// </summary>
+const constexpr int MAX_DIST_PARAMS = 3;
+
 /// <summary>
 /// HIstogram configuration structure
 /// </summary>
@@ -58,8 +65,142 @@ struct SDataStat
     double min = 0.0;
     double mean = 0.0;
     double variance = 0.0;
+    double sumLog = 0.0;            // Sum of log(x)
+    double sumLog2 = 0.0;           // Sum of log(x)^2
+    double sumXLog = 0.0;           // Sum of x * log(x)
+    double sumLog1m = 0.0;          // Sum of log(1 - x)
+    unsigned int stats = 0;         // Collected sufficient statistics (ppr::dist::ESufficient_stat mask)
     bool isNegative = 0;
+    bool isInteger = 0;
     unsigned long long n = 0;
+
+    /// <summary>
+    /// Add logarithmic sums of other data block
+    /// </summary>
+    /// <param name="other">- Statistics of other data block</param>
+    void add_log_sums(const SDataStat& other)
+    {
+        sumLog += other.sumLog;
+        sumLog2 += other.sumLog2;
+        sumXLog += other.sumXLog;
+        sumLog1m += other.sumLog1m;
+    }
+
+    /// <summary>
+    /// Merge count, sum, extremes, negative/integer flags and logarithmic sums of other data block
+    /// </summary>
+    /// <param name="other">- Statistics of other data block</param>
+    void merge(const SDataStat& other)
+    {
+        if (other.n == 0)
+        {
+            return;
+        }
+
+        min = n == 0 ? other.min : (other.min < min ? other.min : min);
+        max = n == 0 ? other.max : (other.max > max ? other.max : max);
+        isNegative = n == 0 ? other.isNegative : (isNegative || other.isNegative);
+        isInteger = n == 0 ? other.isInteger : (isInteger && other.isInteger);
+        n += other.n;
+        sum += other.sum;
+        add_log_sums(other);
+    }
+};
+
+/// <summary>
+/// One distribution fitted to data
+/// </summary>
+struct SDistribution_fit
+{
+    int id = -1;                            // Distribution index in registry
+    double params[MAX_DIST_PARAMS]{};       // Estimated parameters
+    double location = 0.0;                  // PDF is evaluated in (x - location) / scale. Both zero = raw x
+    double scale = 0.0;
+    double rss = 0.0;
+    double chi2 = 0.0;
+    double ks = 0.0;
+    double ad = 0.0;
+    double kl = 0.0;
+    bool valid = false;                     // Distribution can describe data
+
+    /// <summary>
+    /// Value of goodness-of-fit criterion (smaller is better)
+    /// </summary>
+    /// <param name="criterion">- Criterion</param>
+    /// <returns>Criterion value</returns>
+    double score(EGof_criterion criterion) const
+    {
+        switch (criterion)
+        {
+            case EGof_criterion::CHI2:
+                return chi2;
+            case EGof_criterion::KS:
+                return ks;
+            case EGof_criterion::AD:
+                return ad;
+            case EGof_criterion::KL:
+                return kl;
+            default:
+                return rss;
+        }
+    }
+};
+
+/// <summary>
+/// One processed chunk of chunked reading
+/// </summary>
+struct SChunk_trace
+{
+    EIteration iteration = EIteration::STAT;    // Pass, which processed the chunk
+    unsigned long long bytes = 0;
+    double seconds = 0.0;
+};
+
+/// <summary>
+/// Work done by one backend of heterogeneous scheduler
+/// </summary>
+struct SBackend_trace
+{
+    std::string name;                           // "CPU" or OpenCL device name
+    unsigned long long count = 0;               // Processed values
+    double seconds = 0.0;                       // Busy time
+    double build_seconds = 0.0;                 // OpenCL program compile or binary load
+    double saved_seconds = 0.0;                 // Compile time saved by program binary cache
+    double upload_seconds = 0.0;                // Profiled OpenCL commands
+    double kernel_seconds = 0.0;
+    double download_seconds = 0.0;
+    std::string error;                          // Why device took no more work (empty = device worked until the end)
+};
+
+/// <summary>
+/// Number of performance counters in SStage_counters
+/// </summary>
+const constexpr int PERF_COUNTER_COUNT = 7;
+
+/// <summary>
+/// Names of performance counters (index in SStage_counters::values)
+/// </summary>
+const constexpr char* PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "major_faults", "minor_faults", "context_switches" };
+
+/// <summary>
+/// Performance counters of one pipeline stage summed across worker threads
+/// </summary>
+struct SStage_counters
+{
+    std::string stage;                          // Stage name
+    long long values[PERF_COUNTER_COUNT]{};     // Counter values (-1 = counter is not available)
+};
+
+/// <summary>
+/// Memory high-water marks of one program stage in bytes (-1 = not available on this system)
+/// </summary>
+struct SStage_memory
+{
+    std::string stage;                          // Stage name
+    long long resident = -1;                    // Resident set
+    long long file = -1;                        // Resident pages of mapped files (input views)
+    long long anonymous = -1;                   // Resident private memory (histograms, buffers)
+    long long mapped = -1;                      // Mapped address space
 };
 
 /// <summary>
@@ -67,23 +208,22 @@ struct SDataStat
 /// </summary>
 struct SResult
 {
-    EDistribution dist{};     // Result distribution
-    double gauss_mean = 0.0;
-    double gauss_variance = 0.0;
-    double gauss_stdev = 0.0;
-    double exp_lambda = 0.0;
-    double poisson_lambda = 0;
-    double uniform_a = 0.0;
-    double uniform_b = 0.0;
-    double gauss_rss = 0.0;
-    double exp_rss = 0.0;
-    double poisson_rss = 0.0;
-    double uniform_rss = 0.0;
+    std::vector<SDistribution_fit> fits{};  // All fitted distributions
+    int best = -1;                          // Index of result distribution in fits
     double total_stat_time = 0.0;
     double total_hist_time = 0.0;
     double total_rss_time = 0.0;
+    double total_fit_time = 0.0;            // Parameter estimation and goodness-of-fit
+    double total_merge_time = 0.0;          // Serial merges of chunk results (SMP)
     double total_time = 0.0;
+    std::vector<SChunk_trace> chunk_trace{};  // Chunk sizes chosen by adaptive chunk sizing
+    std::vector<SBackend_trace> backend_trace{};  // Work of CPU and OpenCL devices
+    std::vector<SStage_counters> stage_counters{};  // Performance counters of pipeline stages ('--perf')
+    std::vector<SStage_memory> stage_memory{};  // Memory high-water marks of program stages
     int status = 0;
+    unsigned long long processed = 0;       // Values scanned in both passes (less than 2 * n, when the run was cancelled)
+    unsigned long long checkpoint_count = 0;    // Written checkpoints
+    double checkpoint_time = 0.0;               // Time of writing checkpoints
     bool isNegative = 0;
     bool isInteger = 0.0;
 
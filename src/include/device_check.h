@@ -0,0 +1,82 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+#include "gpu_utils.h"
+
+#include <string>
+#include <vector>
+
+namespace ppr::check
+{
+	/// <summary>
+	/// Number of values of every checked data set (8 MB, many work groups and several passes of grid stride)
+	/// </summary>
+	const constexpr long long CHECK_COUNT = 1 << 20;
+	/// <summary>
+	/// Relative tolerance of device sums against CPU reducers
+	/// </summary>
+	const constexpr double CHECK_TOLERANCE = 1e-9;
+	/// <summary>
+	/// Means of Poisson CDF check (big shapes of incomplete gamma function)
+	/// </summary>
+	const constexpr double CHECK_POISSON_MEANS[] = { 1e4, 1e5, 1e6 };
+	/// <summary>
+	/// Absolute tolerance of Poisson CDF against sum of PMF
+	/// </summary>
+	const constexpr double CHECK_CDF_TOLERANCE = 1e-8;
+
+	/// <summary>
+	/// Data set of device check
+	/// </summary>
+	struct SCheck_data
+	{
+		const char* name;
+		std::vector<double> values;
+		unsigned int stats = 0;                 // Collected sufficient statistics (logarithms only for data in (0, 1))
+	};
+
+	/// <summary>
+	/// Data sets with different flags and extremes: values in (0, 1), all negative values, integers, halves,
+	/// whose sum is an integer, and signed zeros (-0.0 is not negative)
+	/// </summary>
+	/// <param name="count">- Values of every data set</param>
+	/// <returns>Data sets</returns>
+	std::vector<SCheck_data> create_data(long long count);
+
+	/// <summary>
+	/// Compare statistics of device (two-stage kernel and merged record) with CPU reducer (Running_stat_parallel)
+	/// </summary>
+	/// <param name="opencl">- Opencl configuration structure with statistics kernels</param>
+	/// <param name="data">- Data set</param>
+	/// <param name="difference">- Names of different values</param>
+	/// <returns>Device gives the same count, extremes, flags and sums in tolerance</returns>
+	bool check_statistics(ppr::gpu::SOpenCLConfig& opencl, SCheck_data& data, std::string& difference);
+
+	/// <summary>
+	/// Compare frequency histogram and variance of device kernel with CPU reducer (Histogram_parallel) bin by bin
+	/// </summary>
+	/// <param name="opencl">- Opencl configuration structure with histogram kernel</param>
+	/// <param name="data">- Data set</param>
+	/// <param name="bin_count">- Bin count (0 = bins of solvers), bins over local memory use global atomics</param>
+	/// <param name="difference">- Names of different values</param>
+	/// <returns>Device counts the same histogram and variance in tolerance</returns>
+	bool check_histogram(ppr::gpu::SOpenCLConfig& opencl, SCheck_data& data, int bin_count, std::string& difference);
+
+	/// <summary>
+	/// Compare Poisson CDF (incomplete gamma function and batches seeded from it) with sum of PMF in edges up to 6 sigma
+	/// from mean. Needs no device
+	/// </summary>
+	/// <param name="mu">- Poisson mean</param>
+	/// <param name="difference">- Largest difference and its edge</param>
+	/// <returns>CDF is the same in tolerance</returns>
+	bool check_poisson_cdf(double mu, std::string& difference);
+
+	/// <summary>
+	/// Starting function of check mode ("pprsolver.exe check [device names]"). Every OpenCL device (or every named one,
+	/// e.g. PoCL) runs its kernels on the check data sets, which are compared with CPU results
+	/// </summary>
+	/// <param name="argc">Number of arguments</param>
+	/// <param name="argv">Arguments</param>
+	/// <returns>Exit status (STAT = some device differs from CPU)</returns>
+	int run(int argc, char** argv);
+}
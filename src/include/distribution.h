@@ -0,0 +1,152 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "data.h"
+
+namespace ppr::dist
+{
+	/// <summary>
+	/// Sufficient statistics, which distribution needs for parameter estimation (bit mask).
+	/// Count, sum, minimum and maximum are collected always.
+	/// </summary>
+	enum ESufficient_stat : unsigned int
+	{
+		STAT_BASE = 0,
+		STAT_VARIANCE = 1 << 0,         // Sum of (x - mean)^2. Collected together with frequency histogram
+		STAT_SUM_LOG = 1 << 1,          // Sum of log(x)
+		STAT_SUM_LOG2 = 1 << 2,         // Sum of log(x)^2
+		STAT_SUM_X_LOG = 1 << 3,        // Sum of x * log(x)
+		STAT_SUM_LOG1M = 1 << 4,        // Sum of log(1 - x)
+		STAT_LOG_SUMS = STAT_SUM_LOG | STAT_SUM_LOG2 | STAT_SUM_X_LOG | STAT_SUM_LOG1M
+	};
+
+	/// <summary>
+	/// Number of sufficient statistics in ESufficient_stat
+	/// </summary>
+	const constexpr int SUFFICIENT_STAT_COUNT = 5;
+
+	/// <summary>
+	/// Names of sufficient statistics (index = bit position in ESufficient_stat)
+	/// </summary>
+	const constexpr char* SUFFICIENT_STAT_NAMES[SUFFICIENT_STAT_COUNT] = { "sum (x-mean)^2", "sum log(x)", "sum log(x)^2", "sum x*log(x)", "sum log(1-x)" };
+
+	/// <summary>
+	/// Maximum number of Newton iterations of shape parameter estimators
+	/// </summary>
+	const constexpr int MLE_MAX_ITERATIONS = 100;
+
+	/// <summary>
+	/// Relative tolerance of Newton iterations
+	/// </summary>
+	const constexpr double MLE_TOLERANCE = 1e-12;
+
+	/// <summary>
+	/// Distribution plug-in. Adding new distribution means creating one plug-in and registering it
+	/// </summary>
+	struct SDistribution_plugin
+	{
+		const char* name;                           // Short name for '-d' argument
+		const char* label;                          // Name in RSS results
+		const char* title;                          // Name in final result
+		const char* param_names[MAX_DIST_PARAMS];   // Names of estimated parameters
+		int param_count;                            // Number of estimated parameters
+		unsigned int required_stats;                // ESufficient_stat mask
+
+		/// <summary>
+		/// Estimate parameters from collected statistics
+		/// </summary>
+		void (*fit)(const SDataStat& stat, SDistribution_fit& fit);
+
+		/// <summary>
+		/// Evaluate PDF/PMF for bins [first_bin + i * bin_size]
+		/// </summary>
+		void (*pdf_batch)(const SDistribution_fit& fit, double first_bin, double bin_size, double* out, std::size_t count);
+
+		/// <summary>
+		/// Evaluate CDF in bin edges [first_edge + i * bin_size]. Discrete distributions return P(X < edge)
+		/// </summary>
+		void (*cdf_batch)(const SDistribution_fit& fit, double first_edge, double bin_size, double* out, std::size_t count);
+	};
+
+	/// <summary>
+	/// Registry of all known distributions
+	/// </summary>
+	class Registry
+	{
+	private:
+		std::vector<SDistribution_plugin> m_plugins;
+
+		/// <summary>
+		/// Registry constructor registers built-in distributions
+		/// </summary>
+		Registry();
+
+	public:
+		/// <summary>
+		/// Get registry instance
+		/// </summary>
+		/// <returns>Registry reference</returns>
+		static Registry& instance();
+
+		/// <summary>
+		/// Register new distribution
+		/// </summary>
+		/// <param name="plugin">- Distribution plug-in</param>
+		/// <returns>Distribution id</returns>
+		int add(const SDistribution_plugin& plugin);
+
+		/// <summary>
+		/// Get distribution plug-in
+		/// </summary>
+		/// <param name="id">- Distribution id</param>
+		/// <returns>Plug-in reference</returns>
+		const SDistribution_plugin& get(int id) const;
+
+		/// <summary>
+		/// Number of registered distributions
+		/// </summary>
+		/// <returns>Distribution count</returns>
+		int size() const;
+
+		/// <summary>
+		/// Find distribution by short name
+		/// </summary>
+		/// <param name="name">- Short name</param>
+		/// <returns>Distribution id or -1</returns>
+		int find(const std::string& name) const;
+
+		/// <summary>
+		/// Get ids of selected distributions
+		/// </summary>
+		/// <param name="names">- Short names (empty = all without logarithmic sums, "all" = all registered)</param>
+		/// <returns>Distribution ids</returns>
+		std::vector<int> select(const std::vector<std::string>& names) const;
+
+		/// <summary>
+		/// Union of sufficient statistics needed by selected distributions
+		/// </summary>
+		/// <param name="ids">- Distribution ids</param>
+		/// <returns>ESufficient_stat mask</returns>
+		unsigned int required_stats(const std::vector<int>& ids) const;
+	};
+
+	/// <summary>
+	/// Digamma function psi(x) = d/dx log(Gamma(x)) for x > 0
+	/// </summary>
+	/// <param name="x">- Positive argument</param>
+	/// <returns>psi(x)</returns>
+	double digamma(double x);
+
+	/// <summary>
+	/// Trigamma function psi'(x) for x > 0
+	/// </summary>
+	/// <param name="x">- Positive argument</param>
+	/// <returns>psi'(x)</returns>
+	double trigamma(double x);
+
+	/// <summary>
+	/// Register built-in distributions
+	/// </summary>
+	/// <param name="registry">- Registry reference</param>
+	void register_builtin_distributions(Registry& registry);
+}
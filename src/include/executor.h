@@ -2,6 +2,8 @@
 #include "statistics.cpp"
 #include "histogram.h"
 #include "gpu_utils.h"
+#include "distribution.h"
+#include "trace.h"
 #include <numeric>
 #include <vector>
 #include <algorithm>
@@ -15,6 +17,7 @@
 #include <tbb/parallel_reduce.h>
 #include <tbb/task_arena.h>
 #include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 
 namespace ppr::executor
@@ -27,13 +30,22 @@ namespace ppr::executor
 	/// <param name="class_to_execute">- Class to execute</param>
 	/// <param name="begin">- Begin interval</param>
 	/// <param name="end">- End interval</param>
+	/// <param name="context">- Cancellation context (nullptr = context of calling task)</param>
 	/// <returns>Processed time</returns>
 	template <typename T>
-	double run_with_tbb(tbb::task_arena& arena, T& class_to_execute, unsigned long long begin, unsigned long long end)
+	double run_with_tbb(tbb::task_arena& arena, T& class_to_execute, unsigned long long begin, unsigned long long end, tbb::task_group_context* context = nullptr)
 	{
+		ppr::trace::Scope trace("parallel_reduce", "tbb", end - begin);
 		tbb::tick_count t0 = tbb::tick_count::now();
 		arena.execute([&]() {
-			tbb::parallel_reduce(tbb::blocked_range<std::size_t>(begin, end), class_to_execute);
+			if (context)
+			{
+				tbb::parallel_reduce(tbb::blocked_range<std::size_t>(begin, end), class_to_execute, *context);
+			}
+			else
+			{
+				tbb::parallel_reduce(tbb::blocked_range<std::size_t>(begin, end), class_to_execute);
+			}
 			});
 		tbb::tick_count t1 = tbb::tick_count::now();
 
@@ -49,10 +61,51 @@ namespace ppr::executor
 	double sum_vector_tbb(tbb::task_arena& arena, std::vector<double> data);
 
 	/// <summary>
-	/// Analyze RSS results
+	/// Sufficient statistics needed by distributions selected in configuration
 	/// </summary>
+	/// <param name="configuration">- Program configuration structure</param>
+	/// <returns>ppr::dist::ESufficient_stat mask</returns>
+	unsigned int required_statistics(SConfig& configuration);
+
+	/// <summary>
+	/// Estimate parameters of all selected distributions in parallel
+	/// </summary>
+	/// <param name="configuration">- Program configuration structure</param>
+	/// <param name="stat">- Statistics structure</param>
+	/// <param name="res">- Results</param>
+	void fit_distributions(SConfig& configuration, SDataStat& stat, SResult& res);
+
+	/// <summary>
+	/// Compute goodness-of-fit criteria of all fitted distributions from frequency histogram in parallel.
+	/// Bin probabilities are differences of CDF in bin edges, tails outside of histogram belong to the first and last bin
+	/// </summary>
+	/// <param name="hist">- Histogram configuration structure</param>
+	/// <param name="bucket_frequency">- Frequency histogram reference</param>
+	/// <param name="res">- Results</param>
+	void compute_goodness_of_fit(SHistogram& hist, std::vector<int>& bucket_frequency, SResult& res);
+
+	/// <summary>
+	/// Compute goodness-of-fit criteria of one fitted distribution from frequency histogram
+	/// </summary>
+	/// <param name="hist">- Histogram configuration structure</param>
+	/// <param name="bucket_frequency">- Frequency histogram reference</param>
+	/// <param name="fit">- Fitted distribution</param>
+	void compute_goodness_of_fit(SHistogram& hist, std::vector<int>& bucket_frequency, SDistribution_fit& fit);
+
+	/// <summary>
+	/// Find histogram limits. Constant data use one bin, non-negative integer data integer bins (at most MAX_INTEGER_BIN_COUNT),
+	/// the rest log2(n) + 2 bins over <min, max>
+	/// </summary>
+	/// <param name="hist">- Histogram configuration structure</param>
+	/// <param name="stat">- Statistics structure</param>
+	void compute_histogram_limits(SHistogram& hist, SDataStat& stat);
+
+	/// <summary>
+	/// Analyze results and choose distribution with the smallest value of selected criterion
+	/// </summary>
+	/// <param name="configuration">- Program configuration structure</param>
 	/// <param name="res">Results</param>
-	void analyze_results(SResult& res);
+	void analyze_results(SConfig& configuration, SResult& res);
 	
 	/// <summary>
 	/// Transform frequency histogram to propability density histogram
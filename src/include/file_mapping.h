@@ -3,11 +3,15 @@
 #define FILEMAP_H
 
 #include "smp_utils.h"
+#include "work_scheduler.h"
+#include "checkpoint.h"
 #include "config.h"
 #include "data.h"
 
 #include<future>
+#include <mutex>
 #include <tbb/task_arena.h>
+#include <tbb/tick_count.h>
 
 #ifndef NOMINMAX
 # define NOMINMAX
@@ -16,6 +20,71 @@
 
 namespace ppr
 {
+    /// <summary>
+    /// Feedback controller of window size for chunked reading. Window starts small and doubles while throughput
+    /// of processed chunks improves, then stays at the best size. Chunk slower than statistics timeout halves the window.
+    /// Window never exceeds memory budget
+    /// </summary>
+    class Window_controller
+    {
+        private:
+            std::mutex m_mutex;
+            /// <summary>
+            /// System allocation granularity
+            /// </summary>
+            unsigned long long m_granularity;
+            /// <summary>
+            /// Largest window in allocation granularity units (memory budget)
+            /// </summary>
+            unsigned long long m_max_scale;
+            /// <summary>
+            /// Current window in allocation granularity units
+            /// </summary>
+            unsigned long long m_scale;
+            /// <summary>
+            /// Window with the best throughput
+            /// </summary>
+            unsigned long long m_best_scale;
+            double m_best_throughput;
+            /// <summary>
+            /// Longest allowed processing time of one chunk
+            /// </summary>
+            double m_timeout;
+            bool m_growing;
+            std::vector<SChunk_trace> m_trace;
+
+        public:
+            /// <summary>
+            /// Constructor
+            /// </summary>
+            /// <param name="granularity">- System allocation granularity</param>
+            /// <param name="max_window">- Memory budget for one window in bytes</param>
+            /// <param name="timeout">- Statistics timeout of one chunk in seconds</param>
+            /// <param name="first_window">- First window in bytes, e.g. from tuning profile (0 = WINDOW_MIN_SCALE)</param>
+            /// <param name="fixed">- Window does not grow, it is only halved by timeout</param>
+            Window_controller(unsigned long long granularity, unsigned long long max_window, double timeout, unsigned long long first_window = 0, bool fixed = false);
+
+            /// <summary>
+            /// Get size of next window
+            /// </summary>
+            /// <returns>Window size in bytes (multiple of allocation granularity)</returns>
+            unsigned long long get_window_size();
+
+            /// <summary>
+            /// Report processed chunk and adapt window size
+            /// </summary>
+            /// <param name="iteration">- Pass, which processed the chunk</param>
+            /// <param name="bytes">- Chunk size in bytes</param>
+            /// <param name="seconds">- Processing time of the chunk</param>
+            void report(EIteration iteration, unsigned long long bytes, double seconds);
+
+            /// <summary>
+            /// Get sizes and times of all processed chunks
+            /// </summary>
+            /// <returns>Chunk trace</returns>
+            std::vector<SChunk_trace> get_trace();
+    };
+
     class File_mapping
     {
         private:
@@ -112,59 +181,57 @@ namespace ppr
             const long get_count() const;
 
             /// <summary>
-            /// Calls 'process_chunk' function with each chunk of the file.
-            /// Mapping data bloks (chunks) and make computings using function pointer in a input parametr for each chunk of the file.
-            /// (Not optimized solution)
-            /// https://stackoverflow.com/questions/9889557/mapping-large-files-using-mapviewoffile
+            /// Get memory budget for mapped windows in bytes (multiple of allocation granularity)
             /// </summary>
-            /// <param name="hist">- histogram configuration structure</param>
-            /// <param name="config">- program configuration structure</param>
-            /// <param name="opencl">- opencl configuration structure</param>
-            /// <param name="stat">- statistics structure</param>
-            /// <param name="arena">- arena object. using for TBB algorithm</param>
-            /// <param name="histogram">- vector reference for frequency histogram</param>
-            /// <param name="process_chunk">- method is using for process one data chunk</param>
-            void read_in_chunks_tbb(
-                SHistogram& hist,
-                SConfig& config,
-                ppr::gpu::SOpenCLConfig& opencl,
-                SDataStat& stat,
-                tbb::task_arena& arena,
-                std::vector<int>& histogram,
-                void (*process_chunk) (SHistogram& hist, SConfig&, ppr::gpu::SOpenCLConfig&, SDataStat&, tbb::task_arena&, unsigned long long, double*, std::vector<int>&));
+            /// <returns>Window size in bytes</returns>
+            const unsigned long long get_window_size() const;
 
+            /// <summary>
+            /// Open file and create read-only file mapping. Views are created by 'map_window'
+            /// </summary>
+            /// <returns>Is success</returns>
+            bool open_mapping();
 
             /// <summary>
-            /// Mapping data as one block and [collecting data statistics / creating frequency histogram] of these data using multiply threads and GPU
+            /// Map one window of opened file mapping
             /// </summary>
-            /// <param name="hist">- histogram configuration structure</param>
-            /// <param name="config">- program configuration structure</param>
-            /// <param name="stat">- statistics structure</param>
-            /// <param name="iteration">- current iteration affect, what will threads compute</param>
-            /// <param name="histogram">- vector reference for frequency histogram</param>
-            void read_in_chunks_gpu(
-                SHistogram& hist,
-                SConfig& config,
-                SDataStat& stat, 
-                EIteration iteration,
-                std::vector<int>& histogram);
+            /// <param name="offset">- Offset in bytes (multiple of allocation granularity)</param>
+            /// <param name="bytes">- Window size in bytes (0 = until end of file)</param>
+            /// <returns>64-bit double array pointer or nullptr</returns>
+            double* map_window(unsigned long long offset, unsigned long long bytes);
+
+            /// <summary>
+            /// Unmap window created by 'map_window'
+            /// </summary>
+            /// <param name="view">- Window pointer</param>
+            void unmap_window(double* view);
 
             /// <summary>
-            /// Mapping data as one block and [collecting data statistics / creating frequency histogram] of these data using multiply threads
+            /// Close file mapping opened by 'open_mapping'
+            /// </summary>
+            void close_mapping();
+
+            /// <summary>
+            /// Mapping data in windows and [collecting data statistics / creating frequency histogram] of these data using multiply threads and GPU.
+            /// Every window is shared by CPU and OpenCL devices through work scheduler
             /// </summary>
             /// <param name="hist">- histogram configuration structure</param>
-            /// <param name="config">- program configuration structure</param>
-            /// <param name="opencl">- opencl configuration structure</param>
             /// <param name="stat">- statistics structure</param>
             /// <param name="iteration">- current iteration affect, what will threads compute</param>
             /// <param name="histogram">- vector reference for frequency histogram</param>
-            void read_in_one_chunk_cpu(
+            /// <param name="controller">- window size controller</param>
+            /// <param name="scheduler">- work scheduler of CPU and OpenCL devices</param>
+            /// <param name="checkpointer">- writes checkpoint after merged windows</param>
+            /// <param name="start">- offset in bytes, where resumed pass starts</param>
+            void read_in_chunks_gpu(
                 SHistogram& hist,
-                SConfig& config,
-                ppr::gpu::SOpenCLConfig& opencl,
-                SDataStat& stat,
+                SDataStat& stat, 
                 EIteration iteration,
-                std::vector<int>& histogram);
+                std::vector<int>& histogram,
+                Window_controller& controller,
+                ppr::gpu::Work_scheduler& scheduler,
+                ppr::checkpoint::Checkpointer& checkpointer,
+                unsigned long long start = 0);
 
     };
 }
@@ -3,12 +3,13 @@
 #define CL_TARGET_OPENCL_VERSION 200
 #define CL_HPP_TARGET_OPENCL_VERSION 200
 #define CL_USE_DEPRECATED_OPENCL_2_0_APIS
-#define CL_HPP_ENABLE_EXCEPTIONS
 
 #include <CL/opencl.hpp>
 #include <string>
+#include <vector>
 #include "config.h"
 #include "data.h"
+#include "telemetry.h"
 
 namespace ppr::gpu
 {
@@ -21,12 +22,225 @@ namespace ppr::gpu
 		cl::Context context{};                          // Opencl context
 		cl::Program program{};                          // Opencl program
 		cl::Kernel kernel{};                            // Opencl kernel          
+		cl::Kernel reduce_kernel{};                     // Second stage kernel (statistics only)
+		cl::CommandQueue queue{};                       // Profiling command queue of the device (shared by all programs of the device)
 		unsigned long long wg_size = 0;                 // One work group size
+		unsigned long long local_mem_size = 0;          // Local memory of device in bytes
 		unsigned long long data_count_for_gpu = 0;      // Data count for process on gpu
 		unsigned long long data_count_for_cpu = 0;      // Data count for process on cpu
 		unsigned long wg_count = 0;                     // Work group count
+		double build_time = 0.0;                        // Program compile or binary load in seconds
+		double saved_time = 0.0;                        // Compile time saved by binary cache in seconds
 	};
 
+	/// <summary>
+	/// Work groups of the first statistics stage. Work items stride over the whole chunk
+	/// </summary>
+	const constexpr unsigned long long STAT_MAX_GROUPS = 256;
+
+	/// <summary>
+	/// Statistics of one chunk computed on device. Same layout as 'stat_record' in statistics_kernel.cl
+	/// </summary>
+	struct SDevice_stat
+	{
+		double n = 0.0;
+		double sum = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		double sum_log = 0.0;
+		double sum_log2 = 0.0;
+		double sum_x_log = 0.0;
+		double sum_log1m = 0.0;
+		double negative = 0.0;                          // 1 = some value is below zero (-0.0 is not)
+		double integer = 0.0;                           // 1 = all values are integers
+	};
+	static_assert(sizeof(SDevice_stat) == 10 * sizeof(double), "SDevice_stat must match stat_record of statistics kernel");
+
+	/// <summary>
+	/// Number of staging slots of device pipeline. Upload of one slot overlaps kernel of the other
+	/// </summary>
+	const constexpr int PIPELINE_SLOT_COUNT = 2;
+
+	/// <summary>
+	/// Values in one staging slot (16 MB)
+	/// </summary>
+	const constexpr unsigned long long PIPELINE_SLOT_VALUES = 1 << 21;
+
+	/// <summary>
+	/// Piece, which is not downloaded in this time, is processed on CPU and the device is not used any more
+	/// </summary>
+	const constexpr double PIPELINE_DEADLINE_SEC = 10.0;
+
+	/// <summary>
+	/// Poll interval of event status, while host waits for a piece
+	/// </summary>
+	const constexpr int PIPELINE_POLL_MICROSECONDS = 100;
+
+	/// <summary>
+	/// Values, which device did not process
+	/// </summary>
+	struct SPiece
+	{
+		const double* data = nullptr;
+		unsigned long long count = 0;
+	};
+
+	/// <summary>
+	/// Profiled time of device commands in seconds
+	/// </summary>
+	struct SDevice_timing
+	{
+		double upload = 0.0;
+		double kernel = 0.0;
+		double download = 0.0;
+	};
+
+	/// <summary>
+	/// Pipelined processing on one OpenCL device. Values are copied to pinned staging buffers from a pool of slots.
+	/// Upload, kernel and download are chained by events on three in-order queues (upload, compute, download),
+	/// so the upload of the next piece overlaps the kernel of the current one
+	/// </summary>
+	class Device_pipeline
+	{
+	private:
+		/// <summary>
+		/// One staging slot with its device buffers and events
+		/// </summary>
+		struct SSlot
+		{
+			cl::Buffer staging{};                       // Pinned host memory (CL_MEM_ALLOC_HOST_PTR)
+			double* pinned = nullptr;                   // Mapped staging buffer
+			cl::Buffer input{};
+			cl::Buffer partials{}, result{};
+			cl::Buffer out_hist{}, out_var{};
+			SDevice_stat record{};
+			std::vector<double> var;
+			std::vector<cl_uint> histogram;
+			cl::Event upload{}, kernel{}, reduce{}, download{};
+			EIteration iteration = EIteration::STAT;
+			unsigned int stats = 0;                     // Collected sufficient statistics
+			unsigned long long groups = 0;              // Work groups of the piece
+			unsigned long long count = 0;               // Values in flight (0 = free slot)
+			const double* source = nullptr;             // Source of values in flight, is re-queued after deadline
+			bool abandoned = false;                     // Device did not finish the piece, buffers are still in use
+		};
+
+		SOpenCLConfig m_stat_kernel;
+		SOpenCLConfig m_hist_kernel;
+		cl::CommandQueue m_upload_queue;
+		cl::CommandQueue m_download_queue;
+		SSlot m_slots[PIPELINE_SLOT_COUNT];
+		int m_next = 0;
+		bool m_ready = false;
+		bool m_failed = false;                          // Some command failed or missed deadline, device takes no more work
+		const ppr::watchdog::Telemetry& m_telemetry;
+		std::vector<SPiece> m_requeued;
+
+		// Results of collected pieces
+		SDataStat m_stat;
+		std::vector<int> m_histogram;
+		double m_variance = 0.0;
+		SDevice_timing m_timing;
+
+		// Trace tracks of upload, kernel and download queue (-1 = tracing disabled)
+		int m_trace_track = -1;
+		long long m_trace_offset = 0;                   // Host minus device time in nanoseconds
+		bool m_trace_synced = false;
+
+		/// <summary>
+		/// Record profiled commands of collected slot to trace. Device clock is moved to host clock by the first download
+		/// </summary>
+		/// <param name="slot">- Collected staging slot</param>
+		void trace_slot(const SSlot& slot);
+
+		/// <summary>
+		/// Wait for download of slot, until deadline or cancellation of the run
+		/// </summary>
+		/// <param name="slot">- Staging slot</param>
+		/// <returns>Is piece downloaded</returns>
+		bool wait(SSlot& slot);
+
+		/// <summary>
+		/// Wait for slot and add its results. Piece, which misses deadline, is re-queued and the slot is abandoned
+		/// </summary>
+		/// <param name="slot">- Staging slot</param>
+		void collect(SSlot& slot);
+
+		/// <summary>
+		/// Enqueue upload, kernel and download of one piece
+		/// </summary>
+		/// <param name="slot">- Free staging slot</param>
+		/// <param name="iteration">- Current pass</param>
+		/// <param name="data">- Values</param>
+		/// <param name="count">- Values in piece (multiple of work group size)</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		void enqueue(SSlot& slot, EIteration iteration, const double* data, unsigned long long count, SHistogram& hist, SDataStat& stat);
+
+	public:
+		/// <summary>
+		/// Create queues and staging slots of the device
+		/// </summary>
+		/// <param name="stat_kernel">- Statistics kernel of the device</param>
+		/// <param name="hist_kernel">- Histogram kernel of the device (same context)</param>
+		/// <param name="telemetry">- Cancellation token</param>
+		Device_pipeline(SOpenCLConfig& stat_kernel, SOpenCLConfig& hist_kernel, const ppr::watchdog::Telemetry& telemetry);
+		~Device_pipeline();
+
+		/// <summary>
+		/// Is pipeline usable
+		/// </summary>
+		bool is_ready() const { return m_ready; }
+
+		/// <summary>
+		/// Did some command fail or miss deadline
+		/// </summary>
+		bool is_failed() const { return m_failed; }
+
+		/// <summary>
+		/// Stop using the device after an error outside of the pipeline. Unfinished commands are not waited for
+		/// </summary>
+		void abandon() { m_failed = true; }
+
+		/// <summary>
+		/// Take pieces, which device did not process. Pointers are valid, while the window of the pieces is mapped
+		/// </summary>
+		/// <returns>Pieces for CPU</returns>
+		std::vector<SPiece> take_requeued();
+
+		/// <summary>
+		/// Copy values to staging slots and enqueue them. Returns, when all values are copied, so that the source can be unmapped
+		/// </summary>
+		/// <param name="iteration">- Current pass</param>
+		/// <param name="data">- Values</param>
+		/// <param name="count">- Values count (multiple of work group size)</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		void submit(EIteration iteration, const double* data, unsigned long long count, SHistogram& hist, SDataStat& stat);
+
+		/// <summary>
+		/// Wait for all pieces and move results to the caller
+		/// </summary>
+		/// <param name="stat">- Statistics of processed values</param>
+		/// <param name="histogram">- Frequency histogram of processed values</param>
+		/// <param name="variance">- Variance sum of processed values</param>
+		void drain(SDataStat& stat, std::vector<int>& histogram, double& variance);
+
+		/// <summary>
+		/// Get profiled time of device commands
+		/// </summary>
+		/// <returns>Profiled time</returns>
+		SDevice_timing get_timing() const { return m_timing; }
+	};
+
+	/// <summary>
+	/// Local histogram of every work group has to fit in local memory next to variance buffer
+	/// </summary>
+	/// <param name="opencl">- Opencl configuration structure</param>
+	/// <param name="hist">- Histogram configuration structure</param>
+	/// <returns>1 = local histogram, 0 = global atomics</returns>
+	cl_int use_local_histogram(SOpenCLConfig& opencl, SHistogram& hist);
+
 	/// <summary>
 	/// Create data histogram on Opencl device
 	/// </summary>
@@ -42,13 +256,16 @@ namespace ppr::gpu
 		double* data, long long begin, long long end, std::vector<int>& freq_buckets, double& var);
 
 	/// <summary>
-	/// Collect data statistics on Opencl device
+	/// Collect data statistics on Opencl device. Both reduction stages run on device, only one record is read back
 	/// </summary>
+	/// <param name="stat">- Statistics structure</param>
 	/// <param name="m_ocl_config">- Opencl configuration structure</param>
 	/// <param name="configuration">- Program configuration structure</param>
 	/// <param name="data">- Data pointer</param>
-	/// <param name="data_count">- Data count to process</param>
-	void run_statistics_on_GPU(SDataStat& stat, SOpenCLConfig& m_ocl_config, SConfig& configuration, double* data, long long begin, long long end);
+	/// <param name="begin">- First value</param>
+	/// <param name="end">- Last value (count is 'data_count_for_gpu')</param>
+	/// <returns>Device statistics record</returns>
+	SDevice_stat run_statistics_on_GPU(SDataStat& stat, SOpenCLConfig& m_ocl_config, SConfig& configuration, double* data, long long begin, long long end);
 
 	/// <summary>
 	/// Init opencl 
@@ -65,7 +282,8 @@ namespace ppr::gpu
 	/// <param name="configuration">- Program configuration structure</param>
 	/// <param name="file">- kernel file</param>
 	/// <param name="kernel_name">- kernel name</param>
-	void set_kernel_program(SOpenCLConfig& opencl, const std::string& file, const char* kernel_name);
+	/// <param name="reduce_kernel_name">- second stage kernel name (nullptr = none)</param>
+	void set_kernel_program(SOpenCLConfig& opencl, const std::string& file, const char* kernel_name, const char* reduce_kernel_name = nullptr);
 
 	/// <summary>
 	/// Create OpenCl kernel with init program
@@ -75,7 +293,14 @@ namespace ppr::gpu
 	void create_kernel(SOpenCLConfig& opencl, const char* kernel_name);
 
 	/// <summary>
-	/// Create OpenCl kernel with program
+	/// Create OpenCL context and command queue of the device
+	/// </summary>
+	/// <param name="opencl">- Opencl configuration structure</param>
+	void create_context(SOpenCLConfig& opencl);
+
+	/// <summary>
+	/// Create OpenCl kernel with program. Context is created only once per device. Program binary is loaded from
+	/// KERNEL_CACHE_DIR, when the same source was built on the same device and driver before, otherwise it is compiled and saved
 	/// </summary>
 	/// <param name="opencl">- Opencl configuration structure</param>
 	/// <param name="file">- kernel file</param>
@@ -4,6 +4,7 @@
 #include <memory>
 #include "rss.cpp"
 #include "data.h"
+#include "distribution.h"
 
 #undef min
 #undef max
@@ -45,10 +46,9 @@ namespace ppr::hist
 		/// Compute RSS of histogram
 		/// </summary>
 		/// <param name="bucket_density">- Density histogram reference</param>
-		/// <param name="dist_val">- Distribution</param>
-		/// <param name="res">- Final results</param>
+		/// <param name="fit">- Fitted distribution</param>
 		/// <returns>RSS value</returns>
-		double compute_rss_histogram(std::vector<double>& bucket_density, char dist_val, SResult& res);
+		double compute_rss_histogram(std::vector<double>& bucket_density, SDistribution_fit& fit);
 	};
 
 	class Histogram_parallel
@@ -0,0 +1,74 @@
+#pragma once
+#include "data.h"
+#include "telemetry.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace ppr::memory
+{
+	/// <summary>
+	/// Memory limit of the checker (checker.ini, Memory_Limit)
+	/// </summary>
+	const constexpr long long MEMORY_LIMIT_BYTES = 1073741824;
+
+	/// <summary>
+	/// Time between two memory samples
+	/// </summary>
+	const constexpr int MEMORY_SAMPLE_MILLISECONDS = 10;
+
+	/// <summary>
+	/// Number of sampled stages (watchdog stages before the end of the run)
+	/// </summary>
+	const constexpr int MEMORY_STAGE_COUNT = 4;
+
+	/// <summary>
+	/// Name of each sampled stage (index = watchdog stage)
+	/// </summary>
+	const constexpr char* MEMORY_STAGE_NAMES[MEMORY_STAGE_COUNT] = { "stat", "hist", "density", "rss" };
+
+	/// <summary>
+	/// Current memory use of the process. On Linux from /proc/self/statm, on Windows only the working set is known
+	/// </summary>
+	/// <returns>Memory use in bytes (-1 = not available)</returns>
+	SStage_memory current_usage();
+
+	/// <summary>
+	/// Peak resident set of the process (VmHWM, PeakWorkingSetSize). Catches peaks between samples
+	/// </summary>
+	/// <returns>Bytes (-1 = not available)</returns>
+	long long peak_resident();
+
+	/// <summary>
+	/// Thread, which samples memory use of the process and keeps high-water marks of every stage
+	/// </summary>
+	class Memory_sampler
+	{
+	private:
+		const ppr::watchdog::Telemetry& m_telemetry;
+		std::atomic<bool> m_running{ true };
+		SStage_memory m_peaks[MEMORY_STAGE_COUNT];
+		bool m_sampled[MEMORY_STAGE_COUNT]{};
+		std::thread m_thread;
+
+		/// <summary>
+		/// Sample memory use, until the sampler is stopped
+		/// </summary>
+		void run();
+
+	public:
+		/// <summary>
+		/// Start sampling
+		/// </summary>
+		/// <param name="telemetry">- Current program stage</param>
+		Memory_sampler(const ppr::watchdog::Telemetry& telemetry);
+		~Memory_sampler();
+
+		/// <summary>
+		/// Stop sampling
+		/// </summary>
+		/// <returns>High-water marks of sampled stages</returns>
+		std::vector<SStage_memory> stop();
+	};
+}
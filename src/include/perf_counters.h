@@ -0,0 +1,60 @@
+#pragma once
+#include "data.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+namespace ppr::perf
+{
+	/// <summary>
+	/// Values of all performance counters (-1 = counter is not available)
+	/// </summary>
+	using Counter_values = std::array<long long, PERF_COUNTER_COUNT>;
+
+	/// <summary>
+	/// Counters of one thread
+	/// </summary>
+	struct SThread_counters;
+
+	/// <summary>
+	/// Performance counters of all arena threads. Every thread opens its own counters, when it joins the arena for the first time.
+	/// On Linux they are perf_event_open counters of user space: cycles, instructions, LLC and dTLB read misses, page faults and
+	/// context switches. Multiplexed hardware counters are scaled by their enabled and running time. On Windows only thread
+	/// cycles and page faults of the process are available
+	/// </summary>
+	class Perf_counters : public tbb::task_scheduler_observer
+	{
+	private:
+		std::mutex m_mutex;
+		std::vector<std::unique_ptr<SThread_counters>> m_threads;
+		unsigned long long m_id;
+
+	public:
+		Perf_counters(tbb::task_arena& arena);
+		~Perf_counters();
+
+		/// <summary>
+		/// Thread joined the arena. Counters are opened once per thread
+		/// </summary>
+		/// <param name="is_worker">- Is worker thread</param>
+		void on_scheduler_entry(bool is_worker) override;
+
+		/// <summary>
+		/// Sum counters of all threads
+		/// </summary>
+		/// <returns>Counter values</returns>
+		Counter_values read();
+	};
+
+	/// <summary>
+	/// Counters counted between two readings
+	/// </summary>
+	/// <param name="begin">- Earlier reading</param>
+	/// <param name="end">- Later reading</param>
+	/// <returns>Difference (-1 = counter is not available)</returns>
+	Counter_values difference(const Counter_values& begin, const Counter_values& end);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+
+#include <vector>
+#include <tbb/task_arena.h>
+
+namespace ppr::roofline
+{
+	/// <summary>
+	/// Values of one STREAM array (64 MB, three arrays are far bigger than caches and fit the memory limit)
+	/// </summary>
+	const constexpr long long STREAM_COUNT = 1 << 23;
+
+	/// <summary>
+	/// How many times is every STREAM kernel repeated (the best time is used)
+	/// </summary>
+	const constexpr int STREAM_REPEAT = 5;
+
+	/// <summary>
+	/// Maximum number of bytes read by sequential read probe
+	/// </summary>
+	const constexpr unsigned long long IO_PROBE_BYTES = 1ULL << 30;
+
+	/// <summary>
+	/// Block of sequential read probe (multiple of sector and page size)
+	/// </summary>
+	const constexpr unsigned long long IO_PROBE_BLOCK = 8ULL << 20;
+
+	/// <summary>
+	/// Scan rate, which is this many times over storage bandwidth, must come from page cache
+	/// </summary>
+	const constexpr double WARM_RATE_FACTOR = 1.1;
+
+	/// <summary>
+	/// Memory bandwidth of STREAM kernels in GB/s. Read is the sum of one array, as the scan of input file
+	/// </summary>
+	struct SStream
+	{
+		double read = 0.0;
+		double copy = 0.0;
+		double scale = 0.0;
+		double add = 0.0;
+		double triad = 0.0;
+	};
+
+	/// <summary>
+	/// Achieved rate of one pass against its ceiling
+	/// </summary>
+	struct SPass_roofline
+	{
+		const char* pass;
+		double achieved = 0.0;                  // GB/s of the pass
+		double ceiling = 0.0;                   // GB/s of memory, storage or their mix (0 = unknown)
+		double cached = -1.0;                   // Part of input in page cache (-1 = unknown)
+		bool inferred = false;                  // Cache state is guessed from achieved rate
+	};
+
+	/// <summary>
+	/// Machine limits and passes of one run
+	/// </summary>
+	struct SRoofline
+	{
+		SStream memory;
+		double storage = 0.0;                   // GB/s of sequential read without page cache (0 = unknown)
+		std::vector<SPass_roofline> passes;
+	};
+
+	/// <summary>
+	/// STREAM-style memory bandwidth probe. Arrays are split statically, so that every thread touches its own pages
+	/// </summary>
+	/// <param name="arena">- TBB arena</param>
+	/// <returns>Bandwidth of every kernel</returns>
+	SStream measure_stream(tbb::task_arena& arena);
+
+	/// <summary>
+	/// Sequential read probe, which bypasses page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING)
+	/// </summary>
+	/// <param name="file_name">- File on measured storage</param>
+	/// <returns>GB/s (0 = file system does not allow reading without cache)</returns>
+	double measure_sequential_read(const char* file_name);
+
+	/// <summary>
+	/// Part of file pages in page cache (mincore)
+	/// </summary>
+	/// <param name="file_name">- File name</param>
+	/// <returns>0 - 1 (-1 = unknown, on Windows)</returns>
+	double cached_fraction(const char* file_name);
+
+	/// <summary>
+	/// Compare pass rates of the run with memory and storage bandwidth. Limits come from tuning profile,
+	/// probes run, when the profile does not have them
+	/// </summary>
+	/// <param name="configuration">- Program configuration structure</param>
+	/// <param name="result">- Finished run</param>
+	/// <param name="cached_before">- Cached part of input before the run (statistics pass)</param>
+	/// <param name="cached_after">- Cached part of input after the run (histogram pass)</param>
+	/// <returns>Roofline of the run</returns>
+	SRoofline analyze(const SConfig& configuration, const SResult& result, double cached_before, double cached_after);
+}
@@ -3,42 +3,252 @@
 #include "config.h"
 #include "file_mapping.h"
 #include "executor.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "perf_counters.h"
+#include "trace.h"
 
 #include "smp_utils.h"
 
+#include <atomic>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <tbb/flow_graph.h>
+#include <tbb/info.h>
+#include <tbb/task_scheduler_observer.h>
+
 namespace ppr::parallel
 {
 	/// <summary>
-	/// Starting function which runs on CPU only
+	/// Stages of solver pipeline
 	/// </summary>
-	/// <param name="configuration">Program configuration structure</param>
-	/// <returns>Computing results</returns>
-	SResult run(SConfig& configuration);
+	enum class EPipeline_stage : int {
+		STAT = 0,
+		HIST = 1,
+		FIT = 2,
+		DENSITY = 3,
+		RSS = 4,
+		MERGE = 5
+	};
+
+	/// <summary>
+	/// Number of stages in EPipeline_stage
+	/// </summary>
+	const constexpr int PIPELINE_STAGE_COUNT = 6;
+
+	/// <summary>
+	/// Watchdog stage of each pipeline stage (index = EPipeline_stage). Merges run in both passes and do not move the stage
+	/// </summary>
+	const constexpr int PIPELINE_WATCHDOG_STAGE[PIPELINE_STAGE_COUNT] = { 0, 1, 2, 2, 3, 0 };
+
+	/// <summary>
+	/// Name of each pipeline stage in counters output (index = EPipeline_stage)
+	/// </summary>
+	const constexpr char* PIPELINE_STAGE_NAMES[PIPELINE_STAGE_COUNT] = { "stat", "hist", "fit", "density", "rss", "merge" };
+
+	/// <summary>
+	/// Partition alignment of whole file view in bytes (page size, multiple of cache line)
+	/// </summary>
+	const constexpr unsigned long long PARTITION_ALIGNMENT = 4096;
+
+	/// <summary>
+	/// One chunk of input data
+	/// </summary>
+	struct SChunk
+	{
+		double* data = nullptr;             // First value of the chunk
+		unsigned long long count = 0;       // Number of values
+		double* view = nullptr;             // Mapped window, which is unmapped after processing (nullptr = shared view)
+		unsigned long long offset = 0;      // Index of the first value in file
+	};
+
+	/// <summary>
+	/// Result of one chunk. Results are merged in file order, so that merged state always covers a prefix of the file
+	/// </summary>
+	struct SChunk_result
+	{
+		unsigned long long offset = 0;      // Index of the first value in file
+		unsigned long long count = 0;       // Number of values
+		SDataStat stat;                     // Statistics pass
+		double variance = 0.0;              // Histogram pass
+		std::vector<int> histogram;         // Histogram pass of checkpointed run (empty = counted to histogram of the thread)
+		bool partial = false;               // Reduction was cancelled, values may be missing
+	};
+
+	/// <summary>
+	/// Pins arena threads to logical processors by arena slot. Arena threads live for the whole run,
+	/// so pinned workers keep their partitions and histogram buffers in their own caches between passes.
+	/// Slots are numbered over all processor groups, so hosts with more than 64 logical processors use every group
+	/// </summary>
+	class Thread_pinning : public tbb::task_scheduler_observer
+	{
+	private:
+		std::vector<unsigned int> m_group_sizes;        // Active logical processors of every processor group
+		unsigned int m_processor_count;
+
+	public:
+		Thread_pinning(tbb::task_arena& arena);
+		~Thread_pinning();
+
+		/// <summary>
+		/// Thread joined the arena
+		/// </summary>
+		/// <param name="is_worker">- Is worker thread</param>
+		void on_scheduler_entry(bool is_worker) override;
+
+		/// <summary>
+		/// Thread left the arena
+		/// </summary>
+		/// <param name="is_worker">- Is worker thread</param>
+		void on_scheduler_exit(bool is_worker) override;
+	};
+
+	/// <summary>
+	/// Measures time of pipeline stages from the first node start to the last node end and moves watchdog stage forward.
+	/// Busy time sums executions of stage nodes, so that serial merges can be told apart from parallel reduction
+	/// </summary>
+	class Stage_clock
+	{
+	private:
+		std::mutex m_mutex;
+		tbb::tick_count m_begin[PIPELINE_STAGE_COUNT];
+		tbb::tick_count m_end[PIPELINE_STAGE_COUNT];
+		double m_busy[PIPELINE_STAGE_COUNT]{};
+		bool m_started[PIPELINE_STAGE_COUNT]{};
+		ppr::watchdog::Telemetry& m_telemetry;
+		ppr::perf::Perf_counters* m_counters;
+		ppr::perf::Counter_values m_counters_begin[PIPELINE_STAGE_COUNT];
+		ppr::perf::Counter_values m_counters_end[PIPELINE_STAGE_COUNT];
+
+		/// <summary>
+		/// Node execution scope
+		/// </summary>
+		class Scope
+		{
+		private:
+			Stage_clock& m_clock;
+			EPipeline_stage m_stage;
+			tbb::tick_count m_start;
+			ppr::trace::Scope m_trace;
+
+		public:
+			Scope(Stage_clock& clock, EPipeline_stage stage)
+				: m_clock(clock), m_stage(stage), m_start(tbb::tick_count::now()), m_trace(PIPELINE_STAGE_NAMES[static_cast<int>(stage)], "smp") { m_clock.begin(m_stage); }
+			~Scope() { m_clock.end(m_stage, m_start); }
+		};
+
+	public:
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="telemetry">- Watchdog telemetry</param>
+		/// <param name="counters">- Performance counters of arena threads (nullptr = not measured)</param>
+		Stage_clock(ppr::watchdog::Telemetry& telemetry, ppr::perf::Perf_counters* counters = nullptr) : m_telemetry(telemetry), m_counters(counters) {}
+
+		/// <summary>
+		/// Node of the stage started
+		/// </summary>
+		/// <param name="stage">- Pipeline stage</param>
+		void begin(EPipeline_stage stage);
+
+		/// <summary>
+		/// Node of the stage finished
+		/// </summary>
+		/// <param name="stage">- Pipeline stage</param>
+		/// <param name="start">- Start of the node execution</param>
+		void end(EPipeline_stage stage, tbb::tick_count start);
+
+		/// <summary>
+		/// Wrap flow graph node body, so that its execution is counted to the stage
+		/// </summary>
+		/// <typeparam name="Body">- Node body type</typeparam>
+		/// <param name="stage">- Pipeline stage</param>
+		/// <param name="body">- Node body</param>
+		/// <returns>Node body</returns>
+		template <typename Body>
+		auto timed(EPipeline_stage stage, Body body)
+		{
+			return [this, stage, body](auto&&... args) mutable {
+				Scope scope(*this, stage);
+				return body(std::forward<decltype(args)>(args)...);
+			};
+		}
+
+		/// <summary>
+		/// Get stage time
+		/// </summary>
+		/// <param name="stage">- Pipeline stage</param>
+		/// <returns>Seconds</returns>
+		double seconds(EPipeline_stage stage) const;
+
+		/// <summary>
+		/// Get sum of node execution times of the stage
+		/// </summary>
+		/// <param name="stage">- Pipeline stage</param>
+		/// <returns>Seconds</returns>
+		double busy_seconds(EPipeline_stage stage) const;
+
+		/// <summary>
+		/// Get counters of all arena threads between the first start and the last end of stage nodes.
+		/// Stages, which run at the same time, share their counts
+		/// </summary>
+		/// <param name="stage">- Pipeline stage</param>
+		/// <returns>Counter values (-1 = not measured)</returns>
+		ppr::perf::Counter_values counters(EPipeline_stage stage) const;
+	};
 
 	/// <summary>
-	/// Calculate data statistics using Intel TBB algorithms. Calls from file_mapping.h > read_in_chunks()
+	/// Chunk count is not known until the reader reaches end of file
+	/// </summary>
+	const constexpr unsigned long long UNKNOWN_CHUNK_COUNT = std::numeric_limits<unsigned long long>::max();
+
+	/// <summary>
+	/// Body of input node. Splits input file to chunks.
+	/// Whole file view is split between threads, otherwise every chunk is one mapped window, which must be unmapped by the consumer.
+	/// Window size is chosen by window controller
+	/// </summary>
+	class Chunk_reader
+	{
+	private:
+		File_mapping& m_mapping;
+		Window_controller& m_controller;
+		ppr::watchdog::Telemetry& m_telemetry;
+		std::atomic<unsigned long long>& m_chunk_count;
+		double* m_view;
+		unsigned long long m_count;
+		unsigned long long m_chunk_size;
+		unsigned long long m_offset;
+		unsigned long long m_produced;
+
+	public:
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="mapping">- Opened file mapping</param>
+		/// <param name="controller">- Window size controller</param>
+		/// <param name="telemetry">- Cancellation token</param>
+		/// <param name="chunk_count">- Number of chunks. Set, when the last chunk is read</param>
+		/// <param name="view">- Whole file view (nullptr = map one window per chunk)</param>
+		/// <param name="chunk_size">- Values in one partition of whole file view</param>
+		/// <param name="start">- Index of the first value to read (resumed run)</param>
+		Chunk_reader(File_mapping& mapping, Window_controller& controller, ppr::watchdog::Telemetry& telemetry,
+			std::atomic<unsigned long long>& chunk_count, double* view, unsigned long long chunk_size, unsigned long long start = 0);
+
+		/// <summary>
+		/// TBB input_node operator() method
+		/// </summary>
+		/// <param name="fc">- Flow control</param>
+		/// <returns>Next chunk</returns>
+		SChunk operator()(tbb::flow_control& fc);
+	};
+
+	/// <summary>
+	/// Starting function which runs on CPU only
 	/// </summary>
-	/// <param name="hist">Histogram configuration structure</param>
 	/// <param name="configuration">Program configuration structure</param>
-	/// <param name="opencl">Opencl configuration structure</param>
-	/// <param name="stat">Statistics structure</param>
-	/// <param name="arena">TBB arena</param>
-	/// <param name="data_count">Data count for processing</param>
-	/// <param name="data">Data pointer</param>
-	/// <param name="histogram">Frequency histogram reference</param>
-	void get_statistics_CPU(SHistogram& hist, SConfig& configuration, ppr::gpu::SOpenCLConfig& opencl, SDataStat& stat,
-		tbb::task_arena& arena, unsigned long long data_count, double* data, std::vector<int>& histogram);
-
-	/// <summary>
-	/// Create frequency histogram using Intel TBB algorithms. Calls from file_mapping.h > read_in_chunks()
-	/// </summary>
-	/// <param name="hist">Histogram configuration structure</param>
-	/// <param name="opencl">Opencl configuration structure</param>
-	/// <param name="stat">Statistics structure</param>
-	/// <param name="arena">TBB arena</param>
-	/// <param name="data_count">Data count for processing</param>
-	/// <param name="data">Data pointer</param>
-	/// <param name="histogram">Frequency histogram reference</param>
-	void create_frequency_histogram_CPU(SHistogram& hist, SConfig& configuration, ppr::gpu::SOpenCLConfig& opencl,
-		SDataStat& stat, tbb::task_arena& arena, unsigned long long data_count, double* data, std::vector<int>& histogram);
+	/// <returns>Computing results</returns>
+	SResult run(SConfig& configuration);
 }
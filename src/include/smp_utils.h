@@ -9,74 +9,6 @@
 
 namespace ppr::parallel
 {
-	/// <summary>
-	/// Class for getting statistics. Is using for one thread processing
-	/// </summary>
-	class Stat_processing_unit
-	{
-	private:
-		SConfig m_configuration;
-		ppr::gpu::SOpenCLConfig m_ocl_config;
-
-	public:
-		Stat_processing_unit(SConfig& config, ppr::gpu::SOpenCLConfig& ocl_config) : m_configuration(config), m_ocl_config(ocl_config) {}
-
-		/// <summary>
-		/// Collect statistics of data block using AVX2 instructions
-		/// </summary>
-		/// <param name="data">data block pointer</param>
-		/// <param name="data_count">data count</param>
-		/// <returns></returns>
-		SDataStat run_on_CPU(double* data, long long data_count);
-
-		/// <summary>
-		/// Collect statistics of data block using OpenCL device. (Not using)
-		/// </summary>
-		/// <param name="data">data block pointer</param>
-		/// <param name="data_count">data count</param>
-		/// <returns></returns>
-		SDataStat run_on_GPU(double* data, long long begin, long long end);
-	};
-
-	class Hist_processing_unit
-	{
-	private:
-		SConfig m_configuration;
-		ppr::gpu::SOpenCLConfig m_ocl_config;
-		SHistogram m_hist;
-		SDataStat m_stat;
-
-	public:
-		Hist_processing_unit(SHistogram& hist, SConfig& config, ppr::gpu::SOpenCLConfig& ocl_config, SDataStat& stat)
-			: m_configuration(config), m_ocl_config(ocl_config), m_hist(hist), m_stat(stat) {}
-
-		/// <summary>
-		/// Create frequency histogram of data block using OpenCL device. (Not using)
-		/// </summary>
-		/// <param name="data">- data block pointer</param>
-		/// <param name="data_count">- data count</param>
-		/// <returns>Histogram vector and variance</returns>
-		std::tuple<std::vector<int>, double> run_on_CPU(double* data, long long data_count);
-
-		/// <summary>
-		/// Create frequency histogram of data block using AVX2 instructions.
-		/// </summary>
-		/// <param name="data">- data block pointer</param>
-		/// <param name="data_count">- data count</param>
-		/// <returns>Histogram vector and variance</returns>
-		std::tuple<std::vector<int>, double> run_on_GPU(double* data, long long begin, long long end);
-	};
-
-	/// <summary>
-	/// Main function to start creating frequency histogram from input data using AVX2 instructions. (Not using)
-	/// </summary>
-	/// <param name="stat">- Statistics structure</param>
-	/// <param name="array_sum">- input array</param>
-	/// <param name="array_min">- input array</param>
-	/// <param name="array_max">- input array</param>
-	/// <param name="size">- array size</param>
-	void agregate_gpu_stat_vectorized(SDataStat& stat, double* array_sum, double* array_min, double* array_max, int size);
-	
 	/// <summary>
 	/// Find sum of all elements of array. Vectorized
 	/// </summary>
@@ -112,46 +44,10 @@ namespace ppr::parallel
 	double max_of_vector_vectorized(std::vector<double> vector);
 
 	/// <summary>
-	/// Calculating RSS for each distribution i threads
+	/// Calculating RSS for all fitted distributions in one parallel sweep over density histogram
 	/// </summary>
 	/// <param name="res">- Final results structure</param>
 	/// <param name="histogramDensity">- Density histogram reference</param>
 	/// <param name="hist">- Histogram configuration structure</param>
 	void calculate_histogram_RSS_cpu(SResult& res, std::vector<double>& histogramDensity, SHistogram& hist);
-
-	/// <summary>
-	/// Method to calculate RSS for Gauss distribution. Used in thread
-	/// </summary>
-	/// <param name="res">- Final results structure</param>
-	/// <param name="histogramDensity">- Density histogram reference</param>
-	/// <param name="hist">- Histogram configuration structure</param>
-	/// <returns>rss</returns>
-	double get_gauss_rss(SResult& res, std::vector<double>& histogramDensity, SHistogram& hist);
-
-	/// <summary>
-	/// Method to calculate RSS for Gauss distribution. Used in thread
-	/// </summary>
-	/// <param name="res">- Final results structure</param>
-	/// <param name="histogramDensity">- Density histogram reference</param>
-	/// <param name="hist">- Histogram configuration structure</param>
-	/// <returns>rss</returns>
-	double get_poisson_rss(SResult& res, std::vector<double>& histogramDensity, SHistogram& hist);
-
-	/// <summary>
-	/// Method to calculate RSS for Exponential distribution. Used in thread
-	/// </summary>
-	/// <param name="res">- Final results structure</param>
-	/// <param name="histogramDensity">- Density histogram reference</param>
-	/// <param name="hist">- Histogram configuration structure</param>
-	/// <returns>rss</returns>
-	double get_exp_rss(SResult& res, std::vector<double>& histogramDensity, SHistogram& hist);
-
-	/// <summary>
-	/// Method to calculate RSS for Uniform distribution. Used in thread
-	/// </summary>
-	/// <param name="res">- Final results structure</param>
-	/// <param name="histogramDensity">- Density histogram reference</param>
-	/// <param name="hist">- Histogram configuration structure</param>
-	/// <returns>rss</returns>
-	double get_uniform_rss(SResult& res, std::vector<double>& histogramDensity, SHistogram& hist);
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <tbb/task_group.h>
+
+namespace ppr::watchdog
+{
+	/// <summary>
+	/// Cache line size. Counters of different workers never share a line
+	/// </summary>
+	const constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+	/// <summary>
+	/// Number of scan passes over input file (statistics, histogram)
+	/// </summary>
+	const constexpr int TELEMETRY_PASS_COUNT = 2;
+
+	/// <summary>
+	/// Values of whole file view processed between two counter updates (8 MB). Keeps the update off the hot loop
+	/// </summary>
+	const constexpr long long TELEMETRY_BLOCK_VALUES = 1 << 20;
+
+	/// <summary>
+	/// Allowed slow down of file scan by counter updates. Is checked by calibration
+	/// </summary>
+	const constexpr double TELEMETRY_MAX_OVERHEAD = 0.01;
+
+	/// <summary>
+	/// Watchdog stops the program, when scan does not move for this time
+	/// </summary>
+	const constexpr double WATCHDOG_STALL_SEC = 60.0;
+
+	/// <summary>
+	/// Progress counters of one worker. Only the owner writes them, watchdog reads them
+	/// </summary>
+	struct alignas(CACHE_LINE_SIZE) SWorker_counters
+	{
+		std::atomic<unsigned long long> elements[TELEMETRY_PASS_COUNT]{};
+		std::atomic<unsigned long long> bytes[TELEMETRY_PASS_COUNT]{};
+		std::atomic<unsigned long long> chunks[TELEMETRY_PASS_COUNT]{};
+	};
+
+	static_assert(sizeof(SWorker_counters) % CACHE_LINE_SIZE == 0, "Counters must fill whole cache lines");
+
+	/// <summary>
+	/// Sum of counters of all workers in one pass
+	/// </summary>
+	struct SProgress
+	{
+		unsigned long long elements = 0;
+		unsigned long long bytes = 0;
+		unsigned long long chunks = 0;
+	};
+
+	/// <summary>
+	/// Telemetry shared by solver and watchdog. Workers add processed values to their own padded counters with relaxed atomics,
+	/// watchdog sums them. Program stage is published with release, so that watchdog sees results of finished stages.
+	/// It is also cancellation token of the run. Watchdog cancels the run instead of exiting the process, TBB algorithms stop
+	/// through task group context, chunk loops and device queues check the token
+	/// </summary>
+	class Telemetry
+	{
+	private:
+		std::unique_ptr<SWorker_counters[]> m_counters;
+		std::size_t m_slot_count;
+		std::atomic<int> m_stage{ 0 };
+		std::atomic<int> m_status{ EExitStatus::SUCCESS };
+		tbb::task_group_context m_context;
+
+	public:
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="slot_count">- Number of workers (arena threads or scheduler workers)</param>
+		Telemetry(std::size_t slot_count);
+
+		/// <summary>
+		/// Count processed values. Slots out of range share counters
+		/// </summary>
+		/// <param name="iteration">- Current pass</param>
+		/// <param name="slot">- Worker index</param>
+		/// <param name="count">- Processed values</param>
+		/// <param name="chunks">- Finished chunks</param>
+		void add(EIteration iteration, std::size_t slot, unsigned long long count, unsigned long long chunks = 0)
+		{
+			SWorker_counters& counters = m_counters[slot % m_slot_count];
+			const int pass = static_cast<int>(iteration);
+
+			counters.elements[pass].fetch_add(count, std::memory_order_relaxed);
+			counters.bytes[pass].fetch_add(count * sizeof(double), std::memory_order_relaxed);
+			counters.chunks[pass].fetch_add(chunks, std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// Sum counters of all workers
+		/// </summary>
+		/// <param name="iteration">- Pass</param>
+		/// <returns>Progress of the pass</returns>
+		SProgress sample(EIteration iteration) const;
+
+		/// <summary>
+		/// Move program to next stage
+		/// </summary>
+		/// <param name="stage">- Watchdog stage</param>
+		void set_stage(int stage) { m_stage.store(stage, std::memory_order_release); }
+
+		/// <summary>
+		/// Move program stage forward only, while stages overlap
+		/// </summary>
+		/// <param name="stage">- Watchdog stage</param>
+		void advance_stage(int stage);
+
+		/// <summary>
+		/// Get program stage
+		/// </summary>
+		/// <returns>Watchdog stage</returns>
+		int get_stage() const { return m_stage.load(std::memory_order_acquire); }
+
+		/// <summary>
+		/// Cancel the run. Only the first status is kept
+		/// </summary>
+		/// <param name="status">- Exit status of the run</param>
+		void cancel(EExitStatus status);
+
+		/// <summary>
+		/// Is the run cancelled
+		/// </summary>
+		/// <returns>Run should stop</returns>
+		bool is_cancelled() const { return m_status.load(std::memory_order_acquire) != EExitStatus::SUCCESS; }
+
+		/// <summary>
+		/// Get exit status of cancelled run
+		/// </summary>
+		/// <returns>Exit status (SUCCESS = not cancelled)</returns>
+		int get_status() const { return m_status.load(std::memory_order_acquire); }
+
+		/// <summary>
+		/// Get task group context, which is cancelled together with the run
+		/// </summary>
+		/// <returns>TBB context</returns>
+		tbb::task_group_context& get_context() { return m_context; }
+	};
+}
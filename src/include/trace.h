@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace ppr::trace
+{
+	/// <summary>
+	/// Events kept by one thread. Older events are overwritten, when the buffer is full
+	/// </summary>
+	const constexpr std::size_t TRACE_BUFFER_EVENTS = 1 << 16;
+
+	/// <summary>
+	/// Tracing is compiled in, but events are recorded only after enable()
+	/// </summary>
+	extern std::atomic<bool> g_enabled;
+
+	/// <summary>
+	/// Is tracing enabled
+	/// </summary>
+	/// <returns>Record events</returns>
+	inline bool is_enabled()
+	{
+		return g_enabled.load(std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Host time of events
+	/// </summary>
+	/// <returns>Nanoseconds of steady clock</returns>
+	inline long long now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/// <summary>
+	/// Start recording events. Timestamps in trace are relative to this call
+	/// </summary>
+	void enable();
+
+	/// <summary>
+	/// Name track of calling thread in trace viewer
+	/// </summary>
+	/// <param name="name">- Thread name</param>
+	void name_thread(const std::string& name);
+
+	/// <summary>
+	/// Create track of events, which do not run on a host thread (OpenCL queue)
+	/// </summary>
+	/// <param name="name">- Track name</param>
+	/// <returns>Track id</returns>
+	int add_track(const std::string& name);
+
+	/// <summary>
+	/// Record finished event to buffer of calling thread
+	/// </summary>
+	/// <param name="name">- Event name (string literal, is not copied)</param>
+	/// <param name="category">- Event category (string literal, is not copied)</param>
+	/// <param name="begin">- Start in nanoseconds of now()</param>
+	/// <param name="end">- End in nanoseconds of now()</param>
+	/// <param name="values">- Processed values (0 = none)</param>
+	/// <param name="track">- Track from add_track (-1 = calling thread)</param>
+	void record(const char* name, const char* category, long long begin, long long end, unsigned long long values = 0, int track = -1);
+
+	/// <summary>
+	/// Write all buffers as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev). Is called, when all workers are idle
+	/// </summary>
+	/// <param name="path">- Output file</param>
+	/// <returns>Number of written events (-1 = file can not be written)</returns>
+	long long write(const char* path);
+
+	/// <summary>
+	/// Event of one scope on calling thread. Does nothing, while tracing is disabled
+	/// </summary>
+	class Scope
+	{
+	private:
+		const char* m_name;
+		const char* m_category;
+		unsigned long long m_values;
+		long long m_begin;
+
+	public:
+		Scope(const char* name, const char* category, unsigned long long values = 0)
+			: m_name(name), m_category(category), m_values(values), m_begin(is_enabled() ? now() : 0) {}
+
+		~Scope()
+		{
+			if (m_begin != 0)
+			{
+				record(m_name, m_category, m_begin, now(), m_values);
+			}
+		}
+	};
+}
@@ -2,18 +2,20 @@
 #include <thread>
 #include "data.h"
 #include "config.h"
+#include "telemetry.h"
 
 namespace ppr::watchdog
 {
 	/// <summary>
-	/// Function is creatinf one thread, which is checking program status in infinite loop
+	/// Function is creatinf one thread, which is checking program status in infinite loop.
+	/// During file scan it prints throughput and ETA. Found problem or stalled scan cancels the run
 	/// </summary>
 	/// <param name="stat">Statistics structure</param>
 	/// <param name="hist">Histogram configuration structure</param>
-	/// <param name="stage">Current program stage</param>
+	/// <param name="telemetry">Progress counters and current program stage</param>
 	/// <param name="histogram">Histogram vector reference</param>
 	/// <param name="histogramDesity">Density histogram vector reference</param>
 	/// <param name="data_count">Data count in a file</param>
-	std::thread start_watchdog(SConfig& config, SDataStat& stat, SHistogram& hist, int& stage,
+	std::thread start_watchdog(SConfig& config, SDataStat& stat, SHistogram& hist, Telemetry& telemetry,
 		std::vector<int>& histogram, std::vector<double>& histogramDesity, long data_count);
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+#include "data.h"
+#include "config.h"
+#include "gpu_utils.h"
+#include "telemetry.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <tbb/task_arena.h>
+
+namespace ppr::gpu
+{
+	/// <summary>
+	/// Smallest sub-chunk in values (512 kB), smaller ones do not pay off kernel launch or parallel_reduce
+	/// </summary>
+	const constexpr unsigned long long SCHEDULER_MIN_CLAIM = 1 << 16;
+
+	/// <summary>
+	/// Sub-chunk of a worker with known throughput is processed approximately in this time
+	/// </summary>
+	const constexpr double SCHEDULER_CLAIM_SECONDS = 0.05;
+
+	/// <summary>
+	/// Worker takes at most this part of its throughput share of remaining data, so that the last sub-chunks get smaller
+	/// and all workers finish the window together
+	/// </summary>
+	const constexpr double SCHEDULER_GUIDED_FACTOR = 0.5;
+
+	/// <summary>
+	/// One worker of heterogeneous scheduler. Worker 0 is CPU (all arena threads), the others are OpenCL devices
+	/// </summary>
+	struct SWorker
+	{
+		std::string name;
+		SOpenCLConfig stat_kernel{};            // Statistics kernel (OpenCL device only)
+		SOpenCLConfig hist_kernel{};            // Histogram kernel (OpenCL device only)
+		std::unique_ptr<Device_pipeline> pipeline{};  // Transfers and kernels (OpenCL device only)
+		double throughput = 0.0;                // Observed values per second in current pass (0 = not measured yet)
+		unsigned long long count = 0;           // Processed values in all passes
+		double seconds = 0.0;                   // Busy time in all passes
+		bool disabled = false;                  // Device failed or missed deadline and takes no more work
+		std::string error{};                    // Why device takes no more work
+		std::vector<SPiece> claims{};           // Sub-chunks of current window (OpenCL device only)
+	};
+
+	/// <summary>
+	/// Hands out sub-chunks of mapped window from a shared cursor to CPU and OpenCL devices.
+	/// Sub-chunk size follows observed throughput of the worker, so devices of different speed finish together.
+	/// Devices take multiples of work group size, CPU takes the rest
+	/// </summary>
+	class Work_scheduler
+	{
+	private:
+		tbb::task_arena& m_arena;
+		SConfig& m_configuration;
+		ppr::watchdog::Telemetry& m_telemetry;
+		std::vector<SWorker> m_workers;
+		bool m_cpu_shares;                      // CPU takes sub-chunks together with devices, otherwise only remainder
+		EIteration m_iteration = EIteration::STAT;
+		std::mutex m_mutex;
+		unsigned long long m_cursor = 0;
+		unsigned long long m_end = 0;
+
+		/// <summary>
+		/// Take next sub-chunk of current window
+		/// </summary>
+		/// <param name="index">- Worker index</param>
+		/// <param name="rest">- Take all remaining values</param>
+		/// <param name="begin">- First value of sub-chunk</param>
+		/// <param name="count">- Values in sub-chunk</param>
+		/// <returns>Is there any work</returns>
+		bool claim(size_t index, bool rest, unsigned long long& begin, unsigned long long& count);
+
+		/// <summary>
+		/// Save time of processed sub-chunk and update throughput of the worker
+		/// </summary>
+		/// <param name="index">- Worker index</param>
+		/// <param name="count">- Values in sub-chunk</param>
+		/// <param name="seconds">- Processing time</param>
+		void report(size_t index, unsigned long long count, double seconds);
+
+		/// <summary>
+		/// Process values of window on CPU (all arena threads). Cancelled run stops TBB algorithm
+		/// </summary>
+		/// <param name="begin">- First value</param>
+		/// <param name="count">- Values count</param>
+		/// <param name="data">- Window pointer</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		/// <param name="local_stat">- Statistics of the worker</param>
+		/// <param name="local_histogram">- Frequency histogram of the worker</param>
+		/// <param name="local_variance">- Variance of the worker</param>
+		void run_on_cpu(unsigned long long begin, unsigned long long count, double* data, SHistogram& hist, SDataStat& stat,
+			SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance);
+
+		/// <summary>
+		/// Process sub-chunks until the window is empty. Pieces, which device does not finish until deadline, are processed on CPU
+		/// </summary>
+		/// <param name="index">- Worker index</param>
+		/// <param name="rest">- Take all remaining values at once</param>
+		/// <param name="data">- Window pointer</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		/// <param name="local_stat">- Statistics of the worker</param>
+		/// <param name="local_histogram">- Frequency histogram of the worker</param>
+		/// <param name="local_variance">- Variance of the worker</param>
+		void work(size_t index, bool rest, double* data, SHistogram& hist, SDataStat& stat,
+			SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance);
+
+		/// <summary>
+		/// Disable device, whose thread threw an exception, and process its sub-chunks of current window on CPU.
+		/// It is unknown, which pieces of the device were merged, so its partial results are dropped
+		/// </summary>
+		/// <param name="index">- Worker index</param>
+		/// <param name="error">- Exception message</param>
+		/// <param name="data">- Window pointer</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		/// <param name="local_stat">- Statistics of the worker</param>
+		/// <param name="local_histogram">- Frequency histogram of the worker</param>
+		/// <param name="local_variance">- Variance of the worker</param>
+		void recover(size_t index, const std::string& error, double* data, SHistogram& hist, SDataStat& stat,
+			SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance);
+
+	public:
+		/// <summary>
+		/// Find OpenCL devices and build their kernels once for the whole run
+		/// </summary>
+		/// <param name="arena">- TBB arena of CPU worker</param>
+		/// <param name="configuration">- Program configuration structure</param>
+		/// <param name="telemetry">- Progress counters, one slot per worker</param>
+		Work_scheduler(tbb::task_arena& arena, SConfig& configuration, ppr::watchdog::Telemetry& telemetry);
+
+		/// <summary>
+		/// Process one mapped window on all workers
+		/// </summary>
+		/// <param name="iteration">- Current pass</param>
+		/// <param name="data">- Window pointer</param>
+		/// <param name="count">- Values in window</param>
+		/// <param name="hist">- Histogram configuration structure</param>
+		/// <param name="stat">- Statistics structure</param>
+		/// <param name="histogram">- Frequency histogram reference</param>
+		void process(EIteration iteration, double* data, unsigned long long count, SHistogram& hist, SDataStat& stat, std::vector<int>& histogram);
+
+		/// <summary>
+		/// Get work done by every worker
+		/// </summary>
+		/// <returns>Trace of workers</returns>
+		std::vector<SBackend_trace> get_trace() const;
+
+		/// <summary>
+		/// Is the run cancelled
+		/// </summary>
+		/// <returns>No more windows should be processed</returns>
+		bool is_cancelled() const { return m_telemetry.is_cancelled(); }
+	};
+}
@@ -4,8 +4,16 @@
 #include "include/smp_solver.h"
 #include "include/seq_solver.h"
 #include "include/gpu_solver.h"
+#include "include/benchmark.h"
+#include "include/calibration.h"
+#include "include/device_check.h"
+#include "include/trace.h"
+#include "include/memory_usage.h"
+#include "include/roofline.h"
 
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
 
 namespace ppr
 {
@@ -28,26 +36,43 @@ namespace ppr
 
 void get_dist_string(SResult result)
 {
-	switch (result.dist) {
-		case EDistribution::GAUSS: 
-			std::cout << "> Input data have 'Gauss/Normal distribution' with mean=" << result.gauss_mean << " and variance=" << result.gauss_variance << std::endl;
-			break;
-		case EDistribution::POISSON: 
-			std::cout << "> Input data have 'Poisson distribution' with lambda=" << result.poisson_lambda << std::endl;
-			break;
-		case EDistribution::EXP: 
-			std::cout << "> Input data have 'Exponential distribution' with lambda=" << result.exp_lambda << std::endl;
-			break;
-		case EDistribution::UNIFORM: 
-			std::cout << "> Input data have 'Uniform distribution' with a=" << result.uniform_a << " and b=" << result.uniform_b << std::endl;
-			break;
-		default: "Unknown";
-			break;
+	if (result.best < 0)
+	{
+		std::cout << "> Input data do not match any distribution" << std::endl;
+		return;
+	}
+
+	const SDistribution_fit& fit = result.fits[result.best];
+	const ppr::dist::SDistribution_plugin& dist = ppr::dist::Registry::instance().get(fit.id);
+
+	std::cout << "> Input data have '" << dist.title << "' with ";
+	for (int i = 0; i < dist.param_count; i++)
+	{
+		std::cout << (i == 0 ? "" : " and ") << dist.param_names[i] << "=" << fit.params[i];
 	}
+	std::cout << std::endl;
 }
 
 int main(int argc, char* argv[])
 {
+	// Benchmark mode
+	if (argc > 1 && std::strncmp("bench", argv[1], 5) == 0)
+	{
+		return ppr::bench::run(argc, argv);
+	}
+
+	// Device check mode
+	if (argc > 1 && std::strncmp("check", argv[1], 5) == 0)
+	{
+		return ppr::check::run(argc, argv);
+	}
+
+	// Calibration mode
+	if (argc > 1 && std::strncmp("calibrate", argv[1], 9) == 0)
+	{
+		return ppr::calibration::run(argc, argv);
+	}
+
 	ppr::SConfig conf;
 	bool parse_result = parse_args(argc, argv, conf);
 	if (!parse_result)
@@ -55,13 +80,20 @@ int main(int argc, char* argv[])
 		return ppr::EExitStatus::ARGS;
 	}
 
+	// Auto mode chooses configuration from tuning profile
+	const bool is_auto = conf.mode == ppr::ERun_mode::AUTO;
+	if (is_auto && !ppr::calibration::configure(conf))
+	{
+		return ppr::EExitStatus::ARGS;
+	}
+
 	std::string opt = conf.use_optimalization ? "TRUE" : "FALSE";
 
 	std::cout << "\t\t\t[Initial parameters]" << std::endl;
 	std::cout << "---------------------------------------------------------------------" << std::endl;
 	std::cout << "> File:\t\t\t\t" << argv[1] << std::endl;
-	std::cout << "> Mode:\t\t\t\t" << ppr::print_mode(conf.mode) << std::endl;
-	if (conf.cl_devices_name.size() != 0 && conf.mode == ppr::ERun_mode::CL)
+	std::cout << "> Mode:\t\t\t\t" << ppr::print_mode(conf.mode) << (is_auto ? " (auto)" : "") << std::endl;
+	if (conf.cl_devices_name.size() != 0 && (conf.mode == ppr::ERun_mode::CL || conf.mode == ppr::ERun_mode::ALL))
 	{
 		std::cout << "> Devices:\t\t\t" << std::endl;
 
@@ -72,21 +104,56 @@ int main(int argc, char* argv[])
 	}
 	std::cout << "> Number of threads:\t\t" << conf.thread_count << std::endl;
 	std::cout << "> Optimalization:\t\t" << opt << std::endl;
+	if (conf.numa_node >= 0)
+	{
+		std::cout << "> NUMA node:\t\t\t" << conf.numa_node << std::endl;
+	}
+	if (conf.cpu_share > 0.0)
+	{
+		std::cout << "> CPU share:\t\t\t" << conf.cpu_share << std::endl;
+	}
+	if (conf.window_size > 0)
+	{
+		std::cout << (conf.fixed_window ? "> Fixed window:\t\t\t" : "> First window:\t\t\t") << conf.window_size / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+	std::cout << "> Decision rule:\t\t" << ppr::print_criterion(conf.criterion) << std::endl;
 	std::cout << "> Watchdog timer:\t\t" << conf.watchdog_interval << " sec" << std::endl;
 
 	std::cout << std::endl;
 	std::cout << std::endl;
 	std::cout << "> Started .." << std::endl;
 	std::cout << std::endl;
+	// Cache state of input, which the statistics pass meets
+	const double cached_before = conf.roofline ? ppr::roofline::cached_fraction(conf.input_fn) : -1.0;
+	if (conf.trace_fn)
+	{
+		ppr::trace::enable();
+		ppr::trace::name_thread("main");
+	}
 	SResult result = run(conf);
+
+	// Workers are idle, their buffers can be written
+	const long long trace_events = conf.trace_fn ? ppr::trace::write(conf.trace_fn) : 0;
+	if (trace_events < 0)
+	{
+		ppr::print_error("Cannot write trace '" + std::string(conf.trace_fn) + "'");
+	}
 	std::cout << std::endl;
 
 	std::cout << "\t\t\t[Results]" << std::endl;
 	std::cout << "---------------------------------------------------------------------" << std::endl;
-	std::cout << "> Gauss RSS:\t\t\t" << result.gauss_rss << std::endl;
-	std::cout << "> Poisson RSS:\t\t\t" << result.poisson_rss << std::endl;
-	std::cout << "> Exponential RSS:\t\t" << result.exp_rss << std::endl;
-	std::cout << "> Uniform RSS:\t\t\t" << result.uniform_rss << std::endl;
+	std::cout << ">" << std::setw(12) << "" << std::setw(14) << "RSS" << std::setw(14) << "chi2" << std::setw(14) << "KS" << std::setw(14) << "AD" << std::setw(14) << "KL" << std::endl;
+	for (const auto& fit : result.fits)
+	{
+		// Cancelled run may end before fitting
+		if (fit.id < 0)
+		{
+			continue;
+		}
+
+		std::cout << "> " << std::left << std::setw(11) << ppr::dist::Registry::instance().get(fit.id).label << std::right
+			<< std::setw(14) << fit.rss << std::setw(14) << fit.chi2 << std::setw(14) << fit.ks << std::setw(14) << fit.ad << std::setw(14) << fit.kl << std::endl;
+	}
 
 	std::cout << std::endl;
 	std::cout << std::endl;
@@ -95,9 +162,169 @@ int main(int argc, char* argv[])
 	std::cout << "---------------------------------------------------------------------" << std::endl;
 	std::cout << "> Statistics computing time:\t" << result.total_stat_time << " sec." << std::endl;
 	std::cout << "> Histogram computing time:\t" << result.total_hist_time << " sec." << std::endl;
+	std::cout << "> Fit computing time:\t\t" << result.total_fit_time << " sec." << std::endl;
 	std::cout << "> RSS computing time:\t\t" << result.total_rss_time << " sec." << std::endl;
+	if (result.total_merge_time > 0.0)
+	{
+		std::cout << "> Merge time (serial):\t\t" << result.total_merge_time << " sec." << std::endl;
+	}
 	std::cout << "> TOTAL TIME:\t\t\t" << result.total_time << " sec." << std::endl;
+
+	// Performance counters as 'name=value' pairs, counters, which are not available, are left out
+	for (const SStage_counters& counters : result.stage_counters)
+	{
+		std::cout << "> Counters [" << counters.stage << "]:\t";
+		bool any = false;
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+		{
+			if (counters.values[i] >= 0)
+			{
+				std::cout << (any ? " " : "") << PERF_COUNTER_NAMES[i] << "=" << counters.values[i];
+				any = true;
+			}
+		}
+		if (counters.values[0] > 0 && counters.values[1] >= 0)
+		{
+			std::cout << " ipc=" << static_cast<double>(counters.values[1]) / static_cast<double>(counters.values[0]);
+		}
+		std::cout << (any ? "" : "not available") << std::endl;
+	}
+
+	// Memory high-water marks in MB, values, which are not available, are left out
+	for (const SStage_memory& memory : result.stage_memory)
+	{
+		const std::pair<const char*, long long> values[] = { { "resident", memory.resident }, { "file", memory.file }, { "anonymous", memory.anonymous }, { "mapped", memory.mapped } };
+		std::cout << "> Memory [" << memory.stage << "]:\t";
+		bool any = false;
+		for (const auto& value : values)
+		{
+			if (value.second >= 0)
+			{
+				std::cout << (any ? " " : "") << value.first << "=" << value.second / (1024.0 * 1024.0);
+				any = true;
+			}
+		}
+		std::cout << " MB" << std::endl;
+	}
+	// Kernel updates its high-water mark lazily, samples may be higher
+	long long peak_resident = ppr::memory::peak_resident();
+	for (const SStage_memory& memory : result.stage_memory)
+	{
+		peak_resident = std::max(peak_resident, memory.resident);
+	}
+	if (peak_resident >= 0)
+	{
+		std::cout << "> Peak resident memory:\t\t" << peak_resident / (1024.0 * 1024.0) << " MB" << (peak_resident > ppr::memory::MEMORY_LIMIT_BYTES ? " (over limit)" : "") << std::endl;
+	}
+
+	// Achieved rate of every pass against memory bandwidth (cached input) or storage bandwidth (cold input)
+	if (conf.roofline && result.status == ppr::EExitStatus::SUCCESS)
+	{
+		const ppr::roofline::SRoofline roofline = ppr::roofline::analyze(conf, result, cached_before, ppr::roofline::cached_fraction(conf.input_fn));
+		std::cout << "> Memory bandwidth:\t\t" << roofline.memory.read << " GB/s read, " << roofline.memory.triad << " GB/s triad" << std::endl;
+		if (roofline.storage > 0.0)
+		{
+			std::cout << "> Storage bandwidth:\t\t" << roofline.storage << " GB/s" << std::endl;
+		}
+		for (const ppr::roofline::SPass_roofline& pass : roofline.passes)
+		{
+			std::cout << "> Roofline [" << pass.pass << "]:\t\t" << pass.achieved << " GB/s";
+			if (pass.ceiling > 0.0)
+			{
+				std::cout << " = " << 100.0 * pass.achieved / pass.ceiling << " % of " << pass.ceiling << " GB/s";
+			}
+			if (pass.cached >= 0.0)
+			{
+				std::cout << " (" << 100.0 * pass.cached << " % cached" << (pass.inferred ? ", inferred" : "") << ")";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	if (trace_events > 0)
+	{
+		std::cout << "> Trace:\t\t\t" << conf.trace_fn << " (" << trace_events << " events)" << std::endl;
+	}
+	if (result.checkpoint_count > 0)
+	{
+		const double scan_time = result.total_stat_time + result.total_hist_time;
+		std::cout << "> Checkpoints:\t\t\t" << result.checkpoint_count << " x, " << result.checkpoint_time << " sec. ("
+			<< (scan_time > 0.0 ? 100.0 * result.checkpoint_time / scan_time : 0.0) << " % of scan)" << std::endl;
+	}
+
+	// Adaptive chunk sizing. Consecutive chunks of the same size are printed on one line
+	if (!result.chunk_trace.empty())
+	{
+		std::cout << "> Chunk trace:" << std::endl;
+		for (size_t i = 0; i < result.chunk_trace.size();)
+		{
+			const SChunk_trace& first = result.chunk_trace[i];
+			size_t count = 0;
+			double seconds = 0.0;
+			double megabytes = 0.0;
+
+			for (; i < result.chunk_trace.size() && result.chunk_trace[i].iteration == first.iteration && result.chunk_trace[i].bytes == first.bytes; i++)
+			{
+				count++;
+				seconds += result.chunk_trace[i].seconds;
+				megabytes += static_cast<double>(result.chunk_trace[i].bytes) / (1024.0 * 1024.0);
+			}
+
+			std::cout << ">   " << (first.iteration == EIteration::STAT ? "stat" : "hist") << "\t" << std::setw(6) << count << " x "
+				<< std::setw(10) << static_cast<double>(first.bytes) / (1024.0 * 1024.0) << " MB\t"
+				<< std::setw(10) << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s" << std::endl;
+		}
+	}
+
+	// Work of CPU and OpenCL devices in 'all' and OpenCL modes
+	if (!result.backend_trace.empty())
+	{
+		unsigned long long total = 0;
+		for (const auto& backend : result.backend_trace)
+		{
+			total += backend.count;
+		}
+
+		double build_seconds = 0.0;
+		double saved_seconds = 0.0;
+		for (const auto& backend : result.backend_trace)
+		{
+			build_seconds += backend.build_seconds;
+			saved_seconds += backend.saved_seconds;
+		}
+
+		if (build_seconds > 0.0)
+		{
+			std::cout << "> OpenCL build time:\t\t" << build_seconds << " sec. (" << saved_seconds << " sec. saved by binary cache)" << std::endl;
+		}
+		std::cout << "> Backend work:" << std::endl;
+		for (const auto& backend : result.backend_trace)
+		{
+			const double share = total > 0 ? 100.0 * static_cast<double>(backend.count) / static_cast<double>(total) : 0.0;
+			const double megabytes = static_cast<double>(backend.count * sizeof(double)) / (1024.0 * 1024.0);
+
+			std::cout << ">   " << std::left << std::setw(24) << backend.name << std::right << std::setw(8) << share << " %\t"
+				<< std::setw(10) << (backend.seconds > 0.0 ? megabytes / backend.seconds : 0.0) << " MB/s" << std::endl;
+
+			if (backend.kernel_seconds > 0.0)
+			{
+				std::cout << ">     upload " << backend.upload_seconds << " sec., kernel " << backend.kernel_seconds
+					<< " sec., download " << backend.download_seconds << " sec." << std::endl;
+			}
+			if (!backend.error.empty())
+			{
+				std::cout << ">     disabled: " << backend.error << std::endl;
+			}
+		}
+	}
 	std::cout << std::endl;
+
+	if (result.status != ppr::EExitStatus::SUCCESS)
+	{
+		std::cout << "> Run stopped with exit status " << result.status << " after " << result.processed << " scanned values" << std::endl;
+		return result.status;
+	}
+
 	get_dist_string(result);
 
 	//getchar();
@@ -0,0 +1,134 @@
+#include "include/memory_usage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#else
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace ppr::memory
+{
+	SStage_memory current_usage()
+	{
+		SStage_memory usage;
+#ifdef __linux__
+		// Pages: size resident shared text lib data dt. Shared pages are resident pages of files
+		std::FILE* statm = std::fopen("/proc/self/statm", "r");
+		if (statm == nullptr)
+		{
+			return usage;
+		}
+
+		long long size = 0, resident = 0, shared = 0;
+		if (std::fscanf(statm, "%lld %lld %lld", &size, &resident, &shared) == 3)
+		{
+			const long long page = sysconf(_SC_PAGESIZE);
+			usage.mapped = size * page;
+			usage.resident = resident * page;
+			usage.file = shared * page;
+			usage.anonymous = (resident - shared) * page;
+		}
+		std::fclose(statm);
+#else
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			usage.resident = static_cast<long long>(counters.WorkingSetSize);
+		}
+#endif
+		return usage;
+	}
+
+	long long peak_resident()
+	{
+#ifdef __linux__
+		std::FILE* status = std::fopen("/proc/self/status", "r");
+		if (status == nullptr)
+		{
+			return -1;
+		}
+
+		long long peak = -1;
+		char line[256];
+		while (std::fgets(line, sizeof(line), status))
+		{
+			// High-water mark of resident set in kB
+			if (std::strncmp(line, "VmHWM:", 6) == 0)
+			{
+				peak = std::atoll(line + 6) * 1024;
+				break;
+			}
+		}
+		std::fclose(status);
+		return peak;
+#else
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			return static_cast<long long>(counters.PeakWorkingSetSize);
+		}
+		return -1;
+#endif
+	}
+
+	Memory_sampler::Memory_sampler(const ppr::watchdog::Telemetry& telemetry) : m_telemetry(telemetry)
+	{
+		for (int i = 0; i < MEMORY_STAGE_COUNT; i++)
+		{
+			m_peaks[i].stage = MEMORY_STAGE_NAMES[i];
+		}
+		m_thread = std::thread(&Memory_sampler::run, this);
+	}
+
+	Memory_sampler::~Memory_sampler()
+	{
+		stop();
+	}
+
+	void Memory_sampler::run()
+	{
+		while (m_running.load(std::memory_order_acquire))
+		{
+			const int stage = m_telemetry.get_stage();
+			if (stage >= 0 && stage < MEMORY_STAGE_COUNT)
+			{
+				const SStage_memory usage = current_usage();
+				SStage_memory& peak = m_peaks[stage];
+
+				peak.resident = std::max(peak.resident, usage.resident);
+				peak.file = std::max(peak.file, usage.file);
+				peak.anonymous = std::max(peak.anonymous, usage.anonymous);
+				peak.mapped = std::max(peak.mapped, usage.mapped);
+				m_sampled[stage] = true;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(MEMORY_SAMPLE_MILLISECONDS));
+		}
+	}
+
+	std::vector<SStage_memory> Memory_sampler::stop()
+	{
+		m_running.store(false, std::memory_order_release);
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+
+		std::vector<SStage_memory> peaks;
+		for (int i = 0; i < MEMORY_STAGE_COUNT; i++)
+		{
+			if (m_sampled[i])
+			{
+				peaks.push_back(m_peaks[i]);
+			}
+		}
+		return peaks;
+	}
+}
@@ -0,0 +1,182 @@
+#include "include/perf_counters.h"
+#include <atomic>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace ppr::perf
+{
+#ifdef __linux__
+	struct SThread_counters
+	{
+		int fds[PERF_COUNTER_COUNT];
+	};
+
+	/// <summary>
+	/// Counter value with PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+	/// </summary>
+	struct SCounter_reading
+	{
+		unsigned long long value;
+		unsigned long long time_enabled;
+		unsigned long long time_running;
+	};
+
+	/// <summary>
+	/// Event type and configuration of every counter (index = PERF_COUNTER_NAMES)
+	/// </summary>
+	static const std::pair<unsigned int, unsigned long long> PERF_EVENTS[PERF_COUNTER_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN },
+		{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES }
+	};
+
+	/// <summary>
+	/// Open counter of calling thread on any processor
+	/// </summary>
+	/// <returns>File descriptor (-1 = not available, e.g. in virtual machine)</returns>
+	static int open_counter(unsigned int type, unsigned long long config)
+	{
+		perf_event_attr attr{};
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+
+		// User space only, so that 'perf_event_paranoid' 2 allows it
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// PMU multiplexes more hardware events than it has registers, times of the counter scale its value
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+#else
+	struct SThread_counters
+	{
+		HANDLE thread;
+	};
+#endif
+
+	// Counters objects of the process, thread registers once in every object
+	static std::atomic<unsigned long long> last_id(0);
+	static thread_local unsigned long long registered_id = 0;
+
+	Perf_counters::Perf_counters(tbb::task_arena& arena) : tbb::task_scheduler_observer(arena), m_id(++last_id)
+	{
+		observe(true);
+	}
+
+	Perf_counters::~Perf_counters()
+	{
+		observe(false);
+
+		for (auto& counters : m_threads)
+		{
+#ifdef __linux__
+			for (int fd : counters->fds)
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+#else
+			CloseHandle(counters->thread);
+#endif
+		}
+	}
+
+	void Perf_counters::on_scheduler_entry(bool)
+	{
+		if (registered_id == m_id)
+		{
+			return;
+		}
+		registered_id = m_id;
+
+		auto counters = std::make_unique<SThread_counters>();
+#ifdef __linux__
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+		{
+			counters->fds[i] = open_counter(PERF_EVENTS[i].first, PERF_EVENTS[i].second);
+		}
+#else
+		counters->thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#endif
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_threads.push_back(std::move(counters));
+	}
+
+	Counter_values Perf_counters::read()
+	{
+		Counter_values values;
+		values.fill(-1);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& counters : m_threads)
+		{
+#ifdef __linux__
+			for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			{
+				SCounter_reading reading{};
+				if (counters->fds[i] < 0 || ::read(counters->fds[i], &reading, sizeof(reading)) != sizeof(reading))
+				{
+					continue;
+				}
+
+				// Counter, which was never on the PMU, has no estimate
+				if (reading.time_running == 0)
+				{
+					continue;
+				}
+
+				long long value = static_cast<long long>(reading.value);
+				if (reading.time_running < reading.time_enabled)
+				{
+					value = static_cast<long long>(static_cast<double>(reading.value) * static_cast<double>(reading.time_enabled) / static_cast<double>(reading.time_running));
+				}
+				values[i] = (values[i] < 0 ? 0 : values[i]) + value;
+			}
+#else
+			ULONG64 cycles = 0;
+			if (counters->thread != NULL && QueryThreadCycleTime(counters->thread, &cycles))
+			{
+				values[0] = (values[0] < 0 ? 0 : values[0]) + static_cast<long long>(cycles);
+			}
+#endif
+		}
+
+#ifndef __linux__
+		// Windows counts soft and hard page faults of the whole process together
+		PROCESS_MEMORY_COUNTERS memory{};
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+		{
+			values[5] = static_cast<long long>(memory.PageFaultCount);
+		}
+#endif
+
+		return values;
+	}
+
+	Counter_values difference(const Counter_values& begin, const Counter_values& end)
+	{
+		Counter_values values;
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+		{
+			values[i] = begin[i] < 0 || end[i] < 0 ? -1 : end[i] - begin[i];
+		}
+		return values;
+	}
+}
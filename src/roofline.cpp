@@ -0,0 +1,284 @@
+#include "include/roofline.h"
+#include "include/calibration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/partitioner.h>
+#include <tbb/tick_count.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#undef min
+#undef max
+
+namespace ppr::roofline
+{
+	/// <summary>
+	/// Best time of STREAM_REPEAT runs of kernel over all arrays
+	/// </summary>
+	/// <typeparam name="Body">- Kernel of one range</typeparam>
+	/// <param name="arena">- TBB arena</param>
+	/// <param name="body">- Kernel of one range</param>
+	/// <returns>Seconds</returns>
+	template <typename Body>
+	static double best_time(tbb::task_arena& arena, Body body)
+	{
+		double best = std::numeric_limits<double>::max();
+		tbb::static_partitioner partitioner;
+
+		for (int r = 0; r < STREAM_REPEAT; r++)
+		{
+			tbb::tick_count t0 = tbb::tick_count::now();
+			arena.execute([&]() {
+				tbb::parallel_for(tbb::blocked_range<long long>(0, STREAM_COUNT), body, partitioner);
+				});
+			best = std::min(best, (tbb::tick_count::now() - t0).seconds());
+		}
+
+		return best;
+	}
+
+	SStream measure_stream(tbb::task_arena& arena)
+	{
+		std::unique_ptr<double[]> a(new double[STREAM_COUNT]);
+		std::unique_ptr<double[]> b(new double[STREAM_COUNT]);
+		std::unique_ptr<double[]> c(new double[STREAM_COUNT]);
+		const double scalar = 3.0;
+		const double bytes = static_cast<double>(STREAM_COUNT * sizeof(double)) / 1e9;
+
+		// First touch from the same threads as kernels
+		best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			for (long long i = r.begin(); i < r.end(); i++)
+			{
+				a[i] = 1.0;
+				b[i] = 2.0;
+				c[i] = 0.0;
+			}
+			});
+
+		SStream stream;
+		std::atomic<double> sink{ 0.0 };
+		stream.read = bytes / best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			// Independent sums, so that latency of addition does not hide bandwidth
+			double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+			long long i = r.begin();
+			for (; i + 4 <= r.end(); i += 4)
+			{
+				sum[0] += a[i];
+				sum[1] += a[i + 1];
+				sum[2] += a[i + 2];
+				sum[3] += a[i + 3];
+			}
+			for (; i < r.end(); i++)
+			{
+				sum[0] += a[i];
+			}
+			sink.store(sum[0] + sum[1] + sum[2] + sum[3], std::memory_order_relaxed);
+			});
+		stream.copy = 2 * bytes / best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			for (long long i = r.begin(); i < r.end(); i++)
+			{
+				c[i] = a[i];
+			}
+			});
+		stream.scale = 2 * bytes / best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			for (long long i = r.begin(); i < r.end(); i++)
+			{
+				b[i] = scalar * c[i];
+			}
+			});
+		stream.add = 3 * bytes / best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			for (long long i = r.begin(); i < r.end(); i++)
+			{
+				c[i] = a[i] + b[i];
+			}
+			});
+		stream.triad = 3 * bytes / best_time(arena, [&](const tbb::blocked_range<long long>& r) {
+			for (long long i = r.begin(); i < r.end(); i++)
+			{
+				a[i] = b[i] + scalar * c[i];
+			}
+			});
+
+		return stream;
+	}
+
+	double measure_sequential_read(const char* file_name)
+	{
+		unsigned long long bytes = 0;
+		tbb::tick_count t0 = tbb::tick_count::now();
+#ifdef __linux__
+		const int fd = open(file_name, O_RDONLY | O_DIRECT);
+		if (fd < 0)
+		{
+			return 0.0;
+		}
+
+		// Direct reads need sector aligned buffer
+		void* buffer = nullptr;
+		if (posix_memalign(&buffer, 4096, IO_PROBE_BLOCK) != 0)
+		{
+			close(fd);
+			return 0.0;
+		}
+
+		t0 = tbb::tick_count::now();
+		while (bytes < IO_PROBE_BYTES)
+		{
+			const ssize_t count = read(fd, buffer, IO_PROBE_BLOCK);
+			if (count <= 0)
+			{
+				break;
+			}
+			bytes += static_cast<unsigned long long>(count);
+		}
+
+		free(buffer);
+		close(fd);
+#else
+		HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return 0.0;
+		}
+
+		// Unbuffered reads need sector aligned buffer, pages are aligned
+		void* buffer = VirtualAlloc(NULL, IO_PROBE_BLOCK, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		if (buffer == NULL)
+		{
+			CloseHandle(file);
+			return 0.0;
+		}
+
+		t0 = tbb::tick_count::now();
+		while (bytes < IO_PROBE_BYTES)
+		{
+			DWORD count = 0;
+			if (!ReadFile(file, buffer, static_cast<DWORD>(IO_PROBE_BLOCK), &count, NULL) || count == 0)
+			{
+				break;
+			}
+			bytes += count;
+		}
+
+		VirtualFree(buffer, 0, MEM_RELEASE);
+		CloseHandle(file);
+#endif
+		const double seconds = (tbb::tick_count::now() - t0).seconds();
+		return bytes > 0 && seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e9 : 0.0;
+	}
+
+	double cached_fraction(const char* file_name)
+	{
+#ifdef __linux__
+		const int fd = open(file_name, O_RDONLY);
+		if (fd < 0)
+		{
+			return -1.0;
+		}
+
+		struct stat info {};
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			close(fd);
+			return -1.0;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (view == MAP_FAILED)
+		{
+			return -1.0;
+		}
+
+		// One byte per page, the lowest bit is set for resident pages
+		const long long page = sysconf(_SC_PAGESIZE);
+		std::vector<unsigned char> pages((info.st_size + page - 1) / page);
+		double fraction = -1.0;
+		if (mincore(view, static_cast<size_t>(info.st_size), pages.data()) == 0)
+		{
+			const long long resident = std::count_if(pages.begin(), pages.end(), [](unsigned char p) { return (p & 1) != 0; });
+			fraction = static_cast<double>(resident) / static_cast<double>(pages.size());
+		}
+
+		munmap(view, static_cast<size_t>(info.st_size));
+		return fraction;
+#else
+		// Windows does not tell, which file pages are in standby list
+		return -1.0;
+#endif
+	}
+
+	SRoofline analyze(const SConfig& configuration, const SResult& result, double cached_before, double cached_after)
+	{
+		SRoofline roofline;
+
+		// Profiles calibrated before the STREAM probe have no triad and wrong bandwidth
+		ppr::calibration::SProfile profile;
+		ppr::calibration::load_profile(profile, ppr::calibration::PROFILE_FILE);
+		if (profile.memory_triad > 0.0)
+		{
+			roofline.memory.read = profile.memory_bandwidth;
+			roofline.memory.triad = profile.memory_triad;
+		}
+		else
+		{
+			tbb::task_arena arena(configuration.thread_count == 0 ? tbb::task_arena::automatic : static_cast<int>(configuration.thread_count));
+			roofline.memory = measure_stream(arena);
+		}
+		roofline.storage = profile.storage_bandwidth > 0.0 ? profile.storage_bandwidth : measure_sequential_read(configuration.input_fn);
+
+		std::ifstream file(configuration.input_fn, std::ios::binary | std::ios::ate);
+		const double file_gb = static_cast<double>(file.tellg()) / 1e9;
+
+		const std::pair<double, double> passes[] = { { result.total_stat_time, cached_before }, { result.total_hist_time, cached_after } };
+		const char* names[] = { "stat", "hist" };
+		for (int i = 0; i < 2; i++)
+		{
+			if (passes[i].first <= 0.0 || file_gb <= 0.0)
+			{
+				continue;
+			}
+
+			SPass_roofline pass;
+			pass.pass = names[i];
+			pass.achieved = file_gb / passes[i].first;
+			pass.cached = passes[i].second;
+
+			// Scan faster than storage must come from page cache
+			if (pass.cached < 0.0 && roofline.storage > 0.0)
+			{
+				pass.cached = pass.achieved > WARM_RATE_FACTOR * roofline.storage ? 1.0 : 0.0;
+				pass.inferred = true;
+			}
+
+			// Cached pages are read at memory bandwidth, the rest at storage bandwidth
+			const double memory = roofline.memory.read;
+			if (pass.cached >= 1.0 || roofline.storage <= 0.0)
+			{
+				pass.ceiling = memory;
+			}
+			else if (memory > 0.0)
+			{
+				pass.ceiling = 1.0 / (pass.cached / memory + (1.0 - pass.cached) / roofline.storage);
+			}
+
+			roofline.passes.push_back(pass);
+		}
+
+		return roofline;
+	}
+}
@@ -1,5 +1,8 @@
+
 #include <cmath>
 #include <iostream>
+#include <algorithm>
+#include <vector>
 
 #undef min
 #undef max
@@ -10,12 +13,206 @@ namespace ppr::rss
 {
 	constexpr double M_PI = 3.14159265358979323846;
 	constexpr double DOUBLE_PI = (2 * M_PI);
+	constexpr double INV_SQRT_DOUBLE_PI = 0.39894228040143267794;
+	constexpr double INV_SQRT_2 = 0.70710678118654752440;
+
+	/// <summary>
+	/// Number of bins evaluated in one batch. Batch buffers live on the stack, so keep it small enough for L1 cache
+	/// </summary>
+	constexpr std::size_t RSS_BATCH_SIZE = 512;
+
+	/// <summary>
+	/// Size of cached log-factorial table [log(0!), log(1!), ...]. Bigger values are computed with lgamma()
+	/// </summary>
+	constexpr std::size_t LOG_FACTORIAL_TABLE_SIZE = 4096;
+
+	/// <summary>
+	/// Cached table of log(k!) for k < LOG_FACTORIAL_TABLE_SIZE. Created once on first use
+	/// </summary>
+	/// <returns>Table pointer</returns>
+	inline const double* log_factorial_table()
+	{
+		static const std::vector<double> table = []() {
+			std::vector<double> t(LOG_FACTORIAL_TABLE_SIZE);
+			for (std::size_t k = 0; k < LOG_FACTORIAL_TABLE_SIZE; k++)
+			{
+				t[k] = std::lgamma(static_cast<double>(k) + 1.0);
+			}
+			return t;
+		}();
+
+		return table.data();
+	}
+
+	/// <summary>
+	/// log(k!) for any non-negative integer k
+	/// </summary>
+	/// <param name="k">- Non-negative integer</param>
+	/// <returns>log(k!)</returns>
+	inline double log_factorial(double k)
+	{
+		return k < LOG_FACTORIAL_TABLE_SIZE ? log_factorial_table()[static_cast<std::size_t>(k)] : std::lgamma(k + 1.0);
+	}
+
+	/// <summary>
+	/// Maximum number of iterations of series and continued fractions of incomplete gamma/beta functions
+	/// </summary>
+	constexpr int SPECIAL_FUNCTION_MAX_ITERATIONS = 500;
+
+	/// <summary>
+	/// Additional iterations of incomplete gamma function per sqrt(a). Near x = a the series and continued fraction
+	/// converge in about 7.5 * sqrt(a) iterations (P(a + 1, a) needs 7400 iterations for a = 10^6)
+	/// </summary>
+	constexpr double GAMMA_ITERATIONS_PER_SQRT_SHAPE = 10.0;
+
+	/// <summary>
+	/// Smallest shape, whose prefix of incomplete gamma function is computed from Stirling series. Prefix a * log(x) - x - lgamma(a)
+	/// of big shape is a difference of big numbers (10^13 for a = 10^12), which loses most digits of the result
+	/// </summary>
+	constexpr double GAMMA_STIRLING_MIN_SHAPE = 100.0;
+
+	/// <summary>
+	/// Relative precision of series and continued fractions of incomplete gamma/beta functions
+	/// </summary>
+	constexpr double SPECIAL_FUNCTION_EPS = 1e-15;
+
+	/// <summary>
+	/// Regularized lower incomplete gamma function P(a, x). Series for x < a + 1, continued fraction (Lentz) otherwise
+	/// </summary>
+	/// <param name="a">- Positive shape</param>
+	/// <param name="x">- Non-negative argument</param>
+	/// <returns>P(a, x)</returns>
+	inline double regularized_gamma_p(double a, double x)
+	{
+		if (x <= 0.0)
+			return 0.0;
 
+		double log_prefix;
+		if (a < GAMMA_STIRLING_MIN_SHAPE)
+		{
+			log_prefix = (a * std::log(x)) - x - std::lgamma(a);
+		}
+		else
+		{
+			// lgamma(a) = (a - 1/2) log(a) - a + log(2 pi) / 2 + 1 / (12 a) - 1 / (360 a^3) + 1 / (1260 a^5) - ...
+			const double t = (x - a) / a;
+			const double inv_a2 = 1.0 / (a * a);
+			const double stirling = (1.0 / 12.0 - inv_a2 * (1.0 / 360.0 - inv_a2 / 1260.0)) / a;
+			log_prefix = (a * (std::log1p(t) - t)) + (0.5 * std::log(a / DOUBLE_PI)) - stirling;
+		}
+
+		const int max_iterations = SPECIAL_FUNCTION_MAX_ITERATIONS + static_cast<int>(GAMMA_ITERATIONS_PER_SQRT_SHAPE * std::sqrt(a));
+
+		if (x < a + 1.0)
+		{
+			double term = 1.0 / a;
+			double sum = term;
+			for (int n = 1; n < max_iterations; n++)
+			{
+				term *= x / (a + n);
+				sum += term;
+				if (std::abs(term) < std::abs(sum) * SPECIAL_FUNCTION_EPS)
+					break;
+			}
+			return std::min(1.0, sum * std::exp(log_prefix));
+		}
+
+		constexpr double TINY = 1e-300;
+		double b = x + 1.0 - a;
+		double c = 1.0 / TINY;
+		double d = 1.0 / b;
+		double h = d;
+		for (int n = 1; n < max_iterations; n++)
+		{
+			const double an = -n * (n - a);
+			b += 2.0;
+			d = (an * d) + b;
+			d = std::abs(d) < TINY ? TINY : d;
+			c = b + (an / c);
+			c = std::abs(c) < TINY ? TINY : c;
+			d = 1.0 / d;
+			const double delta = d * c;
+			h *= delta;
+			if (std::abs(delta - 1.0) < SPECIAL_FUNCTION_EPS)
+				break;
+		}
+		return std::max(0.0, 1.0 - (std::exp(log_prefix) * h));
+	}
+
+	/// <summary>
+	/// Continued fraction of incomplete beta function (modified Lentz)
+	/// </summary>
+	inline double incomplete_beta_cf(double a, double b, double x)
+	{
+		constexpr double TINY = 1e-300;
+		const double qab = a + b;
+		const double qap = a + 1.0;
+		const double qam = a - 1.0;
+		double c = 1.0;
+		double d = 1.0 - (qab * x / qap);
+		d = std::abs(d) < TINY ? TINY : d;
+		d = 1.0 / d;
+		double h = d;
+
+		for (int m = 1; m < SPECIAL_FUNCTION_MAX_ITERATIONS; m++)
+		{
+			const int m2 = 2 * m;
+			double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+			d = 1.0 + (aa * d);
+			d = std::abs(d) < TINY ? TINY : d;
+			c = 1.0 + (aa / c);
+			c = std::abs(c) < TINY ? TINY : c;
+			d = 1.0 / d;
+			h *= d * c;
+
+			aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+			d = 1.0 + (aa * d);
+			d = std::abs(d) < TINY ? TINY : d;
+			c = 1.0 + (aa / c);
+			c = std::abs(c) < TINY ? TINY : c;
+			d = 1.0 / d;
+			const double delta = d * c;
+			h *= delta;
+			if (std::abs(delta - 1.0) < SPECIAL_FUNCTION_EPS)
+				break;
+		}
+
+		return h;
+	}
+
+	/// <summary>
+	/// Regularized incomplete beta function I_x(a, b)
+	/// </summary>
+	/// <param name="a">- Positive shape</param>
+	/// <param name="b">- Positive shape</param>
+	/// <param name="x">- Argument</param>
+	/// <returns>I_x(a, b)</returns>
+	inline double regularized_beta(double a, double b, double x)
+	{
+		if (x <= 0.0)
+			return 0.0;
+		if (x >= 1.0)
+			return 1.0;
+
+		const double log_front = std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + (a * std::log(x)) + (b * std::log1p(-x));
+
+		// Continued fraction converges quickly for x < (a + 1) / (a + b + 2), otherwise symmetry is used
+		if (x < (a + 1.0) / (a + b + 2.0))
+			return std::exp(log_front) * incomplete_beta_cf(a, b, x) / a;
+
+		return 1.0 - (std::exp(log_front) * incomplete_beta_cf(b, a, 1.0 - x) / b);
+	}
+
+	/// <summary>
+	/// Base class of all distributions. Uses CRTP, so Pdf() of derived class is inlined into batch loops
+	/// </summary>
+	/// <typeparam name="T">- Derived distribution class</typeparam>
+	template <typename T>
 	class Distribution
 	{
 		protected:
 			double m_rss, m_mean, m_stddev;
-		
+
 		public:
 
 			Distribution() : m_rss(0.0), m_mean(0.0), m_stddev(0.0)
@@ -24,35 +221,98 @@ namespace ppr::rss
 			Distribution(double mean, double stdev) : m_rss(0.0), m_mean(mean), m_stddev(stdev)
 			{}
 
-			virtual double Pdf(double) { return 0.0; }
+			/// <summary>
+			/// Evaluate PDF for bins [first_bin + i * bin_size] and store it into output array
+			/// </summary>
+			/// <param name="first_bin">- Left edge of first bin</param>
+			/// <param name="bin_size">- Bin size</param>
+			/// <param name="out">- Output array</param>
+			/// <param name="count">- Bin count</param>
+			void Pdf_batch(double first_bin, double bin_size, double* out, std::size_t count) const
+			{
+				const T& dist = static_cast<const T&>(*this);
+
+				if (m_stddev == 0.0 && m_mean == 0.0)
+				{
+					#pragma loop(ivdep)
+					for (std::size_t i = 0; i < count; i++)
+					{
+						out[i] = dist.Pdf(first_bin + (static_cast<double>(i) * bin_size));
+					}
+				}
+				else
+				{
+					const double inv_stddev = 1.0 / m_stddev;
+					const double y0 = (first_bin - m_mean) * inv_stddev;
+					const double dy = bin_size * inv_stddev;
+
+					#pragma loop(ivdep)
+					for (std::size_t i = 0; i < count; i++)
+					{
+						out[i] = dist.Pdf(y0 + (static_cast<double>(i) * dy)) * inv_stddev;
+					}
+				}
+			}
+
+			/// <summary>
+			/// Evaluate CDF in edges [first_edge + i * bin_size] and store it into output array
+			/// </summary>
+			/// <param name="first_edge">- First bin edge</param>
+			/// <param name="bin_size">- Bin size</param>
+			/// <param name="out">- Output array</param>
+			/// <param name="count">- Edge count</param>
+			void Cdf_batch(double first_edge, double bin_size, double* out, std::size_t count) const
+			{
+				const T& dist = static_cast<const T&>(*this);
+
+				if (m_stddev == 0.0 && m_mean == 0.0)
+				{
+					for (std::size_t i = 0; i < count; i++)
+					{
+						out[i] = dist.Cdf(first_edge + (static_cast<double>(i) * bin_size));
+					}
+				}
+				else
+				{
+					const double inv_stddev = 1.0 / m_stddev;
+					const double y0 = (first_edge - m_mean) * inv_stddev;
+					const double dy = bin_size * inv_stddev;
+
+					for (std::size_t i = 0; i < count; i++)
+					{
+						out[i] = dist.Cdf(y0 + (static_cast<double>(i) * dy));
+					}
+				}
+			}
 
 			void Push(double density_x, double bin)
 			{
 				double pdf = 0.0;
-				double tmp = 0.0;
 
 				if (m_stddev == 0.0 && m_mean == 0.0)
 				{
-					pdf = Pdf(bin);
-					double val = pow(density_x - pdf, 2);
-					tmp = m_rss + val;
+					pdf = static_cast<const T&>(*this).Pdf(bin);
 				}
 				else
 				{
 					double y = (bin - m_mean) / m_stddev;
-					pdf = Pdf(y) / m_stddev;
-
-					double val = pow(density_x - pdf, 2);
-					tmp = m_rss + val;
+					pdf = static_cast<const T&>(*this).Pdf(y) / m_stddev;
 				}
-				m_rss = tmp;
+
+				const double diff = density_x - pdf;
+				m_rss += diff * diff;
+			}
+
+			void Clear()
+			{
+				m_rss = 0.0;
 			}
 
 			double Get_RSS() const
 			{
 				return m_rss;
 			}
-			
+
 			void Add_RSS(double rss)
 			{
 				m_rss += rss;
@@ -60,111 +320,384 @@ namespace ppr::rss
 	};
 
 
-	class NormalDistribution : public Distribution
+	class NormalDistribution : public Distribution<NormalDistribution>
 	{
 		public:
 			using Distribution::Distribution;
 
-			double Pdf(double x) override
+			double Pdf(double x) const
 			{
-				return exp(-pow(x, 2) / 2.0) / sqrt(DOUBLE_PI);
+				return exp(-0.5 * x * x) * INV_SQRT_DOUBLE_PI;
+			}
+
+			double Cdf(double x) const
+			{
+				return 0.5 * std::erfc(-x * INV_SQRT_2);
 			}
 	};
 
-	class ExponentialDistribution : public Distribution
+	class ExponentialDistribution : public Distribution<ExponentialDistribution>
 	{
 		public:
 			using Distribution::Distribution;
 
-			virtual double Pdf(double x) override
+			double Pdf(double x) const
 			{
-				if (x >= 0.0)
-					return exp(-x);
-				else
-					return 0.0;
+				return x >= 0.0 ? exp(-x) : 0.0;
+			}
+
+			double Cdf(double x) const
+			{
+				return x > 0.0 ? -std::expm1(-x) : 0.0;
 			}
 	};
 
-	class UniformDistribution : public Distribution
+	class UniformDistribution : public Distribution<UniformDistribution>
 	{
-		private:
-			double A, B;
-
 		public:
 			using Distribution::Distribution;
 
-			double Pdf(double) override
+			double Pdf(double) const
 			{
 				return 1.0;
 			}
+
+			double Cdf(double x) const
+			{
+				return x <= 0.0 ? 0.0 : x >= 1.0 ? 1.0 : x;
+			}
 	};
 
-	class PoissonDistribution : public Distribution
+	/// <summary>
+	/// Poisson PMF is evaluated in log space: log p(k) = k * log(mu) - mu - log(k!), so it does not overflow for big k and mu
+	/// </summary>
+	class PoissonDistribution : public Distribution<PoissonDistribution>
 	{
 		private:
 			double Mu;
+			double LogMu;
+
+		public:
+			PoissonDistribution(double mu)
+				: Mu(mu), LogMu(mu > 0.0 ? std::log(mu) : 0.0)
+			{}
+
+			double Pdf(double x) const
+			{
+				if (x < 0.0)
+					return 0.0;
+
+				const double k = std::floor(x);
+				if (Mu <= 0.0)
+					return k == 0.0 ? 1.0 : 0.0;
+
+				return std::exp((k * LogMu) - Mu - log_factorial(k));
+			}
+
+			/// <summary>
+			/// P(X < x) = P(X <= ceil(x) - 1) = Q(ceil(x), mu)
+			/// </summary>
+			double Cdf(double x) const
+			{
+				const double k = std::ceil(x);
+				if (k <= 0.0)
+					return 0.0;
+				if (Mu <= 0.0)
+					return 1.0;
+
+				return 1.0 - regularized_gamma_p(k, Mu);
+			}
 
-			double Factorial(double n)
+			/// <summary>
+			/// Evaluate CDF in edges [first_edge + i * bin_size]. Integer edges (bin_size = 1) use one incomplete gamma
+			/// function and prefix sum of PMF for the rest
+			/// </summary>
+			/// <param name="first_edge">- First bin edge</param>
+			/// <param name="bin_size">- Bin size</param>
+			/// <param name="out">- Output array</param>
+			/// <param name="count">- Edge count (not bigger than RSS_BATCH_SIZE)</param>
+			void Cdf_batch(double first_edge, double bin_size, double* out, std::size_t count) const
 			{
-				double factorial = 1.0;
-				for (int i = 1; i <= n; ++i) {
-					factorial *= i;
+				if (bin_size != 1.0 || first_edge < 0.0 || std::floor(first_edge) != first_edge || Mu <= 0.0)
+				{
+					Distribution::Cdf_batch(first_edge, bin_size, out, count);
+					return;
+				}
+
+				double pmf[RSS_BATCH_SIZE];
+				Pdf_batch(first_edge, 1.0, pmf, count);
+
+				out[0] = Cdf(first_edge);
+				for (std::size_t i = 1; i < count; i++)
+				{
+					out[i] = std::min(1.0, out[i - 1] + pmf[i - 1]);
 				}
-				return factorial;
 			}
 
+			/// <summary>
+			/// Evaluate PMF for bins [first_bin + i * bin_size]. Integer histogram (bin_size = 1) uses cached log-factorial table
+			/// for small k and recurrence log((k + 1)!) = log(k!) + log(k + 1) for the rest, so there is only one lgamma() per batch
+			/// </summary>
+			/// <param name="first_bin">- Left edge of first bin</param>
+			/// <param name="bin_size">- Bin size</param>
+			/// <param name="out">- Output array</param>
+			/// <param name="count">- Bin count (not bigger than RSS_BATCH_SIZE)</param>
+			void Pdf_batch(double first_bin, double bin_size, double* out, std::size_t count) const
+			{
+				if (bin_size != 1.0 || first_bin < 0.0 || std::floor(first_bin) != first_bin || Mu <= 0.0)
+				{
+					Distribution::Pdf_batch(first_bin, bin_size, out, count);
+					return;
+				}
+
+				double log_fact[RSS_BATCH_SIZE];
+				const double log_norm = -Mu;
+
+				if (first_bin + static_cast<double>(count) <= LOG_FACTORIAL_TABLE_SIZE)
+				{
+					const double* table = log_factorial_table() + static_cast<std::size_t>(first_bin);
+
+					#pragma loop(ivdep)
+					for (std::size_t i = 0; i < count; i++)
+					{
+						log_fact[i] = table[i];
+					}
+				}
+				else
+				{
+					// Logarithms are vectorized, only prefix sum is sequential
+					#pragma loop(ivdep)
+					for (std::size_t i = 0; i < count; i++)
+					{
+						log_fact[i] = std::log(first_bin + static_cast<double>(i));
+					}
+
+					log_fact[0] = log_factorial(first_bin);
+					for (std::size_t i = 1; i < count; i++)
+					{
+						log_fact[i] += log_fact[i - 1];
+					}
+				}
+
+				#pragma loop(ivdep)
+				for (std::size_t i = 0; i < count; i++)
+				{
+					const double k = first_bin + static_cast<double>(i);
+					out[i] = std::exp((k * LogMu) + log_norm - log_fact[i]);
+				}
+			}
+	};
+
+	/// <summary>
+	/// Geometric distribution (number of failures before first success) on support {0, 1, ...}
+	/// </summary>
+	class GeometricDistribution : public Distribution<GeometricDistribution>
+	{
+		private:
+			double LogP;
+			double Log1mP;
+
 		public:
-			PoissonDistribution(double mu)
-				: Mu(mu)
+			GeometricDistribution(double p)
+				: LogP(std::log(p)), Log1mP(std::log1p(-p))
 			{}
 
-			double Pdf(double x) override
+			double Pdf(double x) const
 			{
-				if (x >= 0.0)
-					return exp(-Mu) * pow(Mu, x) / Factorial(x);
-				else
+				return x >= 0.0 ? std::exp(LogP + (std::floor(x) * Log1mP)) : 0.0;
+			}
+
+			/// <summary>
+			/// P(X < x) = 1 - (1 - p)^ceil(x)
+			/// </summary>
+			double Cdf(double x) const
+			{
+				const double k = std::ceil(x);
+				return k > 0.0 ? -std::expm1(k * Log1mP) : 0.0;
+			}
+	};
+
+	/// <summary>
+	/// Binomial distribution with N trials on support {0, 1, ..., N}. PMF is evaluated in log space
+	/// </summary>
+	class BinomialDistribution : public Distribution<BinomialDistribution>
+	{
+		private:
+			double N;
+			double P;
+			double LogP;
+			double Log1mP;
+			double LogNFact;
+
+		public:
+			BinomialDistribution(double n, double p)
+				: N(n), P(p), LogP(std::log(p)), Log1mP(std::log1p(-p)), LogNFact(log_factorial(n))
+			{}
+
+			double Pdf(double x) const
+			{
+				const double k = std::floor(x);
+				if (k < 0.0 || k > N)
+					return 0.0;
+
+				return std::exp(LogNFact - log_factorial(k) - log_factorial(N - k) + (k * LogP) + ((N - k) * Log1mP));
+			}
+
+			/// <summary>
+			/// P(X < x) = P(X <= m) = I_(1 - p)(N - m, m + 1) with m = ceil(x) - 1
+			/// </summary>
+			double Cdf(double x) const
+			{
+				const double m = std::ceil(x) - 1.0;
+				if (m < 0.0)
 					return 0.0;
+				if (m >= N)
+					return 1.0;
+
+				return regularized_beta(N - m, m + 1.0, 1.0 - P);
 			}
 	};
 
-	class RSSParallel {
+	/// <summary>
+	/// Log-normal distribution: log(x) ~ N(mu, sigma^2)
+	/// </summary>
+	class LogNormalDistribution : public Distribution<LogNormalDistribution>
+	{
+		private:
+			double Mu;
+			double InvSigma;
+
+		public:
+			LogNormalDistribution(double mu, double sigma)
+				: Mu(mu), InvSigma(1.0 / sigma)
+			{}
 
-	private:
-		ppr::rss::Distribution* m_dist;
-		std::vector<double> m_bucketDensity;
-		double m_bin_size;
+			double Pdf(double x) const
+			{
+				if (x <= 0.0)
+					return 0.0;
 
-	public:
+				const double z = (std::log(x) - Mu) * InvSigma;
+				return std::exp(-0.5 * z * z) * INV_SQRT_DOUBLE_PI * InvSigma / x;
+			}
 
-		RSSParallel(ppr::rss::Distribution* dist, std::vector<double>& bucketDensity, double bin_size)
-			: m_dist(dist), m_bucketDensity(bucketDensity), m_bin_size(bin_size)
-		{}
+			double Cdf(double x) const
+			{
+				if (x <= 0.0)
+					return 0.0;
 
-		RSSParallel(RSSParallel& x, tbb::split)
-		{
-			m_dist = x.m_dist;
-			m_bucketDensity = x.m_bucketDensity;
-			m_bin_size = x.m_bin_size;
-		}
+				return 0.5 * std::erfc(-(std::log(x) - Mu) * InvSigma * INV_SQRT_2);
+			}
+	};
 
-		void operator()(const tbb::blocked_range<size_t>& r)
-		{
-			ppr::rss::Distribution* t_dist = m_dist;    // to not discard earlier accumulations
+	/// <summary>
+	/// Gamma distribution with shape K and scale Theta. PDF is evaluated in log space
+	/// </summary>
+	class GammaDistribution : public Distribution<GammaDistribution>
+	{
+		private:
+			double K;
+			double InvTheta;
+			double LogNorm;
+
+		public:
+			GammaDistribution(double k, double theta)
+				: K(k), InvTheta(1.0 / theta), LogNorm(-std::lgamma(k) - (k * std::log(theta)))
+			{}
+
+			double Pdf(double x) const
+			{
+				if (x <= 0.0)
+					return 0.0;
+
+				return std::exp(((K - 1.0) * std::log(x)) - (x * InvTheta) + LogNorm);
+			}
 
-			#pragma loop(ivdep)
-			for (size_t i = r.begin(); i != r.end(); ++i)
+			double Cdf(double x) const
 			{
-				double d = (double)m_bucketDensity[i];
-				m_dist->Push(d, (static_cast<double>(i) * m_bin_size));
+				return regularized_gamma_p(K, x * InvTheta);
 			}
+	};
 
-			m_dist = t_dist;
-		}
+	/// <summary>
+	/// Weibull distribution with shape K and scale Lambda
+	/// </summary>
+	class WeibullDistribution : public Distribution<WeibullDistribution>
+	{
+		private:
+			double K;
+			double InvLambda;
+
+		public:
+			WeibullDistribution(double k, double lambda)
+				: K(k), InvLambda(1.0 / lambda)
+			{}
+
+			double Pdf(double x) const
+			{
+				if (x <= 0.0)
+					return 0.0;
+
+				const double log_z = std::log(x * InvLambda);
+				return K * InvLambda * std::exp(((K - 1.0) * log_z) - std::exp(K * log_z));
+			}
+
+			double Cdf(double x) const
+			{
+				if (x <= 0.0)
+					return 0.0;
+
+				return -std::expm1(-std::pow(x * InvLambda, K));
+			}
+	};
+
+	/// <summary>
+	/// Beta distribution with shapes A and B on interval (0, 1). PDF is evaluated in log space
+	/// </summary>
+	class BetaDistribution : public Distribution<BetaDistribution>
+	{
+		private:
+			double A;
+			double B;
+			double LogNorm;
+
+		public:
+			BetaDistribution(double a, double b)
+				: A(a), B(b), LogNorm(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b))
+			{}
+
+			double Pdf(double x) const
+			{
+				if (x <= 0.0 || x >= 1.0)
+					return 0.0;
+
+				return std::exp(((A - 1.0) * std::log(x)) + ((B - 1.0) * std::log1p(-x)) + LogNorm);
+			}
+
+			double Cdf(double x) const
+			{
+				return regularized_beta(A, B, x);
+			}
+	};
+
+	/// <summary>
+	/// Sum of squared differences between density histogram and PDF
+	/// </summary>
+	/// <param name="density">- Density histogram values</param>
+	/// <param name="pdf">- PDF values</param>
+	/// <param name="count">- Value count</param>
+	/// <returns>RSS</returns>
+	inline double squared_residuals(const double* density, const double* pdf, std::size_t count)
+	{
+		double rss = 0.0;
 
-		void join(const RSSParallel& y)
+		#pragma loop(ivdep)
+		for (std::size_t i = 0; i < count; i++)
 		{
-			m_dist->Add_RSS(y.m_dist->Get_RSS());
+			const double diff = density[i] - pdf[i];
+			rss += diff * diff;
 		}
-	};
-}
 
+		return rss;
+	}
+}
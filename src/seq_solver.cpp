@@ -18,7 +18,7 @@ namespace ppr::seq
 			return SResult::error_res(EExitStatus::STAT);
 		}
 
-		RunningStat stat(data[0]);
+		RunningStat stat(data[0], ppr::executor::required_statistics(configuration));
 
 		// ================ [Get statistics]
 		tbb::tick_count t0 = tbb::tick_count::now();
@@ -32,44 +32,43 @@ namespace ppr::seq
 
 		//	================ [Fit params]
 		res.isNegative = stat.Get_Min() < 0;
-		res.isInteger = std::floor(stat.Sum()) == stat.Sum();
-
-		// Gauss maximum likelihood estimators
-		res.gauss_mean = stat.Mean();
-		res.gauss_variance = stat.Variance();
-		res.gauss_stdev = stat.StandardDeviation();
-
-		// Exponential maximum likelihood estimators
-		res.exp_lambda = static_cast<double>(stat.NumDataValues()) / stat.Sum();;
-
-		// Poisson likelihood estimators
-		res.poisson_lambda = stat.Sum() / stat.NumDataValues();
-
-		// Uniform likelihood estimators
-		res.uniform_a = stat.Get_Min();
-		res.uniform_b = stat.Get_Max();
+		res.isInteger = stat.IsInteger();
+
+		SDataStat data_stat;
+		data_stat.n = stat.NumDataValues();
+		data_stat.sum = stat.Sum();
+		data_stat.mean = stat.Mean();
+		data_stat.variance = stat.Variance();
+		data_stat.min = stat.Get_Min();
+		data_stat.max = stat.Get_Max();
+		data_stat.isNegative = res.isNegative;
+		data_stat.isInteger = res.isInteger;
+		data_stat.stats = stat.Log_sums().stats;
+		data_stat.add_log_sums(stat.Log_sums());
+
+		// Maximum likelihood estimators of all distributions
+		t0 = tbb::tick_count::now();
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		std::vector<int> ids = registry.select(configuration.distributions);
+		res.fits.resize(ids.size());
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			res.fits[i].id = ids[i];
+			registry.get(ids[i]).fit(data_stat, res.fits[i]);
+		}
+		t1 = tbb::tick_count::now();
+		res.total_fit_time = (t1 - t0).seconds();
 
 		// ================ [Create histogram]
 		t0 = tbb::tick_count::now();
 
-		double bin_count = 0.0;
-		double bin_size = 0.0;
+		SHistogram limits;
+		ppr::executor::compute_histogram_limits(limits, data_stat);
 
-		if (!res.isNegative && res.isInteger && res.poisson_lambda > 0)
-		{
-			bin_count = stat.Get_Max() - stat.Get_Min();
-			bin_size = 1.0;
-		}
-		else
-		{
-			bin_count = log2(stat.NumDataValues()) + 2;
-			bin_size = (stat.Get_Max() - stat.Get_Min()) / (bin_count - 1);
-		}
+		ppr::hist::Histogram hist(limits.binCount, limits.binSize, limits.min, limits.max);
 
-		ppr::hist::Histogram hist(static_cast<int>(bin_count), bin_size, stat.Get_Min(), stat.Get_Max());
-
-		std::vector<int> histogramFrequency(static_cast<int>(bin_count) + 1);
-		std::vector<double> histogramDensity(static_cast<int>(bin_count) + 1);
+		std::vector<int> histogramFrequency(limits.binCount);
+		std::vector<double> histogramDensity(limits.binCount);
 
 		for (unsigned int i = 0; i < mapping.get_count(); i++)
 		{
@@ -85,17 +84,20 @@ namespace ppr::seq
 		// ================ [Get propability density of histogram]
 		hist.compute_propability_density_histogram(histogramDensity, histogramFrequency, mapping.get_count());
 
+		// ================ [Goodness-of-fit]
+		ppr::executor::compute_goodness_of_fit(limits, histogramFrequency, res);
+
 		// ================ [Calculate RSS]
 		t0 = tbb::tick_count::now();
-		res.gauss_rss = hist.compute_rss_histogram(histogramDensity, 'n', res);
-		res.exp_rss = hist.compute_rss_histogram(histogramDensity, 'e', res);
-		res.poisson_rss = hist.compute_rss_histogram(histogramDensity, 'p', res);
-		res.uniform_rss = hist.compute_rss_histogram(histogramDensity, 'u', res);
+		for (auto& fit : res.fits)
+		{
+			fit.rss = fit.valid ? hist.compute_rss_histogram(histogramDensity, fit) : std::numeric_limits<double>::infinity();
+		}
 		t1 = tbb::tick_count::now();
 		res.total_rss_time = (t1 - t0).seconds();
 
 		//	================ [Analyze]
-		ppr::executor::analyze_results(res);
+		ppr::executor::analyze_results(configuration, res);
 
 		total2 = tbb::tick_count::now();
 		res.total_time = (total2 - total1).seconds();
@@ -1,7 +1,8 @@
 #include "include/smp_solver.h"
 #include "include/watchdog.h"
+#include "include/memory_usage.h"
 #include <vector>
-#include <future>
+#include <memory>
 
 namespace ppr::parallel
 {
@@ -10,166 +11,621 @@ namespace ppr::parallel
 		tbb::tick_count total1;
 		total1 = tbb::tick_count::now();
 		//  ================ [Init TBB]
-		tbb::task_arena arena(configuration.thread_count == 0 ? tbb::task_arena::automatic : static_cast<int>(configuration.thread_count));
+		// Arena can be placed on one NUMA node, TBB then keeps its threads there
+		const std::vector<tbb::numa_node_id> numa_nodes = tbb::info::numa_nodes();
+		const bool numa_placed = configuration.numa_node >= 0 && configuration.numa_node < static_cast<int>(numa_nodes.size());
+		if (configuration.numa_node >= 0 && !numa_placed)
+		{
+			ppr::print_error("NUMA node " + std::to_string(configuration.numa_node) + " not found, threads are not placed");
+		}
+
+		tbb::task_arena arena(tbb::task_arena::constraints(numa_placed ? numa_nodes[configuration.numa_node] : tbb::task_arena::automatic,
+			configuration.thread_count == 0 ? tbb::task_arena::automatic : static_cast<int>(configuration.thread_count)));
+		arena.initialize();
+		const int concurrency = arena.max_concurrency();
+
+		// Optimized run keeps arena threads on their processors, NUMA placement is left to TBB
+		std::unique_ptr<Thread_pinning> pinning = configuration.use_optimalization && !numa_placed ? std::make_unique<Thread_pinning>(arena) : nullptr;
+
+		// Every arena thread opens its counters, when it joins the arena
+		std::unique_ptr<ppr::perf::Perf_counters> counters = configuration.perf_counters ? std::make_unique<ppr::perf::Perf_counters>(arena) : nullptr;
 
 		//  ================ [Map input file]
 		File_mapping mapping(configuration);
+		if (!mapping.open_mapping())
+		{
+			ppr::print_error("Cannot create a mapping");
+			return SResult::error_res(EExitStatus::MAPPING);
+		}
+
+		// Optimized run maps whole file once and splits it between threads to page aligned partitions. TBB run maps file by windows
+		const unsigned long long count = mapping.get_count();
+		double* view = configuration.use_optimalization ? mapping.map_window(0, 0) : nullptr;
+		if (configuration.use_optimalization && view == nullptr)
+		{
+			ppr::print_error("Cannot create a file view");
+			mapping.close_mapping();
+			return SResult::error_res(EExitStatus::MAPPING);
+		}
+		const unsigned long long alignment = PARTITION_ALIGNMENT / sizeof(double);
+		const unsigned long long partition = (count + concurrency - 1) / concurrency;
+		const unsigned long long chunk_size = ((partition + alignment - 1) / alignment) * alignment;
+
+		// Windows of all threads fit into memory budget
+		Window_controller controller(mapping.get_granularity(), mapping.get_window_size() / concurrency, static_cast<double>(configuration.stat_timeout), configuration.window_size, configuration.fixed_window);
 
 		//  ================ [Allocations]
-		tbb::tick_count total2;
-		tbb::tick_count t0;
-		tbb::tick_count t1;
-		int stage = 0;
-		ppr::gpu::SOpenCLConfig opencl;
+		ppr::watchdog::Telemetry telemetry(concurrency);
 		SHistogram hist;
 		SResult res;
 		SDataStat stat;
-		std::vector<int> tmp(0);
 		std::vector<int> histogramFreq(0);			// Will resize after collecting statistics
 		std::vector<double> histogramDensity(0);	// Will resize after collecting statistics
+		std::vector<std::vector<int>> workerFreq(0);	// Frequency histogram of every arena thread
 		long data_count = mapping.get_count();
 
-		//  ================ [Start Watchdog]
-		std::thread watchdog = ppr::watchdog::start_watchdog(configuration, stat, hist, stage, histogramFreq, histogramDensity, data_count);
-		
-		//  ================ [Get statistics]
-		if (configuration.use_optimalization)
+		const ppr::dist::Registry& registry = ppr::dist::Registry::instance();
+		const std::vector<int> ids = registry.select(configuration.distributions);
+		res.fits.resize(ids.size());
+		stat.stats = registry.required_stats(ids);
+
+		//  ================ [Resume from checkpoint]
+		ppr::checkpoint::Checkpointer checkpointer(configuration, count * sizeof(double), stat.stats);
+		ppr::checkpoint::SCheckpoint checkpoint;
+		if (configuration.resume && !checkpointer.load(checkpoint))
 		{
-			// Optimized run
-			t0 = tbb::tick_count::now();
-			mapping.read_in_one_chunk_cpu(hist, configuration, opencl, stat, EIteration::STAT, tmp);
-			t1 = tbb::tick_count::now();
+			if (view)
+			{
+				mapping.unmap_window(view);
+			}
+			mapping.close_mapping();
+			return SResult::error_res(EExitStatus::ARGS);
 		}
-		else
+		const bool resume_hist = configuration.resume && checkpoint.iteration == EIteration::HIST;
+		const unsigned long long resume_offset = checkpoint.offset / sizeof(double);
+		if (configuration.resume)
 		{
-			// TBB run
-			t0 = tbb::tick_count::now();
-			mapping.read_in_chunks_tbb(hist, configuration, opencl, stat, arena, tmp, &get_statistics_CPU);
-			t1 = tbb::tick_count::now();
+			stat = checkpoint.stat;
 		}
 
-		res.total_stat_time = (t1 - t0).seconds();
-
-		//  ================ [Fit params using Maximum likelihood estimation]
+		Stage_clock clock(telemetry, counters.get());
+		std::atomic<unsigned long long> stat_chunks(UNKNOWN_CHUNK_COUNT);
+		std::atomic<unsigned long long> hist_chunks(UNKNOWN_CHUNK_COUNT);
+		Chunk_reader stat_reader(mapping, controller, telemetry, stat_chunks, view, chunk_size, configuration.resume ? resume_offset : 0);
+		Chunk_reader hist_reader(mapping, controller, telemetry, hist_chunks, view, chunk_size, resume_hist ? resume_offset : 0);
+		unsigned long long stat_merged = 0;
+		unsigned long long hist_merged = 0;
+		bool completed = false;
 
-		res.isNegative = stat.min < 0;
-		res.isInteger = std::floor(stat.sum) == stat.sum;
+		// Chunk results, which wait for their predecessors
+		std::map<unsigned long long, SChunk_result> pending;
+		unsigned long long merged_end = configuration.resume ? resume_offset : 0;
 
-		// Find mean
-		stat.mean = stat.sum / stat.n;
-		
-		// Poisson likelihood estimators
-		res.poisson_lambda = stat.sum / stat.n;
-
-		//  ================ [Create frequency histogram]
-		
-		// Find histogram limits
-		double bin_count = 0.0;
-		double bin_size = 0.0;
+		//  ================ [Start Watchdog]
+		std::thread watchdog = ppr::watchdog::start_watchdog(configuration, stat, hist, telemetry, histogramFreq, histogramDensity, data_count);
+		ppr::memory::Memory_sampler sampler(telemetry);
+
+		// Mean, isNegative, isInteger and histogram limits from merged statistics
+		auto finish_stat = [&]() {
+			res.isNegative = stat.min < 0;
+			res.isInteger = stat.isInteger;
+			stat.isNegative = res.isNegative;
+			stat.isInteger = res.isInteger;
+
+			// Find mean
+			stat.mean = stat.sum / stat.n;
+
+			// Allocate memmory
+			ppr::executor::compute_histogram_limits(hist, stat);
+			histogramFreq.resize(static_cast<int>(hist.binCount));
+			histogramDensity.resize(static_cast<int>(hist.binCount));
+		};
+
+		//  ================ [Solver graph]
+		// stat reader -> stat reduce -> stat merge -> hist start
+		// hist reader -> hist reduce -> hist merge -> [report, density, fit of every distribution] -> RSS -> analyze
+		arena.execute([&]() {
+			using merge_node = tbb::flow::multifunction_node<SChunk_result, std::tuple<tbb::flow::continue_msg>>;
+			using step_node = tbb::flow::continue_node<tbb::flow::continue_msg>;
+
+			// Cancelled run stops the graph and all nested algorithms
+			tbb::flow::graph g(telemetry.get_context());
+
+			//  ================ [Get statistics]
+			tbb::flow::input_node<SChunk> stat_source(g, stat_reader);
+
+			tbb::flow::function_node<SChunk, SChunk_result, tbb::flow::rejecting> stat_reduce(g, concurrency, clock.timed(EPipeline_stage::STAT, [&](const SChunk& chunk) {
+				SChunk_result result;
+				result.offset = chunk.offset;
+				result.count = chunk.count;
+				SDataStat& local_stat = result.stat;
+				local_stat.stats = stat.stats;
+				const std::size_t slot = tbb::this_task_arena::current_thread_index();
+
+				if (view)
+				{
+					// Partition is long, progress is counted and cancellation checked by blocks
+					for (long long block = 0; block < static_cast<long long>(chunk.count) && !telemetry.is_cancelled(); block += ppr::watchdog::TELEMETRY_BLOCK_VALUES)
+					{
+						const long long size = std::min(ppr::watchdog::TELEMETRY_BLOCK_VALUES, static_cast<long long>(chunk.count) - block);
+						SDataStat block_stat;
+						block_stat.stats = stat.stats;
+						get_statistics_vectorized(block_stat, size, chunk.data + block);
+						local_stat.merge(block_stat);
+						telemetry.add(EIteration::STAT, slot, size);
+					}
+				}
+				else
+				{
+					Running_stat_parallel stat_cpu(chunk.data, 0, stat.stats);
+					const double seconds = ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat_cpu, 1, chunk.count);
+					mapping.unmap_window(chunk.view);
+					controller.report(EIteration::STAT, chunk.count * sizeof(double), seconds);
+
+					local_stat.n = stat_cpu.NumDataValues();
+					local_stat.sum = stat_cpu.Sum();
+					local_stat.min = stat_cpu.Get_Min();
+					local_stat.max = stat_cpu.Get_Max();
+					local_stat.isNegative = stat_cpu.IsNegative();
+					local_stat.isInteger = stat_cpu.IsInteger();
+					local_stat.add_log_sums(stat_cpu.Log_sums());
+					telemetry.add(EIteration::STAT, slot, chunk.count);
+				}
+
+				// Blocks and TBB ranges stop early in cancelled run
+				result.partial = telemetry.is_cancelled();
+				telemetry.add(EIteration::STAT, slot, 0, 1);
+				return result;
+				}));
+
+			merge_node stat_merge(g, tbb::flow::serial, clock.timed(EPipeline_stage::MERGE, [&](const SChunk_result& result, merge_node::output_ports_type& ports) {
+				// Partial chunk is not merged, so that merged statistics and checkpoint cover whole chunks only
+				if (result.partial)
+				{
+					return;
+				}
+
+				// Agregate results in file order
+				pending.emplace(result.offset, result);
+
+				while (!pending.empty() && pending.begin()->first == merged_end)
+				{
+					const SChunk_result& next = pending.begin()->second;
+					stat.merge(next.stat);
+					merged_end += next.count;
+					stat_merged++;
+					pending.erase(pending.begin());
+
+					if (!telemetry.is_cancelled())
+					{
+						checkpointer.chunk_done(EIteration::STAT, merged_end * sizeof(double), stat, histogramFreq);
+					}
+				}
+
+				if (stat_merged < stat_chunks)
+				{
+					return;
+				}
+
+				finish_stat();
+
+				std::get<0>(ports).try_put(tbb::flow::continue_msg());
+				}));
+
+			//  ================ [Create frequency histogram]
+			tbb::flow::input_node<SChunk> hist_source(g, hist_reader);
+
+			step_node hist_start(g, [&](const tbb::flow::continue_msg&) {
+				// Buffers are allocated before histogram pass, so that workers only accumulate
+				workerFreq.assign(concurrency, std::vector<int>(hist.binCount, 0));
+				merged_end = resume_hist ? resume_offset : 0;
+				hist_source.activate();
+				return tbb::flow::continue_msg();
+				});
+
+			tbb::flow::function_node<SChunk, SChunk_result, tbb::flow::rejecting> hist_reduce(g, concurrency, clock.timed(EPipeline_stage::HIST, [&](const SChunk& chunk) {
+				const std::size_t slot = tbb::this_task_arena::current_thread_index();
+				SChunk_result result;
+				result.offset = chunk.offset;
+				result.count = chunk.count;
+
+				// Checkpointed run needs histogram of every chunk, otherwise every thread counts to its own histogram
+				if (checkpointer.is_enabled())
+				{
+					result.histogram.assign(hist.binCount, 0);
+				}
+				std::vector<int>& local_freq = checkpointer.is_enabled() ? result.histogram : workerFreq[slot];
+				double& variance = result.variance;
+
+				if (view)
+				{
+					// Partition is long, progress is counted and cancellation checked by blocks
+					for (long long block = 0; block < static_cast<long long>(chunk.count) && !telemetry.is_cancelled(); block += ppr::watchdog::TELEMETRY_BLOCK_VALUES)
+					{
+						const long long size = std::min(ppr::watchdog::TELEMETRY_BLOCK_VALUES, static_cast<long long>(chunk.count) - block);
+						double block_variance = 0.0;
+						get_histogram_vectorized(local_freq, block_variance, size, chunk.data + block, hist, stat);
+						variance += block_variance;
+						telemetry.add(EIteration::HIST, slot, size);
+					}
+				}
+				else
+				{
+					ppr::hist::Histogram_parallel hist_cpu(hist.binCount, hist.binSize, stat.min, stat.max, chunk.data, stat.mean);
+					const double seconds = ppr::executor::run_with_tbb<ppr::hist::Histogram_parallel>(arena, hist_cpu, 0, chunk.count);
+					mapping.unmap_window(chunk.view);
+					controller.report(EIteration::HIST, chunk.count * sizeof(double), seconds);
+
+					std::transform(local_freq.begin(), local_freq.end(), hist_cpu.m_bucketFrequency.begin(), local_freq.begin(), std::plus<int>());
+					variance = hist_cpu.m_var;
+					telemetry.add(EIteration::HIST, slot, chunk.count);
+				}
+
+				// Blocks and TBB ranges stop early in cancelled run
+				result.partial = telemetry.is_cancelled();
+				telemetry.add(EIteration::HIST, slot, 0, 1);
+				return result;
+				}));
+
+			merge_node hist_merge(g, tbb::flow::serial, clock.timed(EPipeline_stage::MERGE, [&](const SChunk_result& result, merge_node::output_ports_type& ports) {
+				// Partial chunk is not merged, so that merged statistics and checkpoint cover whole chunks only
+				if (result.partial)
+				{
+					return;
+				}
+
+				// Agregate results in file order
+				pending.emplace(result.offset, result);
+
+				while (!pending.empty() && pending.begin()->first == merged_end)
+				{
+					const SChunk_result& next = pending.begin()->second;
+					stat.variance += next.variance;
+					if (!next.histogram.empty())
+					{
+						std::transform(histogramFreq.begin(), histogramFreq.end(), next.histogram.begin(), histogramFreq.begin(), std::plus<int>());
+					}
+					merged_end += next.count;
+					hist_merged++;
+					pending.erase(pending.begin());
+
+					if (!telemetry.is_cancelled())
+					{
+						checkpointer.chunk_done(EIteration::HIST, merged_end * sizeof(double), stat, histogramFreq);
+					}
+				}
+
+				if (hist_merged < hist_chunks)
+				{
+					return;
+				}
+
+				// Agregate results of all workers
+				for (const std::vector<int>& local_freq : workerFreq)
+				{
+					std::transform(histogramFreq.begin(), histogramFreq.end(), local_freq.begin(), histogramFreq.begin(), std::plus<int>());
+				}
+
+				// Find variance
+				stat.variance = stat.variance / stat.n;
+				completed = true;
+
+				std::get<0>(ports).try_put(tbb::flow::continue_msg());
+				}));
+
+			tbb::flow::broadcast_node<tbb::flow::continue_msg> hist_done(g);
+
+			//  ================ [Report statistics]
+			step_node report(g, [&](const tbb::flow::continue_msg&) {
+				print_stat(stat, res);
+				return tbb::flow::continue_msg();
+				});
+
+			//  ================ [Create density histogram]
+			step_node density(g, clock.timed(EPipeline_stage::DENSITY, [&](const tbb::flow::continue_msg&) {
+				ppr::executor::compute_propability_density_histogram(hist, histogramFreq, histogramDensity, stat.n);
+				return tbb::flow::continue_msg();
+				}));
+
+			//	================ [Calculate RSS]
+			step_node rss(g, clock.timed(EPipeline_stage::RSS, [&](const tbb::flow::continue_msg&) {
+				ppr::parallel::calculate_histogram_RSS_cpu(res, histogramDensity, hist);
+				return tbb::flow::continue_msg();
+				}));
+
+			//	================ [Analyze Results]
+			step_node analyze(g, [&](const tbb::flow::continue_msg&) {
+				ppr::executor::analyze_results(configuration, res);
+				return tbb::flow::continue_msg();
+				});
+
+			//  ================ [Fit params using Maximum likelihood estimation]
+			// One node per distribution. Parameters and goodness-of-fit criteria from frequency histogram
+			std::vector<std::unique_ptr<step_node>> fits;
+			for (std::size_t i = 0; i < ids.size(); i++)
+			{
+				fits.push_back(std::make_unique<step_node>(g, clock.timed(EPipeline_stage::FIT, [&, i](const tbb::flow::continue_msg&) {
+					SDistribution_fit& fit = res.fits[i];
+					fit.id = ids[i];
+					registry.get(ids[i]).fit(stat, fit);
+					ppr::executor::compute_goodness_of_fit(hist, histogramFreq, fit);
+					return tbb::flow::continue_msg();
+					})));
+
+				tbb::flow::make_edge(hist_done, *fits[i]);
+				tbb::flow::make_edge(*fits[i], rss);
+			}
+
+			tbb::flow::make_edge(stat_source, stat_reduce);
+			tbb::flow::make_edge(stat_reduce, stat_merge);
+			tbb::flow::make_edge(tbb::flow::output_port<0>(stat_merge), hist_start);
+			tbb::flow::make_edge(hist_source, hist_reduce);
+			tbb::flow::make_edge(hist_reduce, hist_merge);
+			tbb::flow::make_edge(tbb::flow::output_port<0>(hist_merge), hist_done);
+			tbb::flow::make_edge(hist_done, report);
+			tbb::flow::make_edge(hist_done, density);
+			tbb::flow::make_edge(density, rss);
+			tbb::flow::make_edge(rss, analyze);
+
+			// Resumed histogram pass starts with statistics from checkpoint
+			if (resume_hist)
+			{
+				finish_stat();
+				if (!checkpoint.histogram.empty() && checkpoint.histogram.size() != histogramFreq.size())
+				{
+					ppr::print_error("Checkpoint histogram does not match statistics");
+					telemetry.cancel(EExitStatus::ARGS);
+				}
+				else
+				{
+					if (!checkpoint.histogram.empty())
+					{
+						histogramFreq = checkpoint.histogram;
+					}
+					hist_start.try_put(tbb::flow::continue_msg());
+				}
+			}
+			else
+			{
+				stat_source.activate();
+			}
+			g.wait_for_all();
+			});
+
+		if (view)
+		{
+			mapping.unmap_window(view);
+		}
+		mapping.close_mapping();
 
-		// If data can belongs to poisson distribution, we should use integer intervals
-		if (!res.isNegative && res.isInteger && res.poisson_lambda > 0)
+		if (telemetry.is_cancelled())
+		{
+			ppr::print_error("Run was cancelled, results are partial.");
+			res.status = telemetry.get_status();
+		}
+		else if (!completed)
 		{
-			hist.binCount = static_cast<int>(stat.max - stat.min);
-			hist.binSize = 1.0;
+			ppr::print_error("Input file was not processed completely.");
+			res.status = EExitStatus::MAPPING;
 		}
 		else
 		{
-			hist.binCount = static_cast<int>(log2(stat.n)) + 2;
-			hist.binSize = (stat.max - stat.min) / (hist.binCount - 1);
+			checkpointer.finish();
 		}
-		hist.scaleFactor = (hist.binCount) / (stat.max - stat.min);
 
-		// Allocate memmory
-		histogramFreq.resize(static_cast<int>(hist.binCount));
-		histogramDensity.resize(static_cast<int>(hist.binCount));
+		res.total_stat_time = clock.seconds(EPipeline_stage::STAT);
+		res.total_hist_time = clock.seconds(EPipeline_stage::HIST);
+		res.total_fit_time = clock.seconds(EPipeline_stage::FIT);
+		res.total_rss_time = clock.seconds(EPipeline_stage::RSS);
+		res.total_merge_time = clock.busy_seconds(EPipeline_stage::MERGE);
+		if (counters)
+		{
+			// Merges interleave with both passes, their span tells nothing
+			for (EPipeline_stage stage : { EPipeline_stage::STAT, EPipeline_stage::HIST, EPipeline_stage::FIT, EPipeline_stage::DENSITY, EPipeline_stage::RSS })
+			{
+				SStage_counters stage_counters;
+				stage_counters.stage = PIPELINE_STAGE_NAMES[static_cast<int>(stage)];
+				const ppr::perf::Counter_values values = clock.counters(stage);
+				std::copy(values.begin(), values.end(), stage_counters.values);
+				res.stage_counters.push_back(stage_counters);
+			}
+		}
+		res.total_time = (tbb::tick_count::now() - total1).seconds();
+		res.chunk_trace = controller.get_trace();
+		res.processed = telemetry.sample(EIteration::STAT).elements + telemetry.sample(EIteration::HIST).elements;
+		res.checkpoint_count = checkpointer.get_count();
+		res.checkpoint_time = checkpointer.get_seconds();
+		res.stage_memory = sampler.stop();
+		telemetry.set_stage(4);
 
-		stage = 1;
+		// Wait until watchdog will finish
+		watchdog.join();
+		return res;
+	}
 
-		// Run
-		if (configuration.use_optimalization)
+	Thread_pinning::Thread_pinning(tbb::task_arena& arena)
+		: tbb::task_scheduler_observer(arena), m_processor_count(0)
+	{
+		// Affinity mask has one bit per processor of one group (at most 64), so slots are split into groups
+		const WORD group_count = GetActiveProcessorGroupCount();
+		for (WORD group = 0; group < group_count; group++)
 		{
-			// Optimized run
-			t0 = tbb::tick_count::now();
-			mapping.read_in_one_chunk_cpu(hist, configuration, opencl, stat, EIteration::HIST, histogramFreq);
-			t1 = tbb::tick_count::now();
+			m_group_sizes.push_back(GetActiveProcessorCount(group));
+			m_processor_count += m_group_sizes.back();
 		}
-		else
+
+		if (m_processor_count == 0)
 		{
-			// TBB run
-			t0 = tbb::tick_count::now();
-			mapping.read_in_chunks_tbb(hist, configuration, opencl, stat, arena, histogramFreq, &create_frequency_histogram_CPU);
-			t1 = tbb::tick_count::now();
+			m_group_sizes.assign(1, 1);
+			m_processor_count = 1;
 		}
-		res.total_hist_time = (t1 - t0).seconds();
 
+		observe(true);
+	}
 
-		//  ================ [Fit params using Maximum likelihood estimation]
+	Thread_pinning::~Thread_pinning()
+	{
+		observe(false);
+	}
 
-		// Find variance
-		stat.variance = stat.variance / stat.n;
+	// Previous group affinity of thread, which is restored, when thread leaves arena
+	static thread_local GROUP_AFFINITY previous_affinity = {};
 
-		// Gauss maximum likelihood estimators
-		res.gauss_mean = stat.mean;
-		res.gauss_variance = stat.variance;
-		res.gauss_stdev = sqrt(stat.variance);
+	void Thread_pinning::on_scheduler_entry(bool)
+	{
+		const int slot = tbb::this_task_arena::current_thread_index();
+		if (slot < 0)
+		{
+			return;
+		}
 
-		// Exponential maximum likelihood estimators
-		res.exp_lambda = stat.n / stat.sum;
+		// Processor of slot, numbered over all groups
+		unsigned int processor = static_cast<unsigned int>(slot) % m_processor_count;
+		WORD group = 0;
+		while (processor >= m_group_sizes[group])
+		{
+			processor -= m_group_sizes[group];
+			group++;
+		}
 
-		// Uniform likelihood estimators
-		res.uniform_a = stat.min;
-		res.uniform_b = stat.max;
+		GROUP_AFFINITY affinity = {};
+		affinity.Group = group;
+		affinity.Mask = static_cast<KAFFINITY>(1) << processor;
+		if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, &previous_affinity))
+		{
+			previous_affinity.Mask = 0;
+		}
+	}
+
+	void Thread_pinning::on_scheduler_exit(bool)
+	{
+		if (previous_affinity.Mask != 0)
+		{
+			SetThreadGroupAffinity(GetCurrentThread(), &previous_affinity, nullptr);
+			previous_affinity.Mask = 0;
+		}
+	}
 
+	void Stage_clock::begin(EPipeline_stage stage)
+	{
+		const int index = static_cast<int>(stage);
+		std::lock_guard<std::mutex> lock(m_mutex);
 
-		//  ================ [Create density histogram]
-		stage = 2;
-		ppr::executor::compute_propability_density_histogram(hist, histogramFreq, histogramDensity, stat.n);
+		if (!m_started[index])
+		{
+			if (m_counters)
+			{
+				m_counters_begin[index] = m_counters->read();
+				m_counters_end[index] = m_counters_begin[index];
+			}
+			m_begin[index] = tbb::tick_count::now();
+			m_end[index] = m_begin[index];
+			m_started[index] = true;
+		}
 
-		//	================ [Calculate RSS]
-		stage = 3;
-		ppr::parallel::calculate_histogram_RSS_cpu(res, histogramDensity, hist);
+		// Watchdog checks only go forward, while stages overlap
+		m_telemetry.advance_stage(PIPELINE_WATCHDOG_STAGE[index]);
+	}
 
-		//	================ [Analyze Results]
-		ppr::executor::analyze_results(res);
+	void Stage_clock::end(EPipeline_stage stage, tbb::tick_count start)
+	{
+		const int index = static_cast<int>(stage);
 
-		total2 = tbb::tick_count::now();
-		
-		res.total_time = (total2 - total1).seconds();
-		stage = 4;
+		// Counters are read outside of the lock, reading costs a system call per thread
+		ppr::perf::Counter_values values;
+		if (m_counters)
+		{
+			values = m_counters->read();
+		}
 
-		print_stat(stat, res);
+		std::lock_guard<std::mutex> lock(m_mutex);
 
-		// Wait until watchdog will finish
-		watchdog.join();
-		return res;
+		m_end[index] = tbb::tick_count::now();
+		m_busy[index] += (m_end[index] - start).seconds();
+		if (m_counters)
+		{
+			// Node, which finished later, may read counters earlier
+			for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			{
+				m_counters_end[index][i] = std::max(m_counters_end[index][i], values[i]);
+			}
+		}
 	}
 
-	void get_statistics_CPU(SHistogram& hist, SConfig& configuration, ppr::gpu::SOpenCLConfig& opencl, SDataStat& stat, tbb::task_arena& arena, unsigned long long data_count, double* data, std::vector<int>& histogram)
+	double Stage_clock::seconds(EPipeline_stage stage) const
 	{
-		// Find rest of a statistics on CPU
-		Running_stat_parallel stat_cpu(data, opencl.data_count_for_cpu);
-		ppr::executor::run_with_tbb<Running_stat_parallel>(arena, stat_cpu, opencl.data_count_for_cpu + 1, data_count);
-
-		// Agregate results results
-		stat.n += stat_cpu.NumDataValues();
-		stat.min = std::min({ stat.min, std::min({ stat.min, stat_cpu.Get_Min() }) });
-		stat.max = std::max({ stat.max, std::max({ stat.max, stat_cpu.Get_Max() }) });
-		stat.sum += stat_cpu.Sum();
-		stat.isNegative = stat.isNegative || stat_cpu.IsNegative();
+		const int index = static_cast<int>(stage);
+		return m_started[index] ? (m_end[index] - m_begin[index]).seconds() : 0.0;
 	}
 
-	void create_frequency_histogram_CPU(SHistogram& hist, SConfig&, ppr::gpu::SOpenCLConfig& opencl, SDataStat& stat, tbb::task_arena& arena, unsigned long long data_count, double* data, std::vector<int>& histogram)
+	double Stage_clock::busy_seconds(EPipeline_stage stage) const
 	{
-		// Run on CPU
-		ppr::hist::Histogram_parallel hist_cpu(hist.binCount, hist.binSize, stat.min, stat.max, data, stat.mean);
-		ppr::executor::run_with_tbb<ppr::hist::Histogram_parallel>(arena, hist_cpu, opencl.data_count_for_cpu, data_count);
-
-		// Transform vector
-		std::transform(histogram.begin(), histogram.end(), hist_cpu.m_bucketFrequency.begin(), histogram.begin(), std::plus<int>());
+		return m_busy[static_cast<int>(stage)];
+	}
 
-		stat.variance += hist_cpu.m_var;
+	ppr::perf::Counter_values Stage_clock::counters(EPipeline_stage stage) const
+	{
+		const int index = static_cast<int>(stage);
+		if (!m_counters || !m_started[index])
+		{
+			ppr::perf::Counter_values values;
+			values.fill(-1);
+			return values;
+		}
+		return ppr::perf::difference(m_counters_begin[index], m_counters_end[index]);
 	}
 
+	Chunk_reader::Chunk_reader(File_mapping& mapping, Window_controller& controller, ppr::watchdog::Telemetry& telemetry,
+		std::atomic<unsigned long long>& chunk_count, double* view, unsigned long long chunk_size, unsigned long long start)
+		: m_mapping(mapping), m_controller(controller), m_telemetry(telemetry), m_chunk_count(chunk_count), m_view(view), m_count(mapping.get_count()),
+		m_chunk_size(std::max(chunk_size, 1ULL)), m_offset(start), m_produced(0) {}
+
+	SChunk Chunk_reader::operator()(tbb::flow_control& fc)
+	{
+		SChunk chunk;
+
+		// Cancelled run reads no more chunks
+		if (m_offset >= m_count || m_telemetry.is_cancelled())
+		{
+			fc.stop();
+			return chunk;
+		}
 
-}
\ No newline at end of file
+		if (m_view)
+		{
+			// The last partition may be shorter
+			chunk.count = std::min(m_chunk_size, m_count - m_offset);
+			chunk.data = m_view + m_offset;
+		}
+		else
+		{
+			// Window offset is a multiple of allocation granularity, because window size is.
+			// Resumed run may start inside a window, the first window then ends on a granularity boundary
+			const unsigned long long lead = (m_offset * sizeof(double)) % m_mapping.get_granularity();
+
+			// The last window may be shorter
+			chunk.count = std::min((m_controller.get_window_size() - lead) / sizeof(double), m_count - m_offset);
+
+			chunk.view = m_mapping.map_window(m_offset * sizeof(double) - lead, chunk.count * sizeof(double) + lead);
+			if (chunk.view == nullptr)
+			{
+				ppr::print_error("Cannot map a file window");
+				fc.stop();
+				return SChunk();
+			}
+			chunk.data = chunk.view + lead / sizeof(double);
+		}
+
+		chunk.offset = m_offset;
+		m_offset += chunk.count;
+		m_produced++;
+
+		// Consumers know the last chunk before it is processed
+		if (m_offset >= m_count)
+		{
+			m_chunk_count = m_produced;
+		}
+
+		return chunk;
+	}
+}
@@ -1,7 +1,11 @@
 #include "include/data.h"
+#include "include/distribution.h"
+#include "include/trace.h"
 #include<cmath>
 #include <iostream>
 #include <numeric>
+#include <algorithm>
+#include <limits>
 
 #undef min
 #undef max
@@ -11,6 +15,72 @@
 
 namespace ppr
 {
+	/// <summary>
+	/// Number of values processed in one block of logarithmic kernel. Block buffer lives on the stack
+	/// </summary>
+	constexpr std::size_t LOG_BLOCK_SIZE = 256;
+
+	/// <summary>
+	/// Accumulate logarithmic sufficient statistics of data block. Logarithms are computed in separate loop over small
+	/// block, so compiler can use vectorized log (SVML) and sums do not depend on a library call
+	/// </summary>
+	/// <param name="data">- Data pointer</param>
+	/// <param name="count">- Data count</param>
+	/// <param name="stat">- Statistics structure (stat.stats says which sums are collected)</param>
+	inline void accumulate_log_sums(const double* data, std::size_t count, SDataStat& stat)
+	{
+		const unsigned int stats = stat.stats;
+		if ((stats & ppr::dist::STAT_LOG_SUMS) == 0)
+		{
+			return;
+		}
+
+		double log_x[LOG_BLOCK_SIZE];
+		double log_1mx[LOG_BLOCK_SIZE];
+		double sum_log = 0.0, sum_log2 = 0.0, sum_x_log = 0.0, sum_log1m = 0.0;
+
+		for (std::size_t begin = 0; begin < count; begin += LOG_BLOCK_SIZE)
+		{
+			const std::size_t size = std::min(LOG_BLOCK_SIZE, count - begin);
+			const double* x = data + begin;
+
+			if (stats & (ppr::dist::STAT_SUM_LOG | ppr::dist::STAT_SUM_LOG2 | ppr::dist::STAT_SUM_X_LOG))
+			{
+				#pragma loop(ivdep)
+				for (std::size_t i = 0; i < size; i++)
+				{
+					log_x[i] = std::log(x[i]);
+				}
+
+				for (std::size_t i = 0; i < size; i++)
+				{
+					sum_log += log_x[i];
+					sum_log2 += log_x[i] * log_x[i];
+					sum_x_log += x[i] * log_x[i];
+				}
+			}
+
+			if (stats & ppr::dist::STAT_SUM_LOG1M)
+			{
+				#pragma loop(ivdep)
+				for (std::size_t i = 0; i < size; i++)
+				{
+					log_1mx[i] = std::log1p(-x[i]);
+				}
+
+				for (std::size_t i = 0; i < size; i++)
+				{
+					sum_log1m += log_1mx[i];
+				}
+			}
+		}
+
+		stat.sumLog += sum_log;
+		stat.sumLog2 += sum_log2;
+		stat.sumXLog += sum_x_log;
+		stat.sumLog1m += sum_log1m;
+	}
+
 	// https://www.johndcook.com/blog/standard_deviation/
     class RunningStat
     {
@@ -24,14 +94,19 @@ namespace ppr
             double m_max;
             double m_min;
             int m_n;
+            bool m_integer;
+            SDataStat m_log_sums;
 
         public:
 
             //RunningStat(){}
 
-            RunningStat(const double first_x) 
-                : m_n(1), m_oldM(first_x), m_newM(first_x), m_oldS(0.0), m_newS(0.0), m_sum(first_x), m_sumAbs(first_x), m_min(88888.0), m_max(0)
-            {}
+            RunningStat(const double first_x, unsigned int stats = 0)
+                : m_n(1), m_oldM(first_x), m_newM(first_x), m_oldS(0.0), m_newS(0.0), m_sum(first_x), m_sumAbs(first_x), m_max(first_x), m_min(first_x), m_integer(std::floor(first_x) == first_x)
+            {
+                m_log_sums.stats = stats;
+                accumulate_log_sums(&first_x, 1, m_log_sums);
+            }
 
             void Clear()
             {
@@ -49,6 +124,12 @@ namespace ppr
 
                 m_min = x < m_min ? x : m_min;
                 m_max = x > m_max ? x : m_max;
+                m_integer = m_integer && std::floor(x) == x;
+
+                if (m_log_sums.stats & ppr::dist::STAT_LOG_SUMS)
+                {
+                    accumulate_log_sums(&x, 1, m_log_sums);
+                }
 
                 // set up for next iteration
                 m_oldM = m_newM;
@@ -80,6 +161,11 @@ namespace ppr
                 return m_min;
             }
 
+            bool IsInteger() const
+            {
+                return m_integer;
+            }
+
             double Mean() const
             {
                 return (m_n > 0.0) ? m_newM : 0.0;
@@ -94,6 +180,11 @@ namespace ppr
             {
                 return sqrt(Variance());
             }
+
+            const SDataStat& Log_sums() const
+            {
+                return m_log_sums;
+            }
     };
 
     class Running_stat_parallel
@@ -104,42 +195,61 @@ namespace ppr
             const unsigned long long m_first_index;
 
         public:
-            Running_stat_parallel(double* data, unsigned long long first_index) : m_data(data), m_first_index(first_index)
+            Running_stat_parallel(double* data, unsigned long long first_index, unsigned int stats = 0) : m_data(data), m_first_index(first_index)
             {
+                // First value is counted here, reduction starts from 'first_index + 1'
+                const double x = data[m_first_index];
+                m_stat.stats = stats;
                 m_stat.n = 1;
-                m_stat.sum = data[m_first_index];
-                m_stat.min = 88888.0; // TODO: min
-                m_stat.max = -88888.0;
-                m_stat.isNegative = true;
+                m_stat.sum = x;
+                m_stat.min = x;
+                m_stat.max = x;
+                m_stat.isNegative = x < 0.0;
+                m_stat.isInteger = std::floor(x) == x;
+                accumulate_log_sums(m_data + m_first_index, 1, m_stat);
             }
 
             Running_stat_parallel(Running_stat_parallel& x, tbb::split) : m_data(x.m_data), m_first_index(x.m_first_index)
             {
-                m_stat.n = 1;
-                m_stat.sum = x.m_data[m_first_index];
-                m_stat.min = 88888.0; // TODO: min
-                m_stat.max = -88888.0;
-                m_stat.isNegative = true;
+                // Split body starts empty, so that the first value is not counted twice
+                m_stat.stats = x.m_stat.stats;
+                m_stat.n = 0;
+                m_stat.sum = 0.0;
+                m_stat.min = std::numeric_limits<double>::max();
+                m_stat.max = std::numeric_limits<double>::lowest();
+                m_stat.isNegative = false;
+                m_stat.isInteger = true;
             }
 
             void operator()(const tbb::blocked_range<size_t>& r)
             {
+                ppr::trace::Scope trace("stat range", "tbb", r.size());
+
                 // Parameters 
                 const double* t_data = m_data;
                 SDataStat t_stat = m_stat;
                 size_t begin = r.begin();
                 size_t end = r.end();
 
-                for (size_t i = begin; i != end; i++)
+                // Blocks keep data in L1 cache for logarithmic sums
+                for (size_t block = begin; block < end; block += LOG_BLOCK_SIZE)
                 {
-                    double x = (double)t_data[i];
+                    const size_t block_end = std::min(block + LOG_BLOCK_SIZE, end);
 
-                    t_stat.n += 1;
-                    t_stat.sum += x;
-                    t_stat.isNegative = t_stat.isNegative || std::signbit(x);
+                    for (size_t i = block; i != block_end; i++)
+                    {
+                        double x = (double)t_data[i];
 
-                    t_stat.min = x < t_stat.min ? x : t_stat.min;
-                    t_stat.max = x > t_stat.max ? x : t_stat.max;
+                        t_stat.n += 1;
+                        t_stat.sum += x;
+                        t_stat.isNegative = t_stat.isNegative || x < 0.0;
+                        t_stat.isInteger = t_stat.isInteger && std::floor(x) == x;
+
+                        t_stat.min = x < t_stat.min ? x : t_stat.min;
+                        t_stat.max = x > t_stat.max ? x : t_stat.max;
+                    }
+
+                    accumulate_log_sums(t_data + block, block_end - block, t_stat);
                 }
                 m_stat = t_stat;
             }
@@ -151,6 +261,8 @@ namespace ppr
                 m_stat.min = m_stat.min < y.m_stat.min ? m_stat.min : y.m_stat.min;
                 m_stat.max = m_stat.max > y.m_stat.max ? m_stat.max : y.m_stat.max;
                 m_stat.isNegative = m_stat.isNegative || y.m_stat.isNegative;
+                m_stat.isInteger = m_stat.isInteger && y.m_stat.isInteger;
+                m_stat.add_log_sums(y.m_stat);
             }
 
             unsigned long long NumDataValues() const
@@ -168,6 +280,11 @@ namespace ppr
                 return m_stat.isNegative;
             }
 
+            bool IsInteger() const
+            {
+                return m_stat.isInteger;
+            }
+
             double Get_Max() const
             {
                 return m_stat.max;
@@ -177,6 +294,11 @@ namespace ppr
             {
                 return m_stat.min;
             }
+
+            const SDataStat& Log_sums() const
+            {
+                return m_stat;
+            }
     };
 }
 
@@ -0,0 +1,41 @@
+#include "include/telemetry.h"
+
+#include <algorithm>
+
+namespace ppr::watchdog
+{
+	Telemetry::Telemetry(std::size_t slot_count)
+		: m_counters(new SWorker_counters[std::max<std::size_t>(slot_count, 1)]), m_slot_count(std::max<std::size_t>(slot_count, 1)) {}
+
+	SProgress Telemetry::sample(EIteration iteration) const
+	{
+		SProgress progress;
+		const int pass = static_cast<int>(iteration);
+
+		for (std::size_t i = 0; i < m_slot_count; i++)
+		{
+			progress.elements += m_counters[i].elements[pass].load(std::memory_order_relaxed);
+			progress.bytes += m_counters[i].bytes[pass].load(std::memory_order_relaxed);
+			progress.chunks += m_counters[i].chunks[pass].load(std::memory_order_relaxed);
+		}
+
+		return progress;
+	}
+
+	void Telemetry::advance_stage(int stage)
+	{
+		int current = m_stage.load(std::memory_order_relaxed);
+		while (current < stage && !m_stage.compare_exchange_weak(current, stage, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void Telemetry::cancel(EExitStatus status)
+	{
+		int expected = EExitStatus::SUCCESS;
+		if (m_status.compare_exchange_strong(expected, status, std::memory_order_acq_rel))
+		{
+			m_context.cancel_group_execution();
+		}
+	}
+}
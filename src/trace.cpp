@@ -0,0 +1,185 @@
+#include "include/trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ppr::trace
+{
+	std::atomic<bool> g_enabled(false);
+
+	/// <summary>
+	/// Thread id of the first track from add_track. Tracks are drawn below host threads
+	/// </summary>
+	const constexpr int TRACE_FIRST_TRACK_ID = 1000;
+
+	/// <summary>
+	/// One finished event
+	/// </summary>
+	struct SEvent
+	{
+		const char* name;
+		const char* category;
+		long long begin;
+		long long end;
+		unsigned long long values;
+		int track;
+	};
+
+	/// <summary>
+	/// Ring buffer of one thread. Only the owner writes it
+	/// </summary>
+	struct SThread_buffer
+	{
+		std::unique_ptr<SEvent[]> events{ new SEvent[TRACE_BUFFER_EVENTS] };
+		unsigned long long recorded = 0;
+		std::string name;
+	};
+
+	// Buffers outlive their threads, std::async workers end before trace is written
+	static std::mutex buffers_mutex;
+	static std::vector<std::unique_ptr<SThread_buffer>> buffers;
+	static std::vector<std::string> tracks;
+	static long long origin = 0;
+	static thread_local SThread_buffer* thread_buffer = nullptr;
+
+	/// <summary>
+	/// Buffer of calling thread, is created by the first event
+	/// </summary>
+	static SThread_buffer& get_buffer()
+	{
+		if (thread_buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(buffers_mutex);
+			buffers.push_back(std::make_unique<SThread_buffer>());
+			buffers.back()->name = "thread " + std::to_string(buffers.size() - 1);
+			thread_buffer = buffers.back().get();
+		}
+		return *thread_buffer;
+	}
+
+	void enable()
+	{
+		origin = now();
+		g_enabled.store(true, std::memory_order_relaxed);
+	}
+
+	void name_thread(const std::string& name)
+	{
+		if (!is_enabled())
+		{
+			return;
+		}
+
+		SThread_buffer& buffer = get_buffer();
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffer.name = name;
+	}
+
+	int add_track(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		tracks.push_back(name);
+		return static_cast<int>(tracks.size()) - 1;
+	}
+
+	void record(const char* name, const char* category, long long begin, long long end, unsigned long long values, int track)
+	{
+		if (!is_enabled())
+		{
+			return;
+		}
+
+		SThread_buffer& buffer = get_buffer();
+		buffer.events[buffer.recorded % TRACE_BUFFER_EVENTS] = { name, category, begin, end, values, track };
+		buffer.recorded++;
+	}
+
+	/// <summary>
+	/// Write JSON string
+	/// </summary>
+	static void write_string(std::ofstream& out, const std::string& text)
+	{
+		out << '"';
+		for (const char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) >= 0x20)
+			{
+				out << c;
+			}
+		}
+		out << '"';
+	}
+
+	/// <summary>
+	/// Write thread name metadata event
+	/// </summary>
+	static void write_thread_name(std::ofstream& out, int tid, const std::string& name)
+	{
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+		write_string(out, name);
+		out << "}}";
+	}
+
+	long long write(const char* path)
+	{
+		std::ofstream out(path);
+		if (!out)
+		{
+			return -1;
+		}
+
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		long long written = 0;
+
+		// Timestamps and durations are in microseconds
+		out << std::fixed << std::setprecision(3);
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+		out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"pprsolver\"}}";
+
+		for (size_t t = 0; t < buffers.size(); t++)
+		{
+			const SThread_buffer& buffer = *buffers[t];
+			out << "," << std::endl;
+			write_thread_name(out, static_cast<int>(t), buffer.name);
+
+			// Full ring keeps the newest events
+			const unsigned long long first = buffer.recorded > TRACE_BUFFER_EVENTS ? buffer.recorded - TRACE_BUFFER_EVENTS : 0;
+			for (unsigned long long i = first; i < buffer.recorded; i++)
+			{
+				const SEvent& event = buffer.events[i % TRACE_BUFFER_EVENTS];
+				const int tid = event.track < 0 ? static_cast<int>(t) : TRACE_FIRST_TRACK_ID + event.track;
+
+				out << "," << std::endl << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+					<< ",\"ts\":" << (event.begin - origin) / 1000.0 << ",\"dur\":" << (event.end > event.begin ? event.end - event.begin : 0) / 1000.0;
+				if (event.values > 0)
+				{
+					out << ",\"args\":{\"values\":" << event.values << "}";
+				}
+				out << "}";
+				written++;
+			}
+
+			if (first > 0)
+			{
+				out << "," << std::endl << "{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << t
+					<< ",\"ts\":0,\"args\":{\"count\":" << first << "}}";
+			}
+		}
+
+		for (size_t i = 0; i < tracks.size(); i++)
+		{
+			out << "," << std::endl;
+			write_thread_name(out, TRACE_FIRST_TRACK_ID + static_cast<int>(i), tracks[i]);
+		}
+
+		out << std::endl << "]}" << std::endl;
+		return out ? written : -1;
+	}
+}
@@ -3,6 +3,9 @@
 #undef max
 
 #include <tbb/tick_count.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
 
 namespace ppr::watchdog
 {
@@ -10,38 +13,48 @@ namespace ppr::watchdog
 		return (n == 0);
 	}
 
-	std::thread start_watchdog(SConfig& config, SDataStat& stat, SHistogram& hist, int& stage,
+	std::thread start_watchdog(SConfig& config, SDataStat& stat, SHistogram& hist, Telemetry& telemetry,
 		std::vector<int>& histogram, std::vector<double>& histogramDesity, long data_count)
 	{
-        std::thread watchdog([&]() {
+        std::thread watchdog([&, data_count]() {
 			EExitStatus status = EExitStatus::SUCCESS;
-			unsigned long long n_last = 0;
+			const unsigned long long file_bytes = static_cast<unsigned long long>(data_count) * sizeof(double);
+			const unsigned long long count = static_cast<unsigned long long>(data_count);
+			const tbb::tick_count start = tbb::tick_count::now();
+			tbb::tick_count last = start;
+			unsigned long long last_bytes = 0;
+			double stalled = 0.0;
+			bool sampled = false;
 
 			while (true)
 			{
+				// Stage is published after results of previous stages, so they can be read
+				const int stage = telemetry.get_stage();
+				const SProgress stat_progress = telemetry.sample(EIteration::STAT);
+				const SProgress hist_progress = telemetry.sample(EIteration::HIST);
+
 				switch (stage)
 				{
 				//	===== [Statistics] =====
 				case 0:	
-					if (n_last > stat.n)						// Number of observing data is not increaing
+					if (stat_progress.elements > count)			// Number of observing data is wrong
 					{
 						ppr::print_error("Wrong number of processing data.");
 						status = EExitStatus::WD_STAT_WRONG_N;
 					}
-					n_last = stat.n;
-					if (stat.min > stat.max)					// Min is bigger that max
-					{
-						ppr::print_error("Minumum value cannot be bigger, that maximum.");
-						status = EExitStatus::WD_STAT_MIN_MAX;
-					}
 					break;
 				//	===== [Frequency histogram] =====
 				case 1:	
-					if (stat.n > data_count)						// Number of observing data is wrong
+					if (stat.n > count || hist_progress.elements > count)	// Number of observing data is wrong
 					{
 						ppr::print_error("Wrong number of processing data.");
 						status = EExitStatus::WD_STAT_WRONG_N;
 					}
+					if (stat.min > stat.max)					// Min is bigger that max
+					{
+						ppr::print_error("Minumum value cannot be bigger, that maximum.");
+						status = EExitStatus::WD_STAT_MIN_MAX;
+					}
 					if (hist.binCount == 0)						// Bin count is zero
 					{
 						ppr::print_error("Histogram 'bin count' is zero.");
@@ -74,14 +87,44 @@ namespace ppr::watchdog
 					return;
 				default:
 					ppr::print_error("Unknown error.");
-					status = EExitStatus::UNKNOWN;
+					telemetry.cancel(EExitStatus::UNKNOWN);
 					return;
 				}
 
+				//	===== [Live status of file scan] =====
+				const tbb::tick_count now = tbb::tick_count::now();
+				const double seconds = (now - last).seconds();
+				const unsigned long long bytes = stat_progress.bytes + hist_progress.bytes;
+
+				if (stage <= 1 && sampled && seconds > 0.0 && file_bytes > 0)
+				{
+					const SProgress& pass = stage == 0 ? stat_progress : hist_progress;
+					const double rate = static_cast<double>(bytes - last_bytes) / seconds;
+					const double average = static_cast<double>(bytes) / (now - start).seconds();
+					const double eta = average > 0.0 ? static_cast<double>(2 * file_bytes - std::min(bytes, 2 * file_bytes)) / average : 0.0;
+
+					std::cout << "> [Watchdog] " << (stage == 0 ? "statistics" : "histogram") << "\t"
+						<< 100.0 * static_cast<double>(pass.bytes) / static_cast<double>(file_bytes) << " %\t"
+						<< rate / 1e9 << " GB/s\t" << pass.chunks << " chunks\tETA " << eta << " sec" << std::endl;
+
+					// Scan does not move
+					stalled = bytes == last_bytes ? stalled + seconds : 0.0;
+					if (stalled >= WATCHDOG_STALL_SEC)
+					{
+						ppr::print_error("No data were processed in last " + std::to_string(static_cast<long long>(stalled)) + " sec.");
+						status = EExitStatus::WD_STALL;
+					}
+				}
+				last = now;
+				last_bytes = bytes;
+				sampled = true;
+
+				// Workers stop at the next chunk and solver returns partial result
 				if (status != EExitStatus::SUCCESS)
 				{
 					ppr::print_error("Watchdog found some problem in computing process.");
-					std::exit(status);
+					telemetry.cancel(status);
+					return;
 				}
 
 				std::this_thread::sleep_for(std::chrono::seconds(config.watchdog_interval));
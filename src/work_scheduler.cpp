@@ -0,0 +1,377 @@
+#include "include/work_scheduler.h"
+#include "include/executor.h"
+#include "include/histogram.h"
+#include "include/trace.h"
+
+#include <future>
+#include <algorithm>
+#include <functional>
+
+namespace ppr::gpu
+{
+	Work_scheduler::Work_scheduler(tbb::task_arena& arena, SConfig& configuration, ppr::watchdog::Telemetry& telemetry)
+		: m_arena(arena), m_configuration(configuration), m_telemetry(telemetry)
+	{
+		SWorker cpu;
+		cpu.name = "CPU";
+		m_workers.push_back(std::move(cpu));
+
+		// Find all devices on all platforms
+		std::vector<cl::Device> devices;
+		find_opencl_devices(devices, configuration.cl_devices_name);
+
+		// Kernels are built once for the whole run
+		for (auto& device : devices)
+		{
+			SWorker worker;
+			std::string device_name = device.getInfo<CL_DEVICE_NAME>();
+			worker.name = device_name;
+			worker.stat_kernel.device = device;
+			worker.hist_kernel.device = device;
+			set_kernel_program(worker.stat_kernel, STAT_KERNEL, STAT_KERNEL_NAME, STAT_REDUCE_KERNEL_NAME);
+
+			// Both programs share one context and command queue of the device
+			worker.hist_kernel.context = worker.stat_kernel.context;
+			worker.hist_kernel.queue = worker.stat_kernel.queue;
+			set_kernel_program(worker.hist_kernel, HIST_KERNEL, HIST_KERNEL_NAME);
+
+			if (worker.stat_kernel.wg_size == 0 || worker.hist_kernel.wg_size == 0)
+			{
+				ppr::print_error("kernels can not be built on '" + worker.name + "', device is not used");
+				continue;
+			}
+
+			worker.pipeline = std::make_unique<Device_pipeline>(worker.stat_kernel, worker.hist_kernel, telemetry);
+			if (!worker.pipeline->is_ready())
+			{
+				ppr::print_error("staging buffers can not be allocated on '" + worker.name + "', device is not used");
+				continue;
+			}
+
+			m_workers.push_back(std::move(worker));
+		}
+
+		m_cpu_shares = configuration.mode == ERun_mode::ALL || m_workers.size() == 1;
+
+		if (configuration.mode == ERun_mode::CL && m_workers.size() == 1)
+		{
+			ppr::print_error("no OpenCL device found, data are processed on CPU");
+		}
+	}
+
+	bool Work_scheduler::claim(size_t index, bool rest, unsigned long long& begin, unsigned long long& count)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const unsigned long long remaining = m_end - m_cursor;
+
+		if (remaining == 0 || m_telemetry.is_cancelled())
+		{
+			return false;
+		}
+
+		SWorker& worker = m_workers[index];
+		unsigned long long size = remaining;
+
+		if (!rest)
+		{
+			size = SCHEDULER_MIN_CLAIM;
+
+			// Throughput share of remaining data
+			if (worker.throughput > 0.0)
+			{
+				double total = 0.0;
+				for (const auto& other : m_workers)
+				{
+					total += other.throughput;
+				}
+
+				const double share = SCHEDULER_GUIDED_FACTOR * static_cast<double>(remaining) * worker.throughput / total;
+				size = static_cast<unsigned long long>(std::min(worker.throughput * SCHEDULER_CLAIM_SECONDS, share));
+				size = std::max(size, SCHEDULER_MIN_CLAIM);
+			}
+
+			size = std::min(size, remaining);
+		}
+
+		// Histogram kernel takes whole work groups only, statistics kernel strides over any count
+		if (index != 0 && m_iteration == EIteration::HIST)
+		{
+			size -= size % worker.hist_kernel.wg_size;
+		}
+
+		if (size == 0)
+		{
+			return false;
+		}
+
+		begin = m_cursor;
+		count = size;
+		m_cursor += size;
+
+		return true;
+	}
+
+	void Work_scheduler::report(size_t index, unsigned long long count, double seconds)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		SWorker& worker = m_workers[index];
+
+		worker.count += count;
+		worker.seconds += seconds;
+
+		if (count > 0 && seconds > 0.0)
+		{
+			// Moving average smooths out page faults of the first touch
+			const double throughput = static_cast<double>(count) / seconds;
+			worker.throughput = worker.throughput == 0.0 ? throughput : 0.5 * (worker.throughput + throughput);
+		}
+	}
+
+	void Work_scheduler::run_on_cpu(unsigned long long begin, unsigned long long count, double* data, SHistogram& hist, SDataStat& stat,
+		SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance)
+	{
+		tbb::task_group_context& context = m_telemetry.get_context();
+
+		if (m_iteration == EIteration::STAT)
+		{
+			Running_stat_parallel stat_cpu(data, begin, stat.stats);
+			ppr::executor::run_with_tbb<Running_stat_parallel>(m_arena, stat_cpu, begin + 1, begin + count, &context);
+
+			SDataStat part;
+			part.stats = stat.stats;
+			part.n = stat_cpu.NumDataValues();
+			part.sum = stat_cpu.Sum();
+			part.min = stat_cpu.Get_Min();
+			part.max = stat_cpu.Get_Max();
+			part.isNegative = stat_cpu.IsNegative();
+			part.isInteger = stat_cpu.IsInteger();
+			part.add_log_sums(stat_cpu.Log_sums());
+
+			local_stat.merge(part);
+		}
+		else
+		{
+			ppr::hist::Histogram_parallel hist_cpu(hist.binCount, hist.binSize, stat.min, stat.max, data, stat.mean);
+			ppr::executor::run_with_tbb<ppr::hist::Histogram_parallel>(m_arena, hist_cpu, begin, begin + count, &context);
+
+			std::transform(local_histogram.begin(), local_histogram.end(), hist_cpu.m_bucketFrequency.begin(), local_histogram.begin(), std::plus<int>());
+			local_variance += hist_cpu.m_var;
+		}
+	}
+
+	void Work_scheduler::work(size_t index, bool rest, double* data, SHistogram& hist, SDataStat& stat,
+		SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance)
+	{
+		SWorker& worker = m_workers[index];
+		unsigned long long begin = 0;
+		unsigned long long count = 0;
+
+		// Device workers run on std::async threads
+		if (index != 0)
+		{
+			ppr::trace::name_thread("scheduler " + worker.name);
+		}
+
+		while (claim(index, rest, begin, count))
+		{
+			ppr::trace::Scope trace(index == 0 ? "cpu sub-chunk" : "device sub-chunk", "scheduler", count);
+			tbb::tick_count t0 = tbb::tick_count::now();
+
+			if (index == 0)
+			{
+				run_on_cpu(begin, count, data, hist, stat, local_stat, local_histogram, local_variance);
+			}
+			else
+			{
+				worker.claims.push_back({ data + begin, count });
+				worker.pipeline->submit(m_iteration, data + begin, count, hist, stat);
+			}
+
+			report(index, count, (tbb::tick_count::now() - t0).seconds());
+			m_telemetry.add(m_iteration, index, count, 1);
+
+			// Device failed or missed deadline
+			if (rest || (index != 0 && worker.pipeline->is_failed()))
+			{
+				break;
+			}
+		}
+
+		if (index == 0)
+		{
+			return;
+		}
+
+		// Pieces still in device queues
+		tbb::tick_count t0 = tbb::tick_count::now();
+		{
+			ppr::trace::Scope trace("drain", "scheduler");
+			worker.pipeline->drain(local_stat, local_histogram, local_variance);
+		}
+		report(index, 0, (tbb::tick_count::now() - t0).seconds());
+
+		// Pieces, which device did not finish in time, are processed on CPU from device thread
+		for (const SPiece& piece : worker.pipeline->take_requeued())
+		{
+			ppr::trace::Scope trace("requeued piece", "scheduler", piece.count);
+			t0 = tbb::tick_count::now();
+			run_on_cpu(static_cast<unsigned long long>(piece.data - data), piece.count, data, hist, stat, local_stat, local_histogram, local_variance);
+			report(0, piece.count, (tbb::tick_count::now() - t0).seconds());
+		}
+
+		if (worker.pipeline->is_failed() && !worker.disabled)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			worker.disabled = true;
+			worker.throughput = 0.0;
+			worker.error = "command failed or missed deadline";
+
+			if (!m_telemetry.is_cancelled())
+			{
+				ppr::print_error("'" + worker.name + "' failed or missed deadline, its work was moved to CPU and device is not used");
+			}
+		}
+	}
+
+	void Work_scheduler::recover(size_t index, const std::string& error, double* data, SHistogram& hist, SDataStat& stat,
+		SDataStat& local_stat, std::vector<int>& local_histogram, double& local_variance)
+	{
+		SWorker& worker = m_workers[index];
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			worker.disabled = true;
+			worker.throughput = 0.0;
+			worker.error = error;
+		}
+
+		worker.pipeline->abandon();
+		ppr::print_error("'" + worker.name + "' failed (" + error + "), its work was moved to CPU and device is not used");
+
+		local_stat = SDataStat();
+		local_stat.stats = stat.stats;
+		std::fill(local_histogram.begin(), local_histogram.end(), 0);
+		local_variance = 0.0;
+
+		for (const SPiece& piece : worker.claims)
+		{
+			ppr::trace::Scope trace("requeued piece", "scheduler", piece.count);
+			tbb::tick_count t0 = tbb::tick_count::now();
+			run_on_cpu(static_cast<unsigned long long>(piece.data - data), piece.count, data, hist, stat, local_stat, local_histogram, local_variance);
+			report(0, piece.count, (tbb::tick_count::now() - t0).seconds());
+		}
+		worker.claims.clear();
+	}
+
+	void Work_scheduler::process(EIteration iteration, double* data, unsigned long long count, SHistogram& hist, SDataStat& stat, std::vector<int>& histogram)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// Statistics and histogram kernels have different speed
+			if (iteration != m_iteration)
+			{
+				for (auto& worker : m_workers)
+				{
+					worker.throughput = 0.0;
+				}
+			}
+
+			m_iteration = iteration;
+			m_cursor = 0;
+			m_end = count;
+		}
+
+		// Partial results of every worker
+		std::vector<SDataStat> local_stats(m_workers.size());
+		std::vector<std::vector<int>> local_histograms(m_workers.size());
+		std::vector<double> local_variances(m_workers.size(), 0.0);
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			local_stats[i].stats = stat.stats;
+			if (iteration == EIteration::HIST)
+			{
+				local_histograms[i].resize(histogram.size());
+			}
+		}
+
+		// Every device has its own host thread, which waits on device queue
+		std::vector<std::future<void>> devices;
+		std::vector<size_t> device_workers;
+		for (size_t i = 1; i < m_workers.size(); i++)
+		{
+			if (m_workers[i].disabled)
+			{
+				continue;
+			}
+
+			m_workers[i].claims.clear();
+			device_workers.push_back(i);
+			devices.emplace_back(std::async(std::launch::async, &Work_scheduler::work, this, i, false, data, std::ref(hist), std::ref(stat),
+				std::ref(local_stats[i]), std::ref(local_histograms[i]), std::ref(local_variances[i])));
+		}
+
+		if (m_cpu_shares)
+		{
+			work(0, false, data, hist, stat, local_stats[0], local_histograms[0], local_variances[0]);
+		}
+
+		// Exception of device thread is rethrown here, sub-chunks of the device are not lost
+		for (size_t d = 0; d < devices.size(); d++)
+		{
+			const size_t i = device_workers[d];
+			try
+			{
+				devices[d].get();
+			}
+			catch (const std::exception& e)
+			{
+				recover(i, e.what(), data, hist, stat, local_stats[i], local_histograms[i], local_variances[i]);
+			}
+		}
+
+		// Remainder, which is not a multiple of work group size
+		work(0, true, data, hist, stat, local_stats[0], local_histograms[0], local_variances[0]);
+
+		// Collect results
+		ppr::trace::Scope trace("merge", "scheduler");
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			if (iteration == EIteration::STAT)
+			{
+				stat.merge(local_stats[i]);
+			}
+			else
+			{
+				stat.variance += local_variances[i];
+				std::transform(histogram.begin(), histogram.end(), local_histograms[i].begin(), histogram.begin(), std::plus<int>());
+			}
+		}
+	}
+
+	std::vector<SBackend_trace> Work_scheduler::get_trace() const
+	{
+		std::vector<SBackend_trace> trace;
+
+		for (const auto& worker : m_workers)
+		{
+			SBackend_trace backend;
+			backend.name = worker.name;
+			backend.count = worker.count;
+			backend.seconds = worker.seconds;
+			backend.build_seconds = worker.stat_kernel.build_time + worker.hist_kernel.build_time;
+			backend.saved_seconds = worker.stat_kernel.saved_time + worker.hist_kernel.saved_time;
+			backend.error = worker.error;
+
+			if (worker.pipeline)
+			{
+				SDevice_timing timing = worker.pipeline->get_timing();
+				backend.upload_seconds = timing.upload;
+				backend.kernel_seconds = timing.kernel;
+				backend.download_seconds = timing.download;
+			}
+			trace.push_back(backend);
+		}
+
+		return trace;
+	}
+}
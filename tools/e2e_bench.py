@@ -0,0 +1,360 @@
+#!/usr/bin/env python3
+"""
+End-to-end benchmark of pprsolver.
+
+Generates input files with the reference generator (referencni_rozdeleni/generator.cpp),
+runs every solver mode on cold and warm page cache and stores stage times, throughput
+and peak memory to JSON or CSV. With a baseline the run fails, when a mode is slower
+than the baseline by more than the threshold.
+
+Example:
+    python tools/e2e_bench.py --solver x64/Release/pprsolver.exe --size 1G --output e2e.json
+    python tools/e2e_bench.py --solver x64/Release/pprsolver.exe --size 1G --baseline e2e.json
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+REPO = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+GENERATOR_SOURCE = os.path.join(REPO, "referencni_rozdeleni", "generator.cpp")
+
+# Generator arguments of every distribution: name -> (generator code, a, b)
+DISTRIBUTIONS = {
+    "gauss": ("g", "0", "1"),
+    "uniform": ("u", "0", "1"),
+    "exponential": ("e", "1", "0"),
+    "poisson": ("p", "10", "0"),
+}
+
+# Solver modes: name -> arguments after input file. 'pocl' gets OpenCL device name
+MODES = {
+    "seq": ["seq"],
+    "smp": ["smp", "-o", "1"],
+    "smp-chunked": ["smp", "-o", "0"],
+    "pocl": [],
+}
+
+# Lines of time section: record key -> regular expression
+TIMES = {
+    "total_stat_time": r"> Statistics computing time:\s*([-+0-9.eE]+) sec",
+    "total_hist_time": r"> Histogram computing time:\s*([-+0-9.eE]+) sec",
+    "total_rss_time": r"> RSS computing time:\s*([-+0-9.eE]+) sec",
+    "total_time": r"> TOTAL TIME:\s*([-+0-9.eE]+) sec",
+}
+
+# Performance counters of one stage ('--perf'): stage, 'name=value' pairs
+COUNTERS = r"> Counters \[(\w+)\]:\s*(.*)"
+
+# Compared values of baseline
+COMPARED = ["total_time", "total_stat_time", "total_hist_time"]
+
+# Times shorter than this are noise and are not compared
+MIN_COMPARED_SECONDS = 0.05
+
+CSV_FIELDS = ["distribution", "mode", "cache", "size", "status", "total_stat_time", "total_hist_time",
+              "total_rss_time", "total_time", "wall_time", "gb_per_s", "peak_rss"]
+
+
+def parse_size(text):
+    """Parse size with optional K, M or G suffix (powers of 1024)."""
+    units = {"K": 1 << 10, "M": 1 << 20, "G": 1 << 30}
+    text = text.strip().upper()
+    if text and text[-1] in units:
+        return int(float(text[:-1]) * units[text[-1]])
+    return int(text)
+
+
+def build_generator(work_dir):
+    """Compile reference generator. Its entry point is called 'smain', so it is renamed by define."""
+    exe = os.path.join(work_dir, "generator.exe" if os.name == "nt" else "generator")
+    if os.path.exists(exe) and os.path.getmtime(exe) >= os.path.getmtime(GENERATOR_SOURCE):
+        return exe
+
+    if os.name == "nt" and shutil.which("cl"):
+        command = ["cl", "/nologo", "/std:c++17", "/O2", "/EHsc", "/Dsmain=main", GENERATOR_SOURCE, "/Fe:" + exe, "/Fo:" + work_dir + os.sep]
+    else:
+        compiler = os.environ.get("CXX") or shutil.which("c++") or shutil.which("g++") or shutil.which("clang++")
+        if not compiler:
+            sys.exit("No C++ compiler found for reference generator (set CXX or --generator)")
+        command = [compiler, "-std=c++17", "-O2", "-pthread", "-Dsmain=main", GENERATOR_SOURCE, "-o", exe]
+
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+    return exe
+
+
+def generate_corpus(generator, work_dir, distribution, size):
+    """Generate input file once. Existing file of the same size is reused, so that runs compare the same data."""
+    path = os.path.join(work_dir, "%s_%d" % (distribution, size))
+    if os.path.exists(path) and os.path.getsize(path) == size:
+        return path
+
+    code, a, b = DISTRIBUTIONS[distribution]
+    print("Generating %s (%d MB)" % (path, size >> 20), flush=True)
+    subprocess.run([generator, path, code, str(size // 8), a, b], check=True, stdout=subprocess.DEVNULL)
+    return path
+
+
+def drop_file_cache(path):
+    """Remove file pages from page cache, so that the next run reads from disk."""
+    if os.name == "nt":
+        # Opening a file without buffering purges its cached pages
+        import ctypes
+        from ctypes import wintypes
+        kernel32 = ctypes.WinDLL("kernel32", use_last_error=True)
+        kernel32.CreateFileW.restype = wintypes.HANDLE
+        GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING = 0x80000000, 0x1, 3, 0x20000000
+        handle = kernel32.CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, None, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, None)
+        if handle and handle != wintypes.HANDLE(-1).value:
+            kernel32.CloseHandle(handle)
+            return True
+        return False
+
+    if hasattr(os, "posix_fadvise"):
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            os.fsync(fd)
+            os.posix_fadvise(fd, 0, 0, os.POSIX_FADV_DONTNEED)
+        finally:
+            os.close(fd)
+        return True
+
+    return False
+
+
+def peak_memory_windows(process):
+    """Peak working set of finished process in bytes."""
+    import ctypes
+    from ctypes import wintypes
+
+    class PROCESS_MEMORY_COUNTERS(ctypes.Structure):
+        _fields_ = [("cb", wintypes.DWORD), ("PageFaultCount", wintypes.DWORD),
+                    ("PeakWorkingSetSize", ctypes.c_size_t), ("WorkingSetSize", ctypes.c_size_t),
+                    ("QuotaPeakPagedPoolUsage", ctypes.c_size_t), ("QuotaPagedPoolUsage", ctypes.c_size_t),
+                    ("QuotaPeakNonPagedPoolUsage", ctypes.c_size_t), ("QuotaNonPagedPoolUsage", ctypes.c_size_t),
+                    ("PagefileUsage", ctypes.c_size_t), ("PeakPagefileUsage", ctypes.c_size_t)]
+
+    counters = PROCESS_MEMORY_COUNTERS()
+    counters.cb = ctypes.sizeof(counters)
+    psapi = ctypes.WinDLL("psapi")
+    if psapi.GetProcessMemoryInfo(wintypes.HANDLE(int(process._handle)), ctypes.byref(counters), counters.cb):
+        return counters.PeakWorkingSetSize
+    return None
+
+
+def run_solver(command, timeout, preexec_fn=None):
+    """Run solver, return (exit status, output, wall time, peak resident memory in bytes).
+    'preexec_fn' runs in the child before the solver starts (POSIX only), e.g. to set resource limits."""
+    with tempfile.TemporaryFile(mode="w+") as output:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdout=output, stderr=subprocess.STDOUT, universal_newlines=True, preexec_fn=preexec_fn)
+
+        peak = None
+        if os.name == "nt":
+            try:
+                status = process.wait(timeout=timeout)
+            except subprocess.TimeoutExpired:
+                process.kill()
+                status = process.wait()
+            peak = peak_memory_windows(process)
+        else:
+            # wait4 returns resource usage of this child only
+            deadline = start + timeout
+            while True:
+                pid, raw_status, usage = os.wait4(process.pid, os.WNOHANG)
+                if pid != 0:
+                    break
+                if time.perf_counter() > deadline:
+                    process.kill()
+                    pid, raw_status, usage = os.wait4(process.pid, 0)
+                    break
+                time.sleep(0.01)
+            process.returncode = status = os.waitstatus_to_exitcode(raw_status) if hasattr(os, "waitstatus_to_exitcode") else raw_status >> 8
+            # ru_maxrss is in bytes on macOS and in kilobytes elsewhere
+            peak = usage.ru_maxrss if sys.platform == "darwin" else usage.ru_maxrss * 1024
+
+        wall = time.perf_counter() - start
+        output.seek(0)
+        return status, output.read(), wall, peak
+
+
+def parse_times(text):
+    """Stage times from time section of solver output."""
+    times = {}
+    for key, pattern in TIMES.items():
+        match = re.search(pattern, text)
+        times[key] = float(match.group(1)) if match else None
+    return times
+
+
+def parse_counters(text):
+    """Performance counters printed by '--perf' as 'perf_<stage>_<counter>' keys."""
+    counters = {}
+    for stage, pairs in re.findall(COUNTERS, text):
+        for pair in pairs.split():
+            name, _, value = pair.partition("=")
+            try:
+                counters["perf_%s_%s" % (stage, name)] = float(value)
+            except ValueError:
+                pass
+    return counters
+
+
+def run_benchmark(args):
+    os.makedirs(args.work_dir, exist_ok=True)
+    generator = args.generator or build_generator(args.work_dir)
+    size = parse_size(args.size)
+
+    records = []
+    for distribution in args.distributions:
+        path = generate_corpus(generator, args.work_dir, distribution, size)
+
+        for mode in args.modes:
+            if mode == "pocl":
+                if not args.pocl_device:
+                    print("Mode 'pocl' needs --pocl-device, skipped")
+                    continue
+                mode_args = [args.pocl_device]
+            else:
+                mode_args = MODES[mode]
+
+            for cache in args.cache:
+                best = None
+                for _ in range(args.repeat):
+                    if cache == "cold":
+                        if not drop_file_cache(path):
+                            print("Page cache can not be dropped on this system, cold run is warm")
+                    else:
+                        # Warm run reads the file once before measuring
+                        with open(path, "rb") as f:
+                            while f.read(1 << 24):
+                                pass
+
+                    status, text, wall, peak = run_solver([args.solver, path] + mode_args + args.solver_args, args.timeout)
+                    record = {"distribution": distribution, "mode": mode, "cache": cache, "size": size, "status": status,
+                              "wall_time": wall, "peak_rss": peak}
+                    record.update(parse_times(text))
+                    record.update(parse_counters(text))
+                    total = record["total_time"] or wall
+                    record["gb_per_s"] = size / total / 1e9 if total > 0 else None
+
+                    if status != 0 and args.verbose:
+                        print(text)
+                    if best is None or (status == 0 and (best["status"] != 0 or total < (best["total_time"] or best["wall_time"]))):
+                        best = record
+
+                records.append(best)
+                print("%-12s %-12s %-5s status %2d  total %8.3f s  %6.2f GB/s  peak %s MB" % (
+                    distribution, mode, cache, best["status"], best["total_time"] or best["wall_time"], best["gb_per_s"] or 0.0,
+                    "%.0f" % (best["peak_rss"] / 2**20) if best["peak_rss"] else "-"), flush=True)
+
+    return records
+
+
+def save_records(records, path):
+    if path.lower().endswith(".csv"):
+        # Counter columns exist only in runs with '--perf'
+        counters = sorted({key for record in records for key in record if key.startswith("perf_")})
+        with open(path, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=CSV_FIELDS + counters, extrasaction="ignore")
+            writer.writeheader()
+            writer.writerows(records)
+    else:
+        with open(path, "w") as f:
+            json.dump({"records": records}, f, indent=2)
+
+
+def load_records(path):
+    if path.lower().endswith(".csv"):
+        with open(path, newline="") as f:
+            records = list(csv.DictReader(f))
+        for record in records:
+            for key in record:
+                if key not in ("distribution", "mode", "cache"):
+                    record[key] = float(record[key]) if record[key] not in ("", "None") else None
+        return records
+
+    with open(path) as f:
+        return json.load(f)["records"]
+
+
+def compare(records, baseline, threshold):
+    """Print change against baseline, return number of regressions."""
+    reference = {(r["distribution"], r["mode"], r["cache"], int(r["size"])): r for r in baseline}
+    regressions = 0
+
+    for record in records:
+        key = (record["distribution"], record["mode"], record["cache"], int(record["size"]))
+        base = reference.get(key)
+        if base is None:
+            continue
+
+        if record["status"] != 0 and int(base["status"] or 0) == 0:
+            print("REGRESSION %s: exit status %d" % ("/".join(map(str, key[:3])), record["status"]))
+            regressions += 1
+            continue
+
+        for value in COMPARED:
+            old, new = base.get(value), record.get(value)
+            if not old or new is None or old < MIN_COMPARED_SECONDS:
+                continue
+            change = (new - old) / old
+            if change > threshold:
+                print("REGRESSION %s %s: %.3f s -> %.3f s (%+.1f %%)" % ("/".join(map(str, key[:3])), value, old, new, 100 * change))
+                regressions += 1
+            elif change < -threshold:
+                print("improved   %s %s: %.3f s -> %.3f s (%+.1f %%)" % ("/".join(map(str, key[:3])), value, old, new, 100 * change))
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end benchmark of pprsolver with regression check")
+    parser.add_argument("--solver", required=True, help="pprsolver executable")
+    parser.add_argument("--generator", help="reference generator executable (default: build from referencni_rozdeleni)")
+    parser.add_argument("--work-dir", default="e2e_work", help="directory of generated inputs")
+    parser.add_argument("--size", default="256M", help="input size, e.g. 512M, 7G")
+    parser.add_argument("--distributions", default=",".join(DISTRIBUTIONS), type=lambda s: s.split(","))
+    parser.add_argument("--modes", default="seq,smp,smp-chunked", type=lambda s: s.split(","),
+                        help="comma separated from: " + ", ".join(MODES))
+    parser.add_argument("--pocl-device", help="OpenCL device name of 'pocl' mode, e.g. 'pthread-Intel(R) Core(TM) i7'")
+    parser.add_argument("--cache", default="cold,warm", type=lambda s: s.split(","))
+    parser.add_argument("--repeat", default=1, type=int, help="runs of every case, the fastest is kept")
+    parser.add_argument("--timeout", default=900, type=float, help="seconds of one run")
+    parser.add_argument("--output", default="e2e_results.json", help="results file (.json or .csv)")
+    parser.add_argument("--baseline", help="results of previous run to compare with")
+    parser.add_argument("--threshold", default=0.10, type=float, help="allowed slow down against baseline (0.10 = 10 %%)")
+    parser.add_argument("--verbose", action="store_true", help="print output of failed runs")
+    parser.add_argument("solver_args", nargs="*", help="extra solver arguments after '--'")
+    args = parser.parse_args()
+
+    for name in args.distributions:
+        if name not in DISTRIBUTIONS:
+            parser.error("unknown distribution '%s'" % name)
+    for name in args.modes:
+        if name not in MODES:
+            parser.error("unknown mode '%s'" % name)
+
+    records = run_benchmark(args)
+    save_records(records, args.output)
+    print("Results: %s" % args.output)
+
+    if args.baseline:
+        regressions = compare(records, load_records(args.baseline), args.threshold)
+        if regressions:
+            print("%d regression(s) beyond %.0f %%" % (regressions, 100 * args.threshold))
+            return 1
+        print("No regression beyond %.0f %%" % (100 * args.threshold))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
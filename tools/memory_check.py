@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Memory limit check of pprsolver.
+
+Runs the main solver modes on a generated input under a memory cap and fails, when
+a run does not finish or its peak resident memory is over the budget. The budget
+is Memory_Limit of compiled/checker.ini (1 GB) by default.
+
+Caps:
+    rlimit  RLIMIT_DATA of the solver process (Linux), caps heap and private mappings,
+            read-only views of the input file are not counted
+    cgroup  memory.max of a transient systemd scope (Linux, 'systemd-run --user'),
+            caps all memory charged to the run including page cache
+    none    only measures (Windows)
+
+Peak resident memory is taken from the operating system (wait4, GetProcessMemoryInfo),
+high-water marks of every stage from the '> Memory [stage]' lines of the solver.
+
+Example:
+    python tools/memory_check.py --solver x64/Release/pprsolver.exe --size 2G
+    python tools/memory_check.py --solver ./pprsolver --size 3G --cap cgroup --modes smp,smp-chunked
+"""
+
+import argparse
+import configparser
+import os
+import re
+import shutil
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import e2e_bench  # noqa: E402
+
+CHECKER_INI = os.path.join(e2e_bench.REPO, "compiled", "checker.ini")
+
+# High-water marks of one stage: stage, 'name=value' pairs in MB
+MEMORY = r"> Memory \[(\w+)\]:\s*(.*) MB"
+
+
+def checker_limit():
+    """Memory_Limit of checker configuration in bytes."""
+    parser = configparser.ConfigParser(inline_comment_prefixes=(";",))
+    try:
+        parser.read(CHECKER_INI)
+        return int(parser["Test"]["Memory_Limit"])
+    except (KeyError, ValueError, configparser.Error):
+        return 1 << 30
+
+
+def parse_memory(text):
+    """Stage high-water marks printed by solver as 'mem_<stage>_<name>' keys in bytes."""
+    memory = {}
+    for stage, pairs in re.findall(MEMORY, text):
+        for pair in pairs.split():
+            name, _, value = pair.partition("=")
+            try:
+                memory["mem_%s_%s" % (stage, name)] = float(value) * (1 << 20)
+            except ValueError:
+                pass
+    return memory
+
+
+def capped_command(command, cap, budget):
+    """Command and child setup of the cap."""
+    if cap == "rlimit":
+        import resource
+
+        def limit():
+            resource.setrlimit(resource.RLIMIT_DATA, (budget, budget))
+
+        return command, limit
+
+    if cap == "cgroup":
+        # Scope runs the command in place, so wait4 still sees the solver
+        prefix = ["systemd-run", "--user", "--scope", "--quiet", "-p", "MemoryMax=%d" % budget, "-p", "MemorySwapMax=0"]
+        return prefix + command, None
+
+    return command, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check peak memory of pprsolver modes against the memory limit")
+    parser.add_argument("--solver", required=True, help="pprsolver executable")
+    parser.add_argument("--input", help="input file (default: generated)")
+    parser.add_argument("--generator", help="reference generator executable (default: build from referencni_rozdeleni)")
+    parser.add_argument("--distribution", default="gauss", choices=sorted(e2e_bench.DISTRIBUTIONS))
+    parser.add_argument("--size", default="2G", help="generated input size, larger than the budget to test windowing")
+    parser.add_argument("--work-dir", default="e2e_work", help="directory of generated inputs")
+    parser.add_argument("--modes", default="seq,smp,smp-chunked", type=lambda s: s.split(","),
+                        help="comma separated from: " + ", ".join(e2e_bench.MODES))
+    parser.add_argument("--pocl-device", help="OpenCL device name of 'pocl' mode")
+    parser.add_argument("--budget", type=e2e_bench.parse_size, default=checker_limit(), help="memory budget (default: checker.ini)")
+    parser.add_argument("--cap", default="rlimit" if sys.platform.startswith("linux") else "none", choices=["rlimit", "cgroup", "none"])
+    parser.add_argument("--metric", default="resident", choices=["resident", "anonymous"],
+                        help="compared peak: whole resident set, or resident memory without mapped file pages")
+    parser.add_argument("--timeout", default=900, type=float, help="seconds of one run")
+    parser.add_argument("--verbose", action="store_true", help="print output of failed runs")
+    parser.add_argument("solver_args", nargs="*", help="extra solver arguments after '--'")
+    args = parser.parse_args()
+
+    for name in args.modes:
+        if name not in e2e_bench.MODES:
+            parser.error("unknown mode '%s'" % name)
+    if args.cap == "rlimit" and not sys.platform.startswith("linux"):
+        parser.error("'rlimit' cap needs Linux")
+    if args.cap == "cgroup" and not shutil.which("systemd-run"):
+        parser.error("'cgroup' cap needs systemd-run")
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    if args.input:
+        path = args.input
+    else:
+        generator = args.generator or e2e_bench.build_generator(args.work_dir)
+        path = e2e_bench.generate_corpus(generator, args.work_dir, args.distribution, e2e_bench.parse_size(args.size))
+
+    print("Budget %.0f MB, cap %s, metric %s, input %s (%d MB)" % (
+        args.budget / 2**20, args.cap, args.metric, path, os.path.getsize(path) >> 20), flush=True)
+
+    failures = 0
+    for mode in args.modes:
+        if mode == "pocl":
+            if not args.pocl_device:
+                print("Mode 'pocl' needs --pocl-device, skipped")
+                continue
+            mode_args = [args.pocl_device]
+        else:
+            mode_args = e2e_bench.MODES[mode]
+
+        command, preexec = capped_command([args.solver, path] + mode_args + args.solver_args, args.cap, args.budget)
+        status, text, wall, peak = e2e_bench.run_solver(command, args.timeout, preexec_fn=preexec)
+        memory = parse_memory(text)
+
+        # Anonymous peak is known from solver samples only
+        if args.metric == "anonymous":
+            samples = [value for key, value in memory.items() if key.endswith("_anonymous")]
+            measured = max(samples) if samples else None
+        else:
+            measured = peak
+
+        failed = status != 0 or measured is None or measured > args.budget
+        failures += failed
+
+        stages = "  ".join("%s %.0f" % (key[4:-9], value / 2**20) for key, value in memory.items() if key.endswith("_resident"))
+        print("%-4s %-12s status %3d  %7.2f s  peak %s MB  [%s]" % (
+            "FAIL" if failed else "ok", mode, status, wall, "%.0f" % (measured / 2**20) if measured is not None else "-",
+            stages or "no stage samples"), flush=True)
+        if failed and args.verbose:
+            print(text)
+
+    if failures:
+        print("%d mode(s) over budget or failed" % failures)
+        return 1
+    print("All modes within budget")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+Strong and weak scaling study of the SMP solver.
+
+Runs the production pprsolver over a sweep of thread counts (TBB arena size, '-p'),
+fixed chunk windows ('-m', chunked mode) and NUMA nodes ('-n'). For every stage
+(statistics, histogram, serial merges, fit, RSS, total) computes speedup, parallel
+efficiency and the experimentally determined serial fraction (Karp-Flatt metric),
+and writes one CSV row per run ready for plotting.
+
+Strong scaling keeps the input. Weak scaling gives every thread the same amount of
+data: the input of p threads is the base input repeated p times.
+
+Example:
+    python tools/scaling.py --solver x64/Release/pprsolver.exe --input C:/data/gauss --threads 1,2,4,8,16,32,64
+    python tools/scaling.py --solver x64/Release/pprsolver.exe --weak --size 256M --modes smp-chunked --windows 16,64,256 --numa 0,1
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import e2e_bench  # noqa: E402
+
+# Stage times printed by solver: record key -> regular expression
+STAGES = dict(e2e_bench.TIMES)
+STAGES["total_fit_time"] = r"> Fit computing time:\s*([-+0-9.eE]+) sec"
+STAGES["total_merge_time"] = r"> Merge time \(serial\):\s*([-+0-9.eE]+) sec"
+
+# Solver modes of the study: name -> arguments after input file
+MODES = {
+    "smp": ["smp", "-o", "1"],
+    "smp-chunked": ["smp", "-o", "0"],
+}
+
+
+def default_threads():
+    """Powers of two up to all logical processors."""
+    cores = os.cpu_count() or 1
+    threads = []
+    t = 1
+    while t < cores:
+        threads.append(t)
+        t *= 2
+    threads.append(cores)
+    return threads
+
+
+def int_list(text):
+    return [int(x) for x in text.split(",") if x != ""]
+
+
+def parse_stages(text):
+    """Stage times from time section of solver output."""
+    stages = {}
+    for key, pattern in STAGES.items():
+        match = re.search(pattern, text)
+        stages[key] = float(match.group(1)) if match else None
+    return stages
+
+
+def weak_input(base, threads, work_dir):
+    """Input with the base input repeated 'threads' times. Created once."""
+    if threads == 1:
+        return base
+    path = "%s_x%d" % (os.path.join(work_dir, os.path.basename(base)), threads)
+    size = os.path.getsize(base) * threads
+    if not os.path.exists(path) or os.path.getsize(path) != size:
+        print("Creating %s (%d MB)" % (path, size >> 20), flush=True)
+        with open(path, "wb") as out:
+            for _ in range(threads):
+                with open(base, "rb") as f:
+                    while True:
+                        block = f.read(1 << 24)
+                        if not block:
+                            break
+                        out.write(block)
+    return path
+
+
+def run_sweep(args):
+    os.makedirs(args.work_dir, exist_ok=True)
+
+    if args.input:
+        base = args.input
+    else:
+        generator = args.generator or e2e_bench.build_generator(args.work_dir)
+        base = e2e_bench.generate_corpus(generator, args.work_dir, args.distribution, e2e_bench.parse_size(args.size))
+
+    scaling = "weak" if args.weak else "strong"
+    records = []
+
+    for mode in args.modes:
+        # Window applies to chunked reading only
+        windows = args.windows if mode == "smp-chunked" else [0]
+        for window in windows:
+            for numa in args.numa:
+                for threads in args.threads:
+                    path = weak_input(base, threads, args.work_dir) if args.weak else base
+                    command = [args.solver, path] + MODES[mode] + ["-p", str(threads)]
+                    if window > 0:
+                        command += ["-m", str(window)]
+                    if numa >= 0:
+                        command += ["-n", str(numa)]
+                    command += args.solver_args
+
+                    # Warm page cache, the study measures compute and memory, not disk
+                    with open(path, "rb") as f:
+                        while f.read(1 << 24):
+                            pass
+
+                    best = None
+                    for _ in range(args.repeat):
+                        status, text, wall, peak = e2e_bench.run_solver(command, args.timeout)
+                        stages = parse_stages(text)
+                        if status != 0 or stages["total_time"] is None:
+                            print("Run failed (exit status %d): %s" % (status, " ".join(command)))
+                            if args.verbose:
+                                print(text)
+                            continue
+                        if best is None or stages["total_time"] < best["total_time"]:
+                            best = stages
+                            best["peak_rss"] = peak
+
+                    if best is None:
+                        continue
+
+                    record = {"scaling": scaling, "mode": mode, "window_mb": window, "numa": numa, "threads": threads,
+                              "size": os.path.getsize(path)}
+                    record.update(best)
+                    records.append(record)
+                    print("%-6s %-12s window %4d MB  numa %2d  threads %3d  total %8.3f s  merge %8.4f s" % (
+                        scaling, mode, window, numa, threads, record["total_time"], record["total_merge_time"] or 0.0), flush=True)
+
+    return records
+
+
+def analyze(records):
+    """Add speedup, efficiency and serial fraction of every stage against the smallest thread count of its series."""
+    series = {}
+    for record in records:
+        series.setdefault((record["scaling"], record["mode"], record["window_mb"], record["numa"]), []).append(record)
+
+    for runs in series.values():
+        runs.sort(key=lambda r: r["threads"])
+        reference = runs[0]
+
+        for record in runs:
+            p = record["threads"] / reference["threads"]
+            for stage in STAGES:
+                name = "total" if stage == "total_time" else stage.replace("total_", "").replace("_time", "")
+                t1, tp = reference.get(stage), record.get(stage)
+                speedup = efficiency = serial = None
+
+                if t1 and tp:
+                    if record["scaling"] == "weak":
+                        # Gustafson scaled speedup, work grows with threads
+                        speedup = p * t1 / tp
+                    else:
+                        speedup = t1 / tp
+                    efficiency = speedup / p
+                    if p > 1:
+                        # Karp-Flatt: serial fraction, which explains measured speedup by Amdahl's law
+                        serial = (1.0 / speedup - 1.0 / p) / (1.0 - 1.0 / p)
+
+                record[name + "_speedup"] = speedup
+                record[name + "_efficiency"] = efficiency
+                record[name + "_serial_fraction"] = serial
+
+            # Scan rate of both passes shows, when memory bandwidth saturates
+            scan = (record.get("total_stat_time") or 0.0) + (record.get("total_hist_time") or 0.0)
+            record["scan_gb_per_s"] = 2.0 * record["size"] / scan / 1e9 if scan > 0 else None
+            record["merge_share"] = record["total_merge_time"] / record["total_time"] if record.get("total_merge_time") and record["total_time"] else None
+
+    return records
+
+
+def print_summary(records):
+    print()
+    print("%-6s %-12s %6s %4s %7s %9s %8s %8s %8s %9s %7s" % (
+        "scale", "mode", "window", "numa", "threads", "total[s]", "eff", "serial", "stat eff", "scan GB/s", "merge%"))
+    for r in records:
+        fmt = lambda v, f: (f % v) if v is not None else "-"
+        print("%-6s %-12s %6d %4d %7d %9.3f %8s %8s %8s %9s %7s" % (
+            r["scaling"], r["mode"], r["window_mb"], r["numa"], r["threads"], r["total_time"],
+            fmt(r["total_efficiency"], "%.2f"), fmt(r["total_serial_fraction"], "%.3f"), fmt(r["stat_efficiency"], "%.2f"),
+            fmt(r["scan_gb_per_s"], "%.2f"), fmt(r["merge_share"] and 100 * r["merge_share"], "%.2f")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Strong/weak scaling study of pprsolver SMP mode")
+    parser.add_argument("--solver", required=True, help="pprsolver executable")
+    parser.add_argument("--input", help="input file (default: generated)")
+    parser.add_argument("--generator", help="reference generator executable (default: build from referencni_rozdeleni)")
+    parser.add_argument("--distribution", default="gauss", choices=sorted(e2e_bench.DISTRIBUTIONS))
+    parser.add_argument("--size", default="1G", help="generated input size, per thread in weak scaling")
+    parser.add_argument("--work-dir", default="scaling_work", help="directory of generated inputs")
+    parser.add_argument("--weak", action="store_true", help="weak scaling: input grows with thread count")
+    parser.add_argument("--threads", default=default_threads(), type=int_list, help="arena sizes, e.g. 1,2,4,8")
+    parser.add_argument("--modes", default="smp,smp-chunked", type=lambda s: s.split(","), help="smp, smp-chunked")
+    parser.add_argument("--windows", default=[0], type=int_list, help="fixed windows of chunked mode in MB (0 = adaptive)")
+    parser.add_argument("--numa", default=[-1], type=int_list, help="NUMA nodes of arena (-1 = not placed)")
+    parser.add_argument("--repeat", default=3, type=int, help="runs of every point, the fastest is kept")
+    parser.add_argument("--timeout", default=900, type=float, help="seconds of one run")
+    parser.add_argument("--output", default="scaling.csv", help="results file (.csv or .json)")
+    parser.add_argument("--verbose", action="store_true", help="print output of failed runs")
+    parser.add_argument("solver_args", nargs="*", help="extra solver arguments after '--'")
+    args = parser.parse_args()
+
+    for name in args.modes:
+        if name not in MODES:
+            parser.error("unknown mode '%s'" % name)
+
+    records = analyze(run_sweep(args))
+    if not records:
+        print("No successful run")
+        return 1
+
+    if args.output.lower().endswith(".json"):
+        with open(args.output, "w") as f:
+            json.dump({"records": records}, f, indent=2)
+    else:
+        fields = list(records[0].keys())
+        with open(args.output, "w", newline="") as f:
+            writer = csv.DictWriter(f, fieldnames=fields)
+            writer.writeheader()
+            writer.writerows(records)
+
+    print_summary(records)
+    print("Results: %s" % args.output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())